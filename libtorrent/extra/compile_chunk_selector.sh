@@ -0,0 +1,2 @@
+# Run from the extra directory of a configured tree.
+g++ -Wall -O2 -I.. -I../src -I../src/torrent -o test_chunk_selector test_chunk_selector.cc ../src/download/chunk_selector.cc ../src/download/chunk_statistics.cc ../src/torrent/bitfield.cc ../src/torrent/rate.cc ../src/torrent/exceptions.cc ../src/globals.cc
@@ -0,0 +1,150 @@
+// Compares the rarity-bucket ChunkSelector::find against the old
+// linear scan of the bitfields, see compile_chunk_selector.sh.
+
+#include "config.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <rak/partial_queue.h>
+#include <rak/timer.h>
+
+#include "download/chunk_selector.h"
+#include "download/chunk_statistics.h"
+#include "protocol/peer_chunks.h"
+
+using namespace torrent;
+
+// The search done by ChunkSelector::find before the rarity buckets,
+// walking the wanted bitfield byte by byte from 'position'.
+bool
+old_search_byte(const ChunkStatistics* cs, rak::partial_queue* pq, uint32_t index, Bitfield::value_type wanted) {
+  for (int i = 0; i < 8; ++i) {
+    if (!(wanted & Bitfield::mask_at(i)))
+      continue;
+
+    if (!pq->insert(cs->rarity(index + i), index + i) && pq->is_full())
+      return false;
+  }
+
+  return true;
+}
+
+bool
+old_search_range(const Bitfield* local, const ChunkStatistics* cs, const Bitfield* bf, rak::partial_queue* pq, uint32_t first, uint32_t last) {
+  Bitfield::const_iterator localItr = local->begin() + first / 8;
+  Bitfield::const_iterator source = bf->begin() + first / 8;
+
+  Bitfield::value_type wanted = (*source & *localItr) & Bitfield::mask_from(first % 8);
+
+  while (local->position(localItr + 1) < last) {
+    if (wanted && !old_search_byte(cs, pq, local->position(localItr), wanted))
+      return false;
+
+    wanted = (*++source & *++localItr);
+  }
+
+  wanted &= Bitfield::mask_before(last - local->position(localItr));
+
+  return !wanted || old_search_byte(cs, pq, local->position(localItr), wanted);
+}
+
+uint32_t
+old_find(const Bitfield* local, const ChunkStatistics* cs, PeerChunks* pc, uint32_t position) {
+  rak::partial_queue* queue = pc->download_cache();
+  queue->clear();
+
+  if (position != 0)
+    old_search_range(local, cs, pc->bitfield(), queue, position, local->size_bits()) &&
+      old_search_range(local, cs, pc->bitfield(), queue, 0, position);
+  else
+    old_search_range(local, cs, pc->bitfield(), queue, 0, local->size_bits());
+
+  return queue->prepare_pop() ? queue->pop() : ChunkSelector::invalid_chunk;
+}
+
+void
+benchmark(uint32_t chunks, uint32_t peers, double done, double peerHas, unsigned int iterations) {
+  Bitfield completed;
+  completed.set_size_bits(chunks);
+  completed.allocate();
+  completed.unset_all();
+
+  for (uint32_t i = 0; i < chunks; ++i)
+    if (std::rand() < done * RAND_MAX)
+      completed.set(i);
+
+  ChunkStatistics statistics;
+  statistics.initialize(chunks);
+
+  std::vector<PeerChunks*> peerList;
+
+  for (uint32_t p = 0; p < peers; ++p) {
+    PeerChunks* pc = new PeerChunks;
+    pc->bitfield()->set_size_bits(chunks);
+    pc->bitfield()->allocate();
+    pc->bitfield()->unset_all();
+
+    for (uint32_t i = 0; i < chunks; ++i)
+      if (std::rand() < peerHas * RAND_MAX)
+        pc->bitfield()->set(i);
+
+    pc->download_cache()->enable(8);
+    statistics.received_connect(pc);
+    peerList.push_back(pc);
+  }
+
+  ChunkSelector selector;
+  selector.initialize(&completed, &statistics);
+  selector.normal_priority()->insert(0, chunks);
+  selector.update_priorities();
+
+  // The selector's bitfield holds the chunks we still want.
+  Bitfield wanted;
+  wanted.copy(*selector.bitfield());
+
+  rak::timer start = rak::timer::current();
+  uint64_t found = 0;
+
+  for (unsigned int i = 0; i < iterations; ++i)
+    found += old_find(&wanted, &statistics, peerList[i % peers], std::rand() % chunks) != ChunkSelector::invalid_chunk;
+
+  rak::timer oldTime = rak::timer::current() - start;
+  start = rak::timer::current();
+
+  for (unsigned int i = 0; i < iterations; ++i) {
+    peerList[i % peers]->download_cache()->clear();
+    found += selector.find(peerList[i % peers], false) != ChunkSelector::invalid_chunk;
+  }
+
+  rak::timer newTime = rak::timer::current() - start;
+
+  std::cout << std::setw(8) << chunks << " chunks " << std::setw(4) << peers << " peers "
+            << std::setw(4) << (int)(done * 100) << "% done " << std::setw(4) << (int)(peerHas * 100) << "% peer: "
+            << "linear " << std::setw(8) << oldTime.usec() * 1000 / iterations << " nsec, "
+            << "buckets " << std::setw(8) << newTime.usec() * 1000 / iterations << " nsec"
+            << "  (" << found << ")" << std::endl;
+
+  for (std::vector<PeerChunks*>::iterator itr = peerList.begin(); itr != peerList.end(); ++itr) {
+    statistics.received_disconnect(*itr);
+    delete *itr;
+  }
+
+  selector.cleanup();
+  statistics.clear();
+}
+
+int
+main(int argc, char** argv) {
+  std::srand(0);
+
+  benchmark(10000,  50, 0.0, 0.5, 2000);
+  benchmark(10000,  50, 0.9, 0.5, 2000);
+  benchmark(100000, 50, 0.0, 0.5, 500);
+  benchmark(100000, 50, 0.5, 0.5, 500);
+  benchmark(100000, 50, 0.9, 0.5, 500);
+  benchmark(100000, 50, 0.99, 0.1, 500);
+
+  return 0;
+}
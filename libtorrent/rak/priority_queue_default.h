@@ -38,6 +38,7 @@
 #define RAK_PRIORITY_QUEUE_DEFAULT_H
 
 #include <stdexcept>
+#include <vector>
 #include <rak/allocators.h>
 #include <rak/functional.h>
 #include <rak/functional_fun.h>
@@ -48,7 +49,9 @@ namespace rak {
 
 class priority_item {
 public:
-  priority_item() {}
+  static const size_t npos = ~size_t();
+
+  priority_item() : m_index(npos) {}
   ~priority_item() {
     if (is_queued())
       throw std::logic_error("priority_item::~priority_item() called on a queued item.");
@@ -69,11 +72,16 @@ public:
 
   bool                compare(const timer& t) const          { return m_time > t; }
 
+  // Position in the owning priority_queue_default's heap, or npos.
+  size_t              queue_index() const                    { return m_index; }
+  void                set_queue_index(size_t i)              { m_index = i; }
+
 private:
   priority_item(const priority_item&);
   void operator = (const priority_item&);
 
   timer               m_time;
+  size_t              m_index;
   function0<void>     m_slot;
 };
 
@@ -84,8 +92,122 @@ struct priority_compare {
 };
 
 typedef std::equal_to<priority_item*> priority_equal;
-typedef priority_queue<priority_item*, priority_compare, priority_equal,
-                       cacheline_allocator<priority_item*> > priority_queue_default;
+
+// Binary heap of priority_item's where each item remembers its own
+// position, so find and erase don't need to search the heap. This
+// keeps re-arming and cancelling timers at O(log n) even with tens
+// of thousands of items queued.
+
+class priority_queue_default : private std::vector<priority_item*, cacheline_allocator<priority_item*> > {
+public:
+  typedef std::vector<priority_item*, cacheline_allocator<priority_item*> > base_type;
+
+  typedef base_type::reference       reference;
+  typedef base_type::const_reference const_reference;
+  typedef base_type::iterator        iterator;
+  typedef base_type::const_iterator  const_iterator;
+  typedef base_type::value_type      value_type;
+
+  using base_type::begin;
+  using base_type::end;
+  using base_type::size;
+  using base_type::empty;
+
+  const_reference top() const { return base_type::front(); }
+
+  void pop()                  { erase_index(0); }
+
+  void push(const value_type& value) {
+    value->set_queue_index(size());
+    base_type::push_back(value);
+
+    sift_up(size() - 1);
+  }
+
+  iterator find(const value_type& value) {
+    size_t index = value->queue_index();
+
+    if (index >= size() || base_type::operator[](index) != value)
+      return end();
+
+    return begin() + index;
+  }
+
+  bool erase(const value_type& value) {
+    iterator itr = find(value);
+
+    if (itr == end())
+      return false;
+
+    erase_index(itr - begin());
+    return true;
+  }
+
+private:
+  bool less(size_t i, size_t j) const {
+    return base_type::operator[](i)->time() < base_type::operator[](j)->time();
+  }
+
+  void place(size_t index, value_type value) {
+    base_type::operator[](index) = value;
+    value->set_queue_index(index);
+  }
+
+  void sift_up(size_t index) {
+    value_type value = base_type::operator[](index);
+
+    while (index != 0) {
+      size_t parent = (index - 1) / 2;
+
+      if (!(value->time() < base_type::operator[](parent)->time()))
+        break;
+
+      place(index, base_type::operator[](parent));
+      index = parent;
+    }
+
+    place(index, value);
+  }
+
+  void sift_down(size_t index) {
+    value_type value = base_type::operator[](index);
+
+    while (true) {
+      size_t child = 2 * index + 1;
+
+      if (child >= size())
+        break;
+
+      if (child + 1 < size() && less(child + 1, child))
+        child++;
+
+      if (!(base_type::operator[](child)->time() < value->time()))
+        break;
+
+      place(index, base_type::operator[](child));
+      index = child;
+    }
+
+    place(index, value);
+  }
+
+  void erase_index(size_t index) {
+    base_type::operator[](index)->set_queue_index(priority_item::npos);
+
+    value_type last = base_type::back();
+    base_type::pop_back();
+
+    if (index == size())
+      return;
+
+    place(index, last);
+
+    if (index != 0 && last->time() < base_type::operator[]((index - 1) / 2)->time())
+      sift_up(index);
+    else
+      sift_down(index);
+  }
+};
 
 inline void
 priority_queue_perform(priority_queue_default* queue, timer t) {
@@ -126,7 +248,6 @@ priority_queue_erase(priority_queue_default* queue, priority_item* item) {
   if (!item->is_valid())
     throw std::logic_error("priority_queue_erase(...) called on an invalid item.");
 
-  // Clear time before erasing to force it to the top.
   item->clear_time();
   
   if (!queue->erase(item))
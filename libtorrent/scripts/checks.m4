@@ -173,6 +173,52 @@ AC_DEFUN([TORRENT_CHECK_FALLOCATE], [
 ])
 
 
+AC_DEFUN([TORRENT_CHECK_SENDFILE], [
+  AC_MSG_CHECKING(for Linux sendfile)
+
+  AC_TRY_LINK([#include <sys/sendfile.h>
+              ],[ off_t offset = 0; sendfile(0, 0, &offset, 0); return 0;
+              ],
+    [
+      AC_DEFINE(USE_SENDFILE, 1, Linux's sendfile supported.)
+      AC_MSG_RESULT(yes)
+    ], [
+      AC_MSG_RESULT(no)
+    ])
+])
+
+
+AC_DEFUN([TORRENT_CHECK_IO_URING], [
+  AC_MSG_CHECKING(for io_uring support)
+
+  AC_TRY_LINK([#include <linux/io_uring.h>
+               #include <sys/eventfd.h>
+               #include <sys/syscall.h>
+               #include <unistd.h>
+              ],[ struct io_uring_params p; int op = IORING_OP_FALLOCATE;
+                  syscall(__NR_io_uring_setup, 1, &p); eventfd(0, EFD_NONBLOCK); return op;
+              ],
+    [
+      AC_DEFINE(USE_IO_URING, 1, Use io_uring for the disk engine.)
+      AC_MSG_RESULT(yes)
+    ], [
+      AC_MSG_RESULT(no)
+    ])
+])
+
+AC_DEFUN([TORRENT_WITHOUT_IO_URING], [
+  AC_ARG_WITH(io-uring,
+    [  --without-io-uring      Do not check for io_uring support.],
+    [
+      if test "$withval" = "yes"; then
+        TORRENT_CHECK_IO_URING
+      fi
+    ], [
+        TORRENT_CHECK_IO_URING
+    ])
+])
+
+
 AC_DEFUN([TORRENT_CHECK_POSIX_FALLOCATE], [
   AC_MSG_CHECKING(for posix_fallocate)
 
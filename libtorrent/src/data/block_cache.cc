@@ -0,0 +1,261 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#include "config.h"
+
+#include "torrent/exceptions.h"
+#include "torrent/data/piece.h"
+
+#include "block_cache.h"
+#include "chunk.h"
+
+namespace torrent {
+
+BlockCacheEntry::BlockCacheEntry(ChunkList* cl, uint32_t index, uint32_t offset, uint32_t length) :
+  m_chunkList(cl),
+  m_index(index),
+  m_offset(offset),
+  m_length(length),
+  m_data(new char[length]),
+  m_references(0),
+  m_protected(false),
+  m_stale(false) {
+}
+
+BlockCacheEntry::~BlockCacheEntry() {
+  delete [] m_data;
+}
+
+bool
+BlockCache::key_type::operator < (const key_type& k) const {
+  if (chunkList != k.chunkList)
+    return chunkList < k.chunkList;
+
+  if (index != k.index)
+    return index < k.index;
+
+  if (offset != k.offset)
+    return offset < k.offset;
+
+  return length < k.length;
+}
+
+BlockCache::BlockCache() :
+  m_protectedSize(0),
+  m_memoryUsage(0),
+  m_maxMemoryUsage(0),
+  m_statsHits(0),
+  m_statsMisses(0) {
+}
+
+BlockCache::~BlockCache() {
+  for (map_type::iterator itr = m_map.begin(), last = m_map.end(); itr != last; ++itr) {
+    if (itr->second->m_references != 0)
+      throw internal_error("BlockCache::~BlockCache() an entry is still referenced.");
+
+    free_entry(itr->second);
+  }
+
+  if (m_memoryUsage != 0)
+    throw internal_error("BlockCache::~BlockCache() m_memoryUsage != 0.");
+}
+
+void
+BlockCache::set_max_memory_usage(uint64_t bytes) {
+  m_maxMemoryUsage = bytes;
+
+  balance_protected();
+  evict(bytes);
+}
+
+BlockCacheEntry*
+BlockCache::find(ChunkList* cl, const Piece& piece) {
+  map_type::iterator itr = m_map.find(key_type(cl, piece.index(), piece.offset(), piece.length()));
+
+  if (itr == m_map.end()) {
+    m_statsMisses++;
+    return NULL;
+  }
+
+  BlockCacheEntry* entry = itr->second;
+
+  m_statsHits++;
+  entry->m_references++;
+
+  if (entry->m_protected) {
+    m_protected.splice(m_protected.begin(), m_protected, entry->m_position);
+
+  } else {
+    m_probation.erase(entry->m_position);
+    m_protected.push_front(entry);
+
+    entry->m_position = m_protected.begin();
+    entry->m_protected = true;
+    m_protectedSize += entry->m_length;
+
+    balance_protected();
+  }
+
+  return entry;
+}
+
+BlockCacheEntry*
+BlockCache::insert(ChunkList* cl, const Piece& piece, Chunk* chunk) {
+  if (piece.length() == 0 || piece.length() > m_maxMemoryUsage)
+    return NULL;
+
+  key_type key(cl, piece.index(), piece.offset(), piece.length());
+
+  if (m_map.find(key) != m_map.end())
+    throw internal_error("BlockCache::insert(...) block already cached.");
+
+  evict(m_maxMemoryUsage - piece.length());
+
+  BlockCacheEntry* entry = new BlockCacheEntry(cl, piece.index(), piece.offset(), piece.length());
+
+  chunk->to_buffer(entry->m_data, piece.offset(), piece.length());
+
+  m_map.insert(map_type::value_type(key, entry));
+  m_probation.push_front(entry);
+
+  entry->m_position = m_probation.begin();
+  entry->m_references = 1;
+
+  m_memoryUsage += entry->m_length;
+
+  return entry;
+}
+
+void
+BlockCache::release(BlockCacheEntry* entry) {
+  if (entry->m_references == 0)
+    throw internal_error("BlockCache::release(...) entry is not referenced.");
+
+  if (--entry->m_references != 0)
+    return;
+
+  if (entry->m_stale)
+    free_entry(entry);
+  else if (m_memoryUsage > m_maxMemoryUsage)
+    evict(m_maxMemoryUsage);
+}
+
+void
+BlockCache::erase(ChunkList* cl, uint32_t index) {
+  map_type::iterator itr = m_map.lower_bound(key_type(cl, index, 0, 0));
+
+  while (itr != m_map.end() && itr->first.chunkList == cl && itr->first.index == index) {
+    erase_entry(itr->second);
+    m_map.erase(itr++);
+  }
+}
+
+void
+BlockCache::erase(ChunkList* cl) {
+  map_type::iterator itr = m_map.lower_bound(key_type(cl, 0, 0, 0));
+
+  while (itr != m_map.end() && itr->first.chunkList == cl) {
+    erase_entry(itr->second);
+    m_map.erase(itr++);
+  }
+}
+
+// Removes the entry from the LRU lists, the caller is responsible
+// for removing it from the map.
+void
+BlockCache::erase_entry(BlockCacheEntry* entry) {
+  if (entry->m_protected) {
+    m_protected.erase(entry->m_position);
+    m_protectedSize -= entry->m_length;
+  } else {
+    m_probation.erase(entry->m_position);
+  }
+
+  if (entry->m_references == 0)
+    free_entry(entry);
+  else
+    entry->m_stale = true;
+}
+
+void
+BlockCache::free_entry(BlockCacheEntry* entry) {
+  m_memoryUsage -= entry->m_length;
+  delete entry;
+}
+
+void
+BlockCache::balance_protected() {
+  uint64_t maxProtected = m_maxMemoryUsage / 100 * protected_ratio;
+
+  while (m_protectedSize > maxProtected && !m_protected.empty()) {
+    BlockCacheEntry* entry = m_protected.back();
+
+    m_protected.pop_back();
+    m_protectedSize -= entry->m_length;
+
+    m_probation.push_front(entry);
+    entry->m_position = m_probation.begin();
+    entry->m_protected = false;
+  }
+}
+
+void
+BlockCache::evict(uint64_t target) {
+  while (m_memoryUsage > target) {
+    lru_type::reverse_iterator itr = m_probation.rbegin();
+
+    while (itr != m_probation.rend() && (*itr)->m_references != 0)
+      ++itr;
+
+    if (itr == m_probation.rend()) {
+      itr = m_protected.rbegin();
+
+      while (itr != m_protected.rend() && (*itr)->m_references != 0)
+        ++itr;
+
+      // Everything left is pinned.
+      if (itr == m_protected.rend())
+        return;
+    }
+
+    BlockCacheEntry* entry = *itr;
+
+    m_map.erase(key_type(entry->m_chunkList, entry->m_index, entry->m_offset, entry->m_length));
+    erase_entry(entry);
+  }
+}
+
+}
@@ -0,0 +1,171 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#ifndef LIBTORRENT_DATA_BLOCK_CACHE_H
+#define LIBTORRENT_DATA_BLOCK_CACHE_H
+
+#include <list>
+#include <map>
+#include <inttypes.h>
+
+namespace torrent {
+
+class Chunk;
+class ChunkList;
+class Piece;
+
+class BlockCacheEntry {
+public:
+  BlockCacheEntry(ChunkList* cl, uint32_t index, uint32_t offset, uint32_t length);
+  ~BlockCacheEntry();
+
+  ChunkList*          chunk_list() const                { return m_chunkList; }
+  uint32_t            index() const                     { return m_index; }
+  uint32_t            offset() const                    { return m_offset; }
+  uint32_t            length() const                    { return m_length; }
+
+  const char*         data() const                      { return m_data; }
+  char*               data()                            { return m_data; }
+
+  // Pointer to the data at 'offset' within the chunk.
+  const char*         at_offset(uint32_t offset) const  { return m_data + (offset - m_offset); }
+
+private:
+  friend class BlockCache;
+
+  BlockCacheEntry(const BlockCacheEntry&);
+  void operator = (const BlockCacheEntry&);
+
+  ChunkList*          m_chunkList;
+  uint32_t            m_index;
+  uint32_t            m_offset;
+  uint32_t            m_length;
+
+  char*               m_data;
+
+  uint32_t            m_references;
+  bool                m_protected;
+  bool                m_stale;
+
+  std::list<BlockCacheEntry*>::iterator m_position;
+};
+
+// Size-bounded cache of requested blocks for uploading, so that
+// blocks of popular chunks are copied from user memory rather than
+// mapped and faulted in again for every peer.
+//
+// Eviction uses a segmented LRU; new blocks go into the probation
+// segment and are moved to the protected segment on the first hit.
+// A peer downloading a whole torrent thus won't push out the blocks
+// that are requested by many peers.
+//
+// Entries returned by 'find' and 'insert' are pinned until passed to
+// 'release'. Erased entries that are pinned are freed on release.
+
+class BlockCache {
+public:
+  typedef std::list<BlockCacheEntry*> lru_type;
+
+  struct key_type {
+    key_type(ChunkList* cl, uint32_t i, uint32_t o, uint32_t l) : chunkList(cl), index(i), offset(o), length(l) {}
+
+    bool operator < (const key_type& k) const;
+
+    ChunkList*        chunkList;
+    uint32_t          index;
+    uint32_t          offset;
+    uint32_t          length;
+  };
+
+  typedef std::map<key_type, BlockCacheEntry*> map_type;
+
+  // Size of the protected segment relative to the whole cache, in
+  // percent.
+  static const uint32_t protected_ratio = 80;
+
+  BlockCache();
+  ~BlockCache();
+
+  bool                is_enabled() const                { return m_maxMemoryUsage != 0; }
+
+  uint64_t            memory_usage() const              { return m_memoryUsage; }
+  uint64_t            max_memory_usage() const          { return m_maxMemoryUsage; }
+  void                set_max_memory_usage(uint64_t bytes);
+
+  uint32_t            size() const                      { return m_map.size(); }
+
+  uint64_t            stats_hits() const                { return m_statsHits; }
+  uint64_t            stats_misses() const              { return m_statsMisses; }
+
+  BlockCacheEntry*    find(ChunkList* cl, const Piece& piece);
+
+  // Copies the piece from the chunk into the cache. Returns NULL if
+  // the block could not be cached.
+  BlockCacheEntry*    insert(ChunkList* cl, const Piece& piece, Chunk* chunk);
+
+  void                release(BlockCacheEntry* entry);
+
+  // Erase all blocks of a chunk that is about to be modified, or all
+  // blocks of a chunk list that is being closed.
+  void                erase(ChunkList* cl, uint32_t index);
+  void                erase(ChunkList* cl);
+
+private:
+  BlockCache(const BlockCache&);
+  void operator = (const BlockCache&);
+
+  void                erase_entry(BlockCacheEntry* entry);
+  void                free_entry(BlockCacheEntry* entry);
+
+  void                balance_protected();
+  void                evict(uint64_t target);
+
+  map_type            m_map;
+
+  lru_type            m_probation;
+  lru_type            m_protected;
+  uint64_t            m_protectedSize;
+
+  uint64_t            m_memoryUsage;
+  uint64_t            m_maxMemoryUsage;
+
+  uint64_t            m_statsHits;
+  uint64_t            m_statsMisses;
+};
+
+}
+
+#endif
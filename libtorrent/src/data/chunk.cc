@@ -42,9 +42,12 @@
 #include <cstring>
 
 #include "torrent/exceptions.h"
+#include "torrent/data/file.h"
 
 #include "chunk.h"
 #include "chunk_iterator.h"
+#include "disk_engine.h"
+#include "manager.h"
 
 namespace torrent {
 
@@ -53,6 +56,15 @@ Chunk::is_all_valid() const {
   return !empty() && std::find_if(begin(), end(), std::not1(std::mem_fun_ref(&ChunkPart::is_valid))) == end();
 }
 
+bool
+Chunk::is_buffered() const {
+  for (const_iterator itr = begin(), last = end(); itr != last; ++itr)
+    if (itr->mapped() == ChunkPart::MAPPED_BUFFER)
+      return true;
+
+  return false;
+}
+
 void
 Chunk::clear() {
   std::for_each(begin(), end(), std::mem_fun_ref(&ChunkPart::clear));
@@ -70,12 +82,12 @@ Chunk::clear() {
 // If the user knows how many chunk parts he is going to add, then he
 // may call reserve prior to this.
 void
-Chunk::push_back(value_type::mapped_type mapped, const MemoryChunk& c) {
+Chunk::push_back(value_type::mapped_type mapped, const MemoryChunk& c, File* file, uint64_t fileOffset) {
   m_prot &= c.get_prot();
 
   // Gcc starts the reserved size at 1 for the first insert, so we
   // won't be wasting any space in the general case.
-  base_type::insert(end(), ChunkPart(mapped, c, m_chunkSize));
+  base_type::insert(end(), ChunkPart(mapped, c, m_chunkSize, file, fileOffset));
 
   m_chunkSize += c.size();
 }
@@ -163,7 +175,7 @@ Chunk::sync(int flags) {
   bool success = true;
 
   for (iterator itr = begin(), last = end(); itr != last; ++itr)
-    if (!itr->chunk().sync(0, itr->chunk().size(), flags))
+    if (!itr->sync(flags))
       success = false;
 
   return success;
@@ -174,11 +186,19 @@ Chunk::preload(uint32_t position, uint32_t length, bool useAdvise) {
   if (position >= m_chunkSize)
     throw internal_error("Chunk::preload(...) position > m_chunkSize.");
 
-  if (length == 0)
+  // Buffered chunks are already read in their entirety.
+  if (length == 0 || is_buffered())
     return;
 
+  length = std::min(length, m_chunkSize - position);
+
+  if (manager->disk_engine()->is_active()) {
+    preload_disk_engine(position, length);
+    return;
+  }
+
   Chunk::data_type data;
-  ChunkIterator itr(this, position, position + std::min(length, m_chunkSize - position));
+  ChunkIterator itr(this, position, position + length);
 
   do {
     data = itr.data();
@@ -199,6 +219,23 @@ Chunk::preload(uint32_t position, uint32_t length, bool useAdvise) {
   } while (itr.next());
 }
 
+// Queue reads of the range in the disk engine so that the pages are
+// in the cache when touched, without blocking the main thread.
+void
+Chunk::preload_disk_engine(uint32_t position, uint32_t length) {
+  for (iterator itr = at_position(position); itr != end() && length != 0; ++itr) {
+    uint32_t offset = position - itr->position();
+    uint32_t l = std::min(length, itr->size() - offset);
+
+    if (itr->file() == NULL || !itr->file()->prepare(MemoryChunk::prot_read) ||
+        !manager->disk_engine()->read_ahead(itr->file()->file_descriptor(), itr->file_offset() + offset, l))
+      return;
+
+    position += l;
+    length -= l;
+  }
+}
+
 // Consider using uint32_t returning first mismatch or length if
 // matching.
 bool
@@ -222,6 +259,20 @@ Chunk::to_buffer(void* buffer, uint32_t position, uint32_t length) {
   return true;
 }
 
+void
+Chunk::mark_dirty(uint32_t position, uint32_t length) {
+  if (position + length > m_chunkSize)
+    throw internal_error("Chunk::mark_dirty(...) position + length > m_chunkSize.");
+
+  if (length == 0)
+    return;
+
+  for (iterator itr = at_position(position); itr != end() && itr->position() < position + length; ++itr)
+    if (itr->mapped() == ChunkPart::MAPPED_BUFFER)
+      itr->mark_dirty(std::max(position, itr->position()) - itr->position(),
+                      std::min(position + length, itr->position() + itr->size()) - itr->position());
+}
+
 // Consider using uint32_t returning first mismatch or length if
 // matching.
 bool
@@ -232,6 +283,8 @@ Chunk::from_buffer(const void* buffer, uint32_t position, uint32_t length) {
   if (length == 0)
     return true;
 
+  mark_dirty(position, length);
+
   Chunk::data_type data;
   ChunkIterator itr(this, position, position + length);
 
@@ -65,6 +65,11 @@ public:
 
   bool                is_all_valid() const;
 
+  // True if any part is a buffer read with pread rather than a
+  // memory mapping, such chunks must be synced before other readers
+  // of the file see the modifications.
+  bool                is_buffered() const;
+
   // All permissions are set for empty chunks.
   bool                is_readable() const             { return m_prot & MemoryChunk::prot_read; }
   bool                is_writable() const             { return m_prot & MemoryChunk::prot_write; }
@@ -74,7 +79,7 @@ public:
 
   void                clear();
 
-  void                push_back(value_type::mapped_type mapped, const MemoryChunk& c);
+  void                push_back(value_type::mapped_type mapped, const MemoryChunk& c, File* file = NULL, uint64_t fileOffset = 0);
 
   // The at_position functions only returns non-zero length iterators
   // or end.
@@ -89,7 +94,12 @@ public:
 
   bool                sync(int flags);
 
+  // Flag the buffered parts overlapping the range as modified, must
+  // be called by anything writing directly into the chunk's memory.
+  void                mark_dirty(uint32_t position, uint32_t length);
+
   void                preload(uint32_t position, uint32_t length, bool useAdvise);
+  void                preload_disk_engine(uint32_t position, uint32_t length);
 
   bool                to_buffer(void* buffer, uint32_t position, uint32_t length);
   bool                from_buffer(const void* buffer, uint32_t position, uint32_t length);
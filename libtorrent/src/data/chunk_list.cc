@@ -40,6 +40,7 @@
 #include "torrent/chunk_manager.h"
 #include "torrent/utils/log_files.h"
 
+#include "block_cache.h"
 #include "chunk_list.h"
 #include "chunk.h"
 #include "globals.h"
@@ -88,6 +89,9 @@ ChunkList::resize(size_type s) {
 
 void
 ChunkList::clear() {
+  if (m_manager != NULL)
+    m_manager->block_cache()->erase(this);
+
   // Don't do any sync'ing as whomever decided to shut down really
   // doesn't care, so just de-reference all chunks in queue.
   for (Queue::iterator itr = m_queue.begin(), last = m_queue.end(); itr != last; ++itr) {
@@ -117,6 +121,11 @@ ChunkList::get(size_type index, int flags) {
   int allocate_flags = (flags & get_dont_log) ? ChunkManager::allocate_dont_log : 0;
   int prot_flags = MemoryChunk::prot_read | ((flags & get_writable) ? MemoryChunk::prot_write : 0);
 
+  // Cached blocks of a chunk that is being written to are no longer
+  // valid.
+  if (flags & get_writable)
+    m_manager->block_cache()->erase(this, index);
+
   if (!node->is_valid()) {
     if (!m_manager->allocate(m_chunk_size, allocate_flags))
       return ChunkHandle::from_error(rak::error_number::e_nomem);
@@ -199,6 +208,19 @@ ChunkList::release(ChunkHandle* handle, int flags) {
   handle->clear();
 }
 
+// Buffered chunks are written back once the chunk is complete, so
+// that it is written in one go and reads through the file, e.g.
+// sendfile, see the data. Failures are left for sync_chunks to retry
+// and report.
+void
+ChunkList::flush(ChunkHandle* handle) {
+  if (!handle->is_valid())
+    throw internal_error("ChunkList::flush(...) received an invalid handle.");
+
+  if (handle->chunk()->is_buffered())
+    handle->chunk()->sync(MemoryChunk::sync_async);
+}
+
 void
 ChunkList::clear_chunk(ChunkListNode* node, int flags) {
   if (!node->is_valid())
@@ -107,6 +107,7 @@ public:
 
   ChunkHandle         get(size_type index, int flags = 0);
   void                release(ChunkHandle* handle, int flags = 0);
+  void                flush(ChunkHandle* handle);
 
   size_type           queue_size() const                      { return m_queue.size(); }
 
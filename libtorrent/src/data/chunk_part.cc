@@ -40,7 +40,9 @@
 #include <unistd.h>
 
 #include "torrent/exceptions.h"
+#include "torrent/data/file.h"
 #include "chunk_part.h"
+#include "socket_file.h"
 
 namespace torrent {
 
@@ -51,17 +53,60 @@ ChunkPart::clear() {
     m_chunk.unmap();
     break;
 
+  case MAPPED_BUFFER:
+    m_chunk.free_buffer();
+    break;
+
   default:
   case MAPPED_STATIC:
-    throw internal_error("ChunkPart::clear() only MAPPED_MMAP supported.");
+    throw internal_error("ChunkPart::clear() only MAPPED_MMAP and MAPPED_BUFFER supported.");
     break;
   }
 
   m_chunk.clear();
 }
 
+bool
+ChunkPart::sync(int flags) {
+  switch (m_mapped) {
+  case MAPPED_MMAP:
+    return m_chunk.sync(0, m_chunk.size(), flags);
+
+  case MAPPED_BUFFER:
+    if (!m_chunk.is_writable())
+      return true;
+
+    if (m_file == NULL)
+      throw internal_error("ChunkPart::sync() MAPPED_BUFFER part has no file.");
+
+    if (!is_dirty() && !(flags & MemoryChunk::sync_sync))
+      return true;
+
+    // The file manager might have closed the file descriptor since
+    // the buffer was read, so reopen it if needed.
+    if (!m_file->prepare(MemoryChunk::prot_read | MemoryChunk::prot_write))
+      return false;
+
+    // Failed writes leave all ranges dirty, rewriting them is
+    // harmless.
+    for (dirty_ranges::const_iterator itr = m_dirty.begin(), last = m_dirty.end(); itr != last; ++itr)
+      if (!SocketFile(m_file->file_descriptor()).write_buffer(m_chunk.begin() + itr->first, m_fileOffset + itr->first, itr->second - itr->first))
+        return false;
+
+    m_dirty.clear();
+
+    return !(flags & MemoryChunk::sync_sync) || fsync(m_file->file_descriptor()) == 0;
+
+  default:
+    return true;
+  }
+}
+
 bool
 ChunkPart::is_incore(uint32_t pos, uint32_t length) {
+  if (m_mapped == MAPPED_BUFFER)
+    return true;
+
   length = std::min(length, remaining_from(pos));
   pos = pos - m_position;
 
@@ -84,6 +129,9 @@ ChunkPart::incore_length(uint32_t pos, uint32_t length) {
   if (pos >= size())
     throw internal_error("ChunkPart::incore_length(...) got invalid position");
 
+  if (m_mapped == MAPPED_BUFFER)
+    return length;
+
   uint32_t touched = m_chunk.pages_touched(pos, length);
   char buf[touched];
 
@@ -37,24 +37,35 @@
 #ifndef LIBTORRENT_DATA_STORAGE_CHUNK_PART_H
 #define LIBTORRENT_DATA_STORAGE_CHUNK_PART_H
 
+#include <rak/ranges.h>
+
 #include "memory_chunk.h"
 
 namespace torrent {
 
+class File;
+
 class ChunkPart {
 public:
+  typedef rak::ranges<uint32_t> dirty_ranges;
+
   typedef enum {
     MAPPED_MMAP,
-    MAPPED_STATIC
+    MAPPED_STATIC,
+    MAPPED_BUFFER
   } mapped_type;
 
-  ChunkPart(mapped_type mapped, const MemoryChunk& c, uint32_t pos) :
-    m_mapped(mapped), m_chunk(c), m_position(pos) {}
+  // Parts keep the file and the offset within it so that writable
+  // buffers can be flushed with pwrite, and so the disk engine can
+  // do read-ahead and fsync on the file.
+  ChunkPart(mapped_type mapped, const MemoryChunk& c, uint32_t pos, File* file = NULL, uint64_t fileOffset = 0) :
+    m_mapped(mapped), m_chunk(c), m_position(pos), m_file(file), m_fileOffset(fileOffset) {}
 
   bool                is_valid() const                      { return m_chunk.is_valid(); }
   bool                is_contained(uint32_t p) const        { return p >= m_position && p < m_position + size(); }
 
   void                clear();
+  bool                sync(int flags);
 
   mapped_type         mapped() const                        { return m_mapped; }
 
@@ -64,6 +75,15 @@ public:
   uint32_t            size() const                          { return m_chunk.size(); }
   uint32_t            position() const                      { return m_position; }
 
+  File*               file() const                          { return m_file; }
+  uint64_t            file_offset() const                   { return m_fileOffset; }
+
+  // Buffers only write back the ranges modified since the last sync,
+  // given relative to the start of the part.
+  bool                is_dirty() const                      { return m_dirty.size() != 0; }
+  const dirty_ranges& dirty() const                         { return m_dirty; }
+  void                mark_dirty(uint32_t first, uint32_t last) { m_dirty.insert(first, last); }
+
   uint32_t            remaining_from(uint32_t pos) const    { return size() - (pos - m_position); }
 
   bool                is_incore(uint32_t pos, uint32_t length = ~uint32_t());
@@ -74,6 +94,11 @@ private:
 
   MemoryChunk         m_chunk;
   uint32_t            m_position;
+
+  File*               m_file;
+  uint64_t            m_fileOffset;
+
+  dirty_ranges        m_dirty;
 };
 
 }
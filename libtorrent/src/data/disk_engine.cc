@@ -0,0 +1,690 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#include "config.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "torrent/exceptions.h"
+#include "torrent/poll.h"
+
+#include "disk_engine.h"
+#include "manager.h"
+
+namespace torrent {
+
+// Largest transfer passed to a single io_uring read, longer requests
+// continue after the partial completion.
+static const uint64_t disk_max_transfer = 1 << 30;
+
+DiskRequest::DiskRequest(op_type op, int fd, char* buffer, uint64_t offset, uint64_t length) :
+  m_op(op),
+  m_fd(::dup(fd)),
+  m_buffer(buffer),
+  m_offset(offset),
+  m_length(length),
+  m_done(0),
+  m_result(0),
+  m_finished(false) {
+}
+
+DiskRequest::~DiskRequest() {
+  if (m_fd != -1)
+    ::close(m_fd);
+}
+
+void
+DiskRequest::set_result(int64_t result) {
+  if (m_finished)
+    throw internal_error("DiskRequest::set_result(...) called on a finished request.");
+
+  if (result < 0) {
+    m_result = result;
+    m_finished = true;
+    return;
+  }
+
+  switch (m_op) {
+  case OP_READ:
+    // Reading past the end of the file is not an error, it just
+    // means there's nothing more to read.
+    if (result == 0)
+      m_length = m_done;
+
+    m_done += result;
+    m_result = m_done;
+    m_finished = m_done >= m_length;
+    break;
+
+  default:
+    m_result = 0;
+    m_finished = true;
+    break;
+  }
+}
+
+void
+DiskRequest::perform() {
+  while (!m_finished) {
+    int64_t result;
+
+    switch (m_op) {
+    case OP_READ:
+      result = ::pread(m_fd, buffer(), length(), offset());
+      break;
+
+    case OP_FALLOCATE:
+#if defined(USE_POSIX_FALLOCATE)
+      errno = posix_fallocate(m_fd, m_offset, m_length);
+      result = errno == 0 ? 0 : -1;
+#else
+      result = 0;
+#endif
+      break;
+
+    default:
+      throw internal_error("DiskRequest::perform() invalid operation.");
+    }
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    set_result(result == -1 ? -errno : result);
+  }
+}
+
+#ifdef USE_IO_URING
+
+class DiskRing {
+public:
+  int                 m_fd;
+  int                 m_eventFd;
+
+  unsigned int        m_entries;
+
+  void*               m_ringPtr;
+  size_t              m_ringSize;
+
+  unsigned*           m_sqHead;
+  unsigned*           m_sqTail;
+  unsigned            m_sqMask;
+  unsigned*           m_sqArray;
+
+  io_uring_sqe*       m_sqes;
+  size_t              m_sqesSize;
+
+  unsigned*           m_cqHead;
+  unsigned*           m_cqTail;
+  unsigned            m_cqMask;
+  io_uring_cqe*       m_cqes;
+};
+
+static int
+disk_ring_enter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags) {
+  int result;
+
+  do {
+    result = ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+  } while (result == -1 && errno == EINTR);
+
+  return result;
+}
+
+#else
+
+class DiskRing {
+};
+
+#endif
+
+DiskEngine::DiskEngine() :
+  m_type(engine_none),
+  m_scratch(NULL),
+  m_size(0),
+  m_maxOpenFiles(16),
+  m_ring(NULL),
+  m_ringSubmitted(0),
+  m_shutdown(false),
+  m_signalWrite(-1),
+  m_statsCompleted(0),
+  m_statsFailed(0) {
+
+  m_fileDesc = -1;
+
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_condPending, NULL);
+}
+
+DiskEngine::~DiskEngine() {
+  close();
+
+  pthread_cond_destroy(&m_condPending);
+  pthread_mutex_destroy(&m_lock);
+}
+
+void
+DiskEngine::open(uint32_t type) {
+  close();
+
+  if (type == engine_none)
+    return;
+
+  if (type != engine_thread && type != engine_io_uring)
+    throw internal_error("DiskEngine::open(...) received an invalid type.");
+
+  m_scratch = new char[read_ahead_size];
+
+  if (type == engine_io_uring && open_ring()) {
+    m_type = engine_io_uring;
+    return;
+  }
+
+  open_threads();
+  m_type = engine_thread;
+}
+
+void
+DiskEngine::close() {
+  if (m_type == engine_none)
+    return;
+
+  if (m_type == engine_io_uring)
+    close_ring();
+  else
+    close_threads();
+
+  if (m_size != 0)
+    throw internal_error("DiskEngine::close() requests left after closing.");
+
+  m_type = engine_none;
+
+  delete [] m_scratch;
+  m_scratch = NULL;
+}
+
+bool
+DiskEngine::can_fallocate() const {
+  if (m_type == engine_io_uring)
+    return true;
+
+#if defined(USE_POSIX_FALLOCATE)
+  return m_type == engine_thread;
+#else
+  return false;
+#endif
+}
+
+bool
+DiskEngine::push_back(DiskRequest* request) {
+  if (!is_active() || !request->is_valid() || m_size >= m_maxOpenFiles)
+    return false;
+
+  m_size++;
+
+  if (m_type == engine_io_uring) {
+    m_pending.push_back(request);
+    submit_ring();
+
+  } else {
+    pthread_mutex_lock(&m_lock);
+    m_pending.push_back(request);
+    pthread_cond_signal(&m_condPending);
+    pthread_mutex_unlock(&m_lock);
+  }
+
+  return true;
+}
+
+bool
+DiskEngine::read_ahead(int fd, uint64_t offset, uint64_t length) {
+  while (length != 0) {
+    if (m_size >= m_maxOpenFiles - m_maxOpenFiles / 4)
+      return false;
+
+    uint64_t l = std::min<uint64_t>(length, read_ahead_size);
+    DiskRequest* request = new DiskRequest(DiskRequest::OP_READ, fd, m_scratch, offset, l);
+
+    if (!push_back(request)) {
+      delete request;
+      return false;
+    }
+
+    offset += l;
+    length -= l;
+  }
+
+  return true;
+}
+
+bool
+DiskEngine::fallocate(int fd, uint64_t offset, uint64_t length) {
+  DiskRequest* request = new DiskRequest(DiskRequest::OP_FALLOCATE, fd, NULL, offset, length);
+
+  if (!push_back(request)) {
+    delete request;
+    return false;
+  }
+
+  return true;
+}
+
+void
+DiskEngine::event_read() {
+  if (m_type == engine_io_uring) {
+#ifdef USE_IO_URING
+    uint64_t counter;
+    ssize_t __UNUSED result = ::read(m_fileDesc, &counter, sizeof(counter));
+#endif
+
+    reap_ring(false);
+    return;
+  }
+
+  char buffer[64];
+
+  while (::read(m_fileDesc, buffer, sizeof(buffer)) > 0)
+    ; // Empty.
+
+  // Pass the requests back one at a time, as the slots may queue
+  // new requests.
+  while (true) {
+    pthread_mutex_lock(&m_lock);
+
+    if (m_done.empty()) {
+      pthread_mutex_unlock(&m_lock);
+      return;
+    }
+
+    DiskRequest* request = m_done.front();
+    m_done.pop_front();
+
+    pthread_mutex_unlock(&m_lock);
+
+    finish(request);
+  }
+}
+
+void
+DiskEngine::event_write() {
+  throw internal_error("DiskEngine::event_write() called.");
+}
+
+void
+DiskEngine::event_error() {
+  throw internal_error("DiskEngine::event_error() called.");
+}
+
+void
+DiskEngine::finish(DiskRequest* request) {
+  m_size--;
+
+  if (request->result() < 0)
+    m_statsFailed++;
+  else
+    m_statsCompleted++;
+
+  if (request->slot_done().is_valid())
+    request->slot_done()(request);
+
+  delete request;
+}
+
+bool
+DiskEngine::open_ring() {
+#ifdef USE_IO_URING
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  int fd = ::syscall(__NR_io_uring_setup, ring_size, &params);
+
+  if (fd < 0)
+    return false;
+
+  // IORING_OP_READ and IORING_OP_FALLOCATE arrived
+  // in the same kernel release as IORING_FEAT_RW_CUR_POS, which also
+  // implies a single mapping for both rings.
+  if (!(params.features & IORING_FEAT_RW_CUR_POS) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    ::close(fd);
+    return false;
+  }
+
+  DiskRing* ring = new DiskRing;
+
+  ring->m_fd = fd;
+  ring->m_eventFd = -1;
+  ring->m_entries = params.sq_entries;
+
+  ring->m_ringSize = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  ring->m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+  ring->m_ringPtr = ::mmap(NULL, ring->m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  ring->m_sqes = (io_uring_sqe*)::mmap(NULL, ring->m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+  if (ring->m_ringPtr != MAP_FAILED && ring->m_sqes != MAP_FAILED)
+    ring->m_eventFd = ::eventfd(0, EFD_NONBLOCK);
+
+  if (ring->m_eventFd == -1 ||
+      ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD, &ring->m_eventFd, 1) != 0) {
+    if (ring->m_eventFd != -1)
+      ::close(ring->m_eventFd);
+
+    if (ring->m_sqes != MAP_FAILED)
+      ::munmap(ring->m_sqes, ring->m_sqesSize);
+
+    if (ring->m_ringPtr != MAP_FAILED)
+      ::munmap(ring->m_ringPtr, ring->m_ringSize);
+
+    ::close(fd);
+    delete ring;
+    return false;
+  }
+
+  char* ptr = (char*)ring->m_ringPtr;
+
+  ring->m_sqHead  = (unsigned*)(ptr + params.sq_off.head);
+  ring->m_sqTail  = (unsigned*)(ptr + params.sq_off.tail);
+  ring->m_sqMask  = *(unsigned*)(ptr + params.sq_off.ring_mask);
+  ring->m_sqArray = (unsigned*)(ptr + params.sq_off.array);
+
+  ring->m_cqHead  = (unsigned*)(ptr + params.cq_off.head);
+  ring->m_cqTail  = (unsigned*)(ptr + params.cq_off.tail);
+  ring->m_cqMask  = *(unsigned*)(ptr + params.cq_off.ring_mask);
+  ring->m_cqes    = (io_uring_cqe*)(ptr + params.cq_off.cqes);
+
+  m_ring = ring;
+  m_fileDesc = ring->m_eventFd;
+
+  manager->poll()->open(this);
+  manager->poll()->insert_read(this);
+
+  return true;
+
+#else
+  return false;
+#endif
+}
+
+void
+DiskEngine::close_ring() {
+#ifdef USE_IO_URING
+  if (m_ring == NULL)
+    return;
+
+  // Requests can't be cancelled while the buffers are in use by the
+  // kernel, so wait for everything to complete.
+  while (m_size != 0)
+    reap_ring(true);
+
+  manager->poll()->remove_read(this);
+  manager->poll()->close(this);
+
+  ::close(m_ring->m_eventFd);
+  ::munmap(m_ring->m_sqes, m_ring->m_sqesSize);
+  ::munmap(m_ring->m_ringPtr, m_ring->m_ringSize);
+  ::close(m_ring->m_fd);
+
+  delete m_ring;
+
+  m_ring = NULL;
+  m_fileDesc = -1;
+#endif
+}
+
+// Moves pending requests into the submission queue, keeping the
+// number in flight below the size of the completion queue.
+void
+DiskEngine::submit_ring() {
+#ifdef USE_IO_URING
+  unsigned tail = *m_ring->m_sqTail;
+  unsigned head = __atomic_load_n(m_ring->m_sqHead, __ATOMIC_ACQUIRE);
+
+  while (!m_pending.empty() && tail - head < m_ring->m_entries && m_ringSubmitted < m_ring->m_entries) {
+    DiskRequest* request = m_pending.front();
+    m_pending.pop_front();
+
+    unsigned index = tail & m_ring->m_sqMask;
+    io_uring_sqe* sqe = m_ring->m_sqes + index;
+
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->fd = request->fd();
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+
+    switch (request->op()) {
+    case DiskRequest::OP_READ:
+      sqe->opcode = IORING_OP_READ;
+      sqe->addr = (uint64_t)(uintptr_t)request->buffer();
+      sqe->len = std::min(request->length(), disk_max_transfer);
+      sqe->off = request->offset();
+      break;
+
+    case DiskRequest::OP_FALLOCATE:
+      // The length is passed in 'addr' and the mode in 'len'.
+      sqe->opcode = IORING_OP_FALLOCATE;
+      sqe->off = request->offset();
+      sqe->addr = request->length();
+      sqe->len = 0;
+      break;
+    }
+
+    m_ring->m_sqArray[index] = index;
+    m_ringSubmitted++;
+    tail++;
+  }
+
+  __atomic_store_n(m_ring->m_sqTail, tail, __ATOMIC_RELEASE);
+
+  unsigned toSubmit = tail - __atomic_load_n(m_ring->m_sqHead, __ATOMIC_ACQUIRE);
+
+  // Entries left in the submission queue on EAGAIN or EBUSY are
+  // picked up by the next call.
+  if (toSubmit != 0 && disk_ring_enter(m_ring->m_fd, toSubmit, 0, 0) == -1 && errno != EAGAIN && errno != EBUSY)
+    throw internal_error("DiskEngine::submit_ring() io_uring_enter failed: " + std::string(std::strerror(errno)));
+#endif
+}
+
+void
+DiskEngine::reap_ring(bool wait) {
+#ifdef USE_IO_URING
+  if (wait && disk_ring_enter(m_ring->m_fd, 0, 1, IORING_ENTER_GETEVENTS) == -1 && errno != EAGAIN && errno != EBUSY)
+    throw internal_error("DiskEngine::reap_ring(...) io_uring_enter failed: " + std::string(std::strerror(errno)));
+
+  queue_type finished;
+
+  unsigned head = *m_ring->m_cqHead;
+  unsigned tail = __atomic_load_n(m_ring->m_cqTail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    io_uring_cqe* cqe = m_ring->m_cqes + (head & m_ring->m_cqMask);
+    DiskRequest* request = (DiskRequest*)(uintptr_t)cqe->user_data;
+
+    m_ringSubmitted--;
+
+    if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+      m_pending.push_back(request);
+    } else {
+      request->set_result(cqe->res);
+
+      // Partial reads are resubmitted for the remainder.
+      if (request->is_done())
+        finished.push_back(request);
+      else
+        m_pending.push_back(request);
+    }
+
+    head++;
+  }
+
+  __atomic_store_n(m_ring->m_cqHead, head, __ATOMIC_RELEASE);
+
+  submit_ring();
+
+  std::for_each(finished.begin(), finished.end(), std::bind1st(std::mem_fun(&DiskEngine::finish), this));
+#endif
+}
+
+void
+DiskEngine::open_threads() {
+  int fd[2];
+
+  if (::pipe(fd) != 0)
+    throw resource_error("Could not create pipe for disk threads.");
+
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(fd[1], F_SETFL, O_NONBLOCK);
+
+  m_fileDesc = fd[0];
+  m_signalWrite = fd[1];
+
+  manager->poll()->open(this);
+  manager->poll()->insert_read(this);
+
+  // Block signals in the worker threads, see HashThreadPool.
+  sigset_t fullMask;
+  sigset_t oldMask;
+
+  sigfillset(&fullMask);
+  pthread_sigmask(SIG_SETMASK, &fullMask, &oldMask);
+
+  while (m_threads.size() < thread_count) {
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, &DiskEngine::thread_main, this) != 0) {
+      pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+      close_threads();
+
+      throw resource_error("Could not create disk thread.");
+    }
+
+    m_threads.push_back(thread);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+void
+DiskEngine::close_threads() {
+  // The worker threads empty the pending queue before quitting.
+  pthread_mutex_lock(&m_lock);
+  m_shutdown = true;
+  pthread_cond_broadcast(&m_condPending);
+  pthread_mutex_unlock(&m_lock);
+
+  for (thread_list::iterator itr = m_threads.begin(), last = m_threads.end(); itr != last; ++itr)
+    pthread_join(*itr, NULL);
+
+  m_threads.clear();
+  m_shutdown = false;
+
+  // Requests queued after all threads failed to start are done here.
+  while (!m_pending.empty()) {
+    m_pending.front()->perform();
+    m_done.push_back(m_pending.front());
+    m_pending.pop_front();
+  }
+
+  while (!m_done.empty()) {
+    DiskRequest* request = m_done.front();
+    m_done.pop_front();
+
+    finish(request);
+  }
+
+  if (m_fileDesc == -1)
+    return;
+
+  manager->poll()->remove_read(this);
+  manager->poll()->close(this);
+
+  ::close(m_fileDesc);
+  ::close(m_signalWrite);
+
+  m_fileDesc = -1;
+  m_signalWrite = -1;
+}
+
+void*
+DiskEngine::thread_main(void* engine) {
+  static_cast<DiskEngine*>(engine)->thread_perform();
+  return NULL;
+}
+
+void
+DiskEngine::thread_perform() {
+  pthread_mutex_lock(&m_lock);
+
+  while (true) {
+    while (m_pending.empty() && !m_shutdown)
+      pthread_cond_wait(&m_condPending, &m_lock);
+
+    if (m_pending.empty())
+      break;
+
+    DiskRequest* request = m_pending.front();
+    m_pending.pop_front();
+
+    pthread_mutex_unlock(&m_lock);
+
+    request->perform();
+
+    pthread_mutex_lock(&m_lock);
+
+    m_done.push_back(request);
+
+    // The main thread empties the pipe before taking the done queue,
+    // so only signal when the first request gets added.
+    if (m_done.size() == 1) {
+      char c = 0;
+      ssize_t __UNUSED result = ::write(m_signalWrite, &c, 1);
+    }
+  }
+
+  pthread_mutex_unlock(&m_lock);
+}
+
+}
@@ -0,0 +1,227 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#ifndef LIBTORRENT_DATA_DISK_ENGINE_H
+#define LIBTORRENT_DATA_DISK_ENGINE_H
+
+#include <deque>
+#include <vector>
+#include <inttypes.h>
+#include <pthread.h>
+#include <rak/functional_fun.h>
+
+#include "torrent/event.h"
+
+namespace torrent {
+
+class DiskRing;
+
+// A single disk operation. The file descriptor is duplicated when
+// the request is created so that the file manager may close the
+// original while the request is in flight, the engine limits the
+// number of queued requests to keep these within the reserved file
+// descriptors.
+//
+// The result is the number of bytes transferred, or -errno on
+// failure.
+
+class DiskRequest {
+public:
+  typedef rak::function1<void, DiskRequest*> slot_type;
+
+  typedef enum {
+    OP_READ,
+    OP_FALLOCATE
+  } op_type;
+
+  DiskRequest(op_type op, int fd, char* buffer, uint64_t offset, uint64_t length);
+  ~DiskRequest();
+
+  bool                is_valid() const                  { return m_fd != -1; }
+  bool                is_done() const                   { return m_finished; }
+
+  op_type             op() const                        { return m_op; }
+  int                 fd() const                        { return m_fd; }
+
+  char*               buffer() const                    { return m_buffer + m_done; }
+  uint64_t            offset() const                    { return m_offset + m_done; }
+  uint64_t            length() const                    { return m_length - m_done; }
+
+  int64_t             result() const                    { return m_result; }
+
+  // Called with the result of a partial or complete operation,
+  // reads that transfer less than requested continue from where they
+  // stopped.
+  void                set_result(int64_t result);
+
+  // Runs the operation synchronously until done, used by the worker
+  // threads.
+  void                perform();
+
+  slot_type&          slot_done()                       { return m_slotDone; }
+
+private:
+  DiskRequest(const DiskRequest&);
+  void operator = (const DiskRequest&);
+
+  op_type             m_op;
+  int                 m_fd;
+
+  char*               m_buffer;
+  uint64_t            m_offset;
+  uint64_t            m_length;
+  uint64_t            m_done;
+
+  int64_t             m_result;
+  bool                m_finished;
+
+  slot_type           m_slotDone;
+};
+
+// Executes disk requests off the main thread, either through io_uring
+// or a small pool of worker threads when io_uring isn't available.
+// It is used for read-ahead of chunks about to be uploaded and for
+// allocating new files; mapping, msync and the pread/pwrite storage
+// backend still run on the main thread.
+// Completions are signaled through a descriptor registered with the
+// main thread's Poll, an eventfd for io_uring or a pipe for the
+// threads, and the request's slot is called from 'event_read'.
+//
+// When the engine is closed the users fall back to doing the work
+// synchronously.
+
+class DiskEngine : public Event {
+public:
+  typedef std::deque<DiskRequest*> queue_type;
+  typedef std::vector<pthread_t>   thread_list;
+
+  static const uint32_t engine_none     = 0;
+  static const uint32_t engine_thread   = 1;
+  static const uint32_t engine_io_uring = 2;
+
+  static const unsigned int thread_count   = 4;
+  static const unsigned int ring_size      = 64;
+
+  // Read-ahead requests are split into pieces of this size, all of
+  // which read into the same scratch buffer as the data is only used
+  // to fill the page cache.
+  static const uint32_t read_ahead_size = 256 << 10;
+
+  DiskEngine();
+  ~DiskEngine();
+
+  bool                is_active() const                 { return m_type != engine_none; }
+  uint32_t            type() const                      { return m_type; }
+
+  // The worker threads can only allocate with posix_fallocate, when
+  // this is false the caller must allocate synchronously.
+  bool                can_fallocate() const;
+
+  // Opening with 'engine_io_uring' falls back to 'engine_thread' if
+  // the kernel doesn't support it. Closing waits for all requests
+  // in flight to complete.
+  void                open(uint32_t type);
+  void                close();
+
+  // Takes ownership of the request. Returns false if the request
+  // could not be queued, in which case the caller still owns it.
+  bool                push_back(DiskRequest* request);
+
+  bool                read_ahead(int fd, uint64_t offset, uint64_t length);
+  bool                fallocate(int fd, uint64_t offset, uint64_t length);
+
+  unsigned int        size() const                      { return m_size; }
+
+  // Each queued request holds a duplicated file descriptor, so the
+  // number of requests is limited to what torrent::initialize
+  // reserves for the engine. Read-ahead is only a hint and leaves a
+  // quarter of these free for other requests.
+  unsigned int        max_open_files() const            { return m_maxOpenFiles; }
+  void                set_max_open_files(unsigned int s) { m_maxOpenFiles = s; }
+
+  uint64_t            stats_completed() const           { return m_statsCompleted; }
+  uint64_t            stats_failed() const              { return m_statsFailed; }
+
+  virtual void        event_read();
+  virtual void        event_write();
+  virtual void        event_error();
+
+private:
+  DiskEngine(const DiskEngine&);
+  void operator = (const DiskEngine&);
+
+  void                finish(DiskRequest* request);
+
+  bool                open_ring();
+  void                close_ring();
+  void                submit_ring();
+  void                reap_ring(bool wait);
+
+  void                open_threads();
+  void                close_threads();
+
+  static void*        thread_main(void* engine);
+  void                thread_perform();
+
+  uint32_t            m_type;
+
+  char*               m_scratch;
+
+  unsigned int        m_size;
+  unsigned int        m_maxOpenFiles;
+
+  // Requests not yet passed to io_uring or picked up by a worker.
+  queue_type          m_pending;
+
+  DiskRing*           m_ring;
+  unsigned int        m_ringSubmitted;
+
+  pthread_mutex_t     m_lock;
+  pthread_cond_t      m_condPending;
+
+  bool                m_shutdown;
+  int                 m_signalWrite;
+
+  thread_list         m_threads;
+  queue_type          m_done;
+
+  uint64_t            m_statsCompleted;
+  uint64_t            m_statsFailed;
+};
+
+}
+
+#endif
@@ -36,12 +36,24 @@
 
 #include "config.h"
 
+#include <cstring>
+
+#include "utils/sha1_batch.h"
+
 #include "hash_chunk.h"
 #include "chunk.h"
 #include "chunk_list_node.h"
 
 namespace torrent {
 
+void
+HashChunk::hash_c(char* buffer) {
+  if (m_batched)
+    std::memcpy(buffer, m_digest, 20);
+  else
+    m_hash.final_c(buffer);
+}
+
 bool
 HashChunk::perform(uint32_t length, bool force) {
   length = std::min(length, remaining());
@@ -70,6 +82,9 @@ HashChunk::advise_willneed(uint32_t length) {
   if (m_position + length > m_chunk.chunk()->chunk_size())
     throw internal_error("HashChunk::willneed(...) received length out of range");
 
+  if (m_chunk.chunk()->is_buffered())
+    return;
+
   uint32_t pos = m_position;
 
   while (length) {
@@ -85,6 +100,54 @@ HashChunk::advise_willneed(uint32_t length) {
   }
 }
 
+// Each lane gets the span to the end of the current chunk part, so
+// lanes only fall out of step at file boundaries.
+void
+HashChunk::perform_batch(HashChunk** first, HashChunk** last) {
+  for (HashChunk** itr = first; itr != last; ++itr)
+    if (!(*itr)->is_untouched())
+      throw internal_error("HashChunk::perform_batch(...) received a chunk that has been partially hashed.");
+
+  Sha1Batch batch;
+  batch.init(std::distance(first, last));
+
+  while (true) {
+    const char* data[Sha1Batch::max_lanes];
+    uint32_t    length[Sha1Batch::max_lanes];
+
+    bool done = true;
+
+    for (HashChunk** itr = first; itr != last; ++itr) {
+      HashChunk* hc = *itr;
+      unsigned int lane = std::distance(first, itr);
+
+      if (hc->remaining() == 0) {
+        data[lane] = NULL;
+        length[lane] = 0;
+        continue;
+      }
+
+      Chunk::iterator part = hc->m_chunk.chunk()->at_position(hc->m_position);
+
+      data[lane] = (const char*)part->chunk().begin() + hc->m_position - part->position();
+      length[lane] = hc->remaining_part(part, hc->m_position);
+
+      hc->m_position += length[lane];
+      done = false;
+    }
+
+    if (done)
+      break;
+
+    batch.update(data, length);
+  }
+
+  for (HashChunk** itr = first; itr != last; ++itr) {
+    batch.final_c(std::distance(first, itr), (*itr)->m_digest);
+    (*itr)->m_batched = true;
+  }
+}
+
 uint32_t
 HashChunk::perform_part(Chunk::iterator itr, uint32_t length) {
   length = std::min(length, remaining_part(itr, m_position));
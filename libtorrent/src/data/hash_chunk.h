@@ -56,14 +56,26 @@ public:
   HashChunk()         {}
   HashChunk(ChunkHandle h)  { set_chunk(h); }
   
-  void                set_chunk(ChunkHandle h)                { m_position = 0; m_chunk = h; m_hash.init(); }
+  void                set_chunk(ChunkHandle h)                { m_position = 0; m_batched = false; m_chunk = h; m_hash.init(); }
+
+  // Use the state of a hash computed while the chunk was downloaded,
+  // leaving only the digest to be calculated.
+  void                set_hash_state(const Sha1& state)       { m_position = m_chunk.chunk()->chunk_size(); m_hash = state; }
+
+  // Untouched chunks may be hashed together with other chunks by
+  // perform_batch.
+  bool                is_untouched() const                    { return m_position == 0; }
 
   ChunkHandle*        chunk()                                 { return &m_chunk; }
-  void                hash_c(char* buffer)                    { m_hash.final_c(buffer); }
+  void                hash_c(char* buffer);
 
   // If force is true, then the return value is always true.
   bool                perform(uint32_t length, bool force = true);
 
+  // Hashes the whole of each chunk in the range using the SHA1 lanes
+  // of Sha1Batch, all chunks must be untouched.
+  static void         perform_batch(HashChunk** first, HashChunk** last);
+
   void                advise_willneed(uint32_t length);
 
   uint32_t            remaining();
@@ -73,9 +85,12 @@ private:
   uint32_t            perform_part(Chunk::iterator itr, uint32_t length);
 
   uint32_t            m_position;
+  bool                m_batched;
 
   ChunkHandle         m_chunk;
   Sha1                m_hash;
+
+  char                m_digest[20];
 };
 
 inline uint32_t
@@ -43,9 +43,11 @@
 
 #include "hash_queue.h"
 #include "hash_chunk.h"
+#include "hash_thread_pool.h"
 #include "chunk.h"
 #include "chunk_list_node.h"
 #include "globals.h"
+#include "utils/sha1_batch.h"
 
 namespace torrent {
 
@@ -74,9 +76,16 @@ struct HashQueueWillneed {
 HashQueue::HashQueue() :
   m_readAhead(10 << 20),
   m_interval(2000),
-  m_maxTries(5) {
+  m_maxTries(5),
+  m_threadPool(new HashThreadPool) {
 
   m_taskWork.set_slot(rak::mem_fn(this, &HashQueue::work));
+  m_threadPool->slot_chunk_done(rak::make_mem_fun(this, &HashQueue::receive_chunk_done));
+}
+
+HashQueue::~HashQueue() {
+  clear();
+  delete m_threadPool;
 }
 
 
@@ -88,12 +97,23 @@ HashQueue::willneed(int bytes) {
 // If we're done immediately, move the chunk to the front of the list so
 // the next work cycle gets stuff done.
 void
-HashQueue::push_back(ChunkHandle handle, slot_done_type d) {
+HashQueue::push_back(ChunkHandle handle, slot_done_type d, const Sha1* state) {
   if (!handle.is_valid())
     throw internal_error("HashQueue::add(...) received an invalid chunk");
 
   HashChunk* hc = new HashChunk(handle);
 
+  if (state != NULL)
+    hc->set_hash_state(*state);
+
+  if (m_threadPool->is_active()) {
+    base_type::push_back(HashQueueNode(hc, d));
+    base_type::back().call_willneed();
+
+    m_threadPool->push_back(hc);
+    return;
+  }
+
   if (empty()) {
     if (m_taskWork.is_queued())
       throw internal_error("Empty HashQueue is still in task schedule");
@@ -107,7 +127,13 @@ HashQueue::push_back(ChunkHandle handle, slot_done_type d) {
   // Try to hash as much as possible immediately if incore, so that a
   // newly downloaded chunk doesn't get swapped out when downloading
   // at high speeds / low memory.
-  base_type::back().perform_remaining(false);
+  //
+  // With multiple SHA1 lanes and other chunks already pending, leave
+  // it untouched so that 'work', which runs in the next scheduler
+  // pass, can hash it together with those. A lone chunk has nothing
+  // to batch with.
+  if (Sha1Batch::lane_count() == 1 || size() == 1)
+    base_type::back().perform_remaining(false);
 
   // Properly adjust this so it doesn't willneed on already hashed
   // memory regions.
@@ -134,6 +160,8 @@ HashQueue::remove(HashQueueNode::id_type id) {
   iterator itr = begin();
   
   while ((itr = std::find_if(itr, end(), rak::equal(id, std::mem_fun_ref(&HashQueueNode::id)))) != end()) {
+    m_threadPool->erase(itr->get_chunk());
+
     itr->slot_done()(*itr->get_chunk()->chunk(), NULL);
 
     itr->clear();
@@ -155,6 +183,44 @@ HashQueue::clear() {
 //   priority_queue_erase(&taskScheduler, &m_taskWork);
 }
 
+uint32_t
+HashQueue::thread_count() const {
+  return m_threadPool->size();
+}
+
+// Switching between threaded and non-threaded hashing moves all the
+// queued chunks over, so that either the thread pool or 'work' owns
+// every node in the queue.
+void
+HashQueue::set_thread_count(uint32_t count) {
+  if (count == m_threadPool->size())
+    return;
+
+  bool wasActive = m_threadPool->is_active();
+
+  m_threadPool->resize(count);
+
+  if (count != 0 && !wasActive) {
+    priority_queue_erase(&taskScheduler, &m_taskWork);
+
+    for (iterator itr = begin(), last = end(); itr != last; ++itr)
+      m_threadPool->push_back(itr->get_chunk());
+
+  } else if (count == 0 && wasActive) {
+    HashThreadPool::queue_type done;
+
+    m_threadPool->take_pending(&done);
+    m_threadPool->take_done(&done);
+
+    std::for_each(done.begin(), done.end(), std::bind1st(std::mem_fun(&HashQueue::receive_chunk_done), this));
+
+    if (!empty() && !m_taskWork.is_queued()) {
+      m_tries = 0;
+      priority_queue_insert(&taskScheduler, &m_taskWork, cachedTime + 1);
+    }
+  }
+}
+
 void
 HashQueue::work() {
   while (!empty()) {
@@ -179,7 +245,7 @@ HashQueue::check(bool force) {
   // are only trying to hash the first chunk. Fix this so that only
   // whole chunks are called with will-need and that we check mincore
   // for all those chunks in case we can hash them.
-  if (base_type::front().get_chunk()->remaining() != 0 && !base_type::front().perform_remaining(force)) {
+  if (base_type::front().get_chunk()->remaining() != 0 && !check_batch(force) && !base_type::front().perform_remaining(force)) {
     willneed(m_readAhead);
     return false;
   }
@@ -202,4 +268,58 @@ HashQueue::check(bool force) {
   return true;
 }
 
+// Hash the front chunk together with the following untouched chunks
+// that are already in memory. Returns false if the front chunk can't
+// be hashed this way, or there are no other chunks to batch it with.
+bool
+HashQueue::check_batch(bool force) {
+  unsigned int lanes = Sha1Batch::lane_count();
+
+  if (lanes == 1 || !front().get_chunk()->is_untouched())
+    return false;
+
+  if (!force && !front().get_chunk()->chunk()->chunk()->is_incore(0))
+    return false;
+
+  HashChunk*  batch[Sha1Batch::max_lanes];
+  HashChunk** last = batch;
+
+  *last++ = front().get_chunk();
+
+  // Limit the search as each is_incore call does a mincore.
+  for (iterator itr = begin() + 1, end = begin() + std::min<size_type>(size(), 2 * lanes);
+       itr != end && last != batch + lanes; ++itr)
+    if (itr->get_chunk()->is_untouched() && itr->get_chunk()->chunk()->chunk()->is_incore(0))
+      *last++ = itr->get_chunk();
+
+  if (last - batch < 2)
+    return false;
+
+  HashChunk::perform_batch(batch, last);
+  return true;
+}
+
+// Called for chunks passed back from the thread pool. When the pool
+// is shrunk to zero threads, chunks that have not been completely
+// hashed are left in the queue for 'work'.
+void
+HashQueue::receive_chunk_done(HashChunk* chunk) {
+  iterator itr = std::find_if(begin(), end(), rak::equal(chunk, std::mem_fun_ref(&HashQueueNode::get_chunk)));
+
+  if (itr == end())
+    throw internal_error("HashQueue::receive_chunk_done(...) could not find the chunk.");
+
+  if (chunk->remaining() != 0)
+    return;
+
+  HashQueueNode::slot_done_type slotDone = itr->slot_done();
+  erase(itr);
+
+  char buffer[20];
+  chunk->hash_c(buffer);
+
+  slotDone(*chunk->chunk(), buffer);
+  delete chunk;
+}
+
 }
@@ -46,6 +46,8 @@
 namespace torrent {
 
 class HashChunk;
+class HashThreadPool;
+class Sha1;
 
 // Calculating hash of incore memory is blindingly fast, it's always
 // the loading from swap/disk that takes time. So with the exception
@@ -67,9 +69,11 @@ public:
   using base_type::end;
 
   HashQueue();
-  ~HashQueue() { clear(); }
+  ~HashQueue();
 
-  void                push_back(ChunkHandle handle, slot_done_type d);
+  // If 'state' is non-NULL it contains the hash of the whole chunk,
+  // and only the digest is calculated.
+  void                push_back(ChunkHandle handle, slot_done_type d, const Sha1* state = NULL);
 
   bool                has(HashQueueNode::id_type id);
   bool                has(HashQueueNode::id_type id, uint32_t index);
@@ -88,8 +92,16 @@ public:
   uint32_t            max_tries() const              { return m_maxTries; }
   void                set_max_tries(uint32_t tries)  { m_maxTries = tries; }
 
+  // When threads are used all the chunks are hashed by the thread
+  // pool, else they are hashed on the main thread by 'work'.
+  uint32_t            thread_count() const;
+  void                set_thread_count(uint32_t count);
+
 private:
   bool                check(bool force);
+  bool                check_batch(bool force);
+
+  void                receive_chunk_done(HashChunk* chunk);
 
   inline void         willneed(int bytes);
 
@@ -99,6 +111,8 @@ private:
   uint32_t            m_readAhead;
   uint32_t            m_interval;
   uint32_t            m_maxTries;
+
+  HashThreadPool*     m_threadPool;
 };
 
 }
@@ -0,0 +1,323 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#include "config.h"
+
+#include <algorithm>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "torrent/exceptions.h"
+#include "torrent/poll.h"
+
+#include "utils/sha1_batch.h"
+
+#include "hash_chunk.h"
+#include "hash_thread_pool.h"
+#include "manager.h"
+
+namespace torrent {
+
+HashThreadPool::HashThreadPool() :
+  m_shutdown(false),
+  m_signalWrite(-1) {
+
+  m_fileDesc = -1;
+
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_condPending, NULL);
+  pthread_cond_init(&m_condDone, NULL);
+}
+
+HashThreadPool::~HashThreadPool() {
+  stop_threads();
+  close_signal();
+
+  pthread_cond_destroy(&m_condDone);
+  pthread_cond_destroy(&m_condPending);
+  pthread_mutex_destroy(&m_lock);
+}
+
+void
+HashThreadPool::resize(unsigned int count) {
+  stop_threads();
+
+  if (count == 0)
+    return;
+
+  open_signal();
+
+  // The worker threads inherit the signal mask, so block everything
+  // while creating them to ensure the client's signal handlers only
+  // get called on the main thread.
+  sigset_t fullMask;
+  sigset_t oldMask;
+
+  sigfillset(&fullMask);
+  pthread_sigmask(SIG_SETMASK, &fullMask, &oldMask);
+
+  while (m_threads.size() < count) {
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, &HashThreadPool::thread_main, this) != 0) {
+      pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+      stop_threads();
+
+      throw resource_error("Could not create hash checking thread.");
+    }
+
+    m_threads.push_back(thread);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+void
+HashThreadPool::push_back(HashChunk* chunk) {
+  if (!is_active())
+    throw internal_error("HashThreadPool::push_back(...) called but no threads are running.");
+
+  pthread_mutex_lock(&m_lock);
+  m_pending.push_back(chunk);
+  pthread_cond_signal(&m_condPending);
+  pthread_mutex_unlock(&m_lock);
+}
+
+void
+HashThreadPool::erase(HashChunk* chunk) {
+  pthread_mutex_lock(&m_lock);
+
+  queue_type::iterator itr = std::find(m_pending.begin(), m_pending.end(), chunk);
+
+  if (itr != m_pending.end()) {
+    m_pending.erase(itr);
+
+  } else {
+    // Wait for the worker thread to finish as it can't be
+    // interrupted, this is at most a single chunk.
+    while (std::find(m_active.begin(), m_active.end(), chunk) != m_active.end())
+      pthread_cond_wait(&m_condDone, &m_lock);
+
+    itr = std::find(m_done.begin(), m_done.end(), chunk);
+
+    if (itr != m_done.end())
+      m_done.erase(itr);
+  }
+
+  pthread_mutex_unlock(&m_lock);
+}
+
+void
+HashThreadPool::take_pending(queue_type* dest) {
+  pthread_mutex_lock(&m_lock);
+  dest->insert(dest->end(), m_pending.begin(), m_pending.end());
+  m_pending.clear();
+  pthread_mutex_unlock(&m_lock);
+}
+
+void
+HashThreadPool::take_done(queue_type* dest) {
+  pthread_mutex_lock(&m_lock);
+
+  while (!m_active.empty())
+    pthread_cond_wait(&m_condDone, &m_lock);
+
+  dest->insert(dest->end(), m_done.begin(), m_done.end());
+  m_done.clear();
+  pthread_mutex_unlock(&m_lock);
+}
+
+// Pass the chunks back one at a time, as the slot might remove other
+// chunks from the pool.
+void
+HashThreadPool::event_read() {
+  char buffer[64];
+
+  while (::read(m_fileDesc, buffer, sizeof(buffer)) > 0)
+    ; // Empty.
+
+  while (true) {
+    pthread_mutex_lock(&m_lock);
+
+    if (m_done.empty()) {
+      pthread_mutex_unlock(&m_lock);
+      return;
+    }
+
+    HashChunk* chunk = m_done.front();
+    m_done.pop_front();
+
+    pthread_mutex_unlock(&m_lock);
+
+    m_slotChunkDone(chunk);
+  }
+}
+
+void
+HashThreadPool::event_write() {
+  throw internal_error("HashThreadPool::event_write() called.");
+}
+
+void
+HashThreadPool::event_error() {
+  throw internal_error("HashThreadPool::event_error() called.");
+}
+
+void
+HashThreadPool::open_signal() {
+  if (m_fileDesc != -1)
+    return;
+
+  int fd[2];
+
+  if (::pipe(fd) != 0)
+    throw resource_error("Could not create pipe for hash checking threads.");
+
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(fd[1], F_SETFL, O_NONBLOCK);
+
+  m_fileDesc = fd[0];
+  m_signalWrite = fd[1];
+
+  manager->poll()->open(this);
+  manager->poll()->insert_read(this);
+}
+
+void
+HashThreadPool::close_signal() {
+  if (m_fileDesc == -1)
+    return;
+
+  manager->poll()->remove_read(this);
+  manager->poll()->close(this);
+
+  ::close(m_fileDesc);
+  ::close(m_signalWrite);
+
+  m_fileDesc = -1;
+  m_signalWrite = -1;
+}
+
+void
+HashThreadPool::stop_threads() {
+  if (m_threads.empty())
+    return;
+
+  pthread_mutex_lock(&m_lock);
+  m_shutdown = true;
+  pthread_cond_broadcast(&m_condPending);
+  pthread_mutex_unlock(&m_lock);
+
+  for (thread_list::iterator itr = m_threads.begin(), last = m_threads.end(); itr != last; ++itr)
+    pthread_join(*itr, NULL);
+
+  m_threads.clear();
+  m_shutdown = false;
+}
+
+void*
+HashThreadPool::thread_main(void* pool) {
+  static_cast<HashThreadPool*>(pool)->thread_perform();
+  return NULL;
+}
+
+void
+HashThreadPool::thread_perform() {
+  unsigned int lanes = Sha1Batch::lane_count();
+
+  pthread_mutex_lock(&m_lock);
+
+  while (true) {
+    while (m_pending.empty() && !m_shutdown)
+      pthread_cond_wait(&m_condPending, &m_lock);
+
+    if (m_shutdown)
+      break;
+
+    // Take as many untouched chunks as there are SHA1 lanes, chunks
+    // passed over from the main thread's queue may already be
+    // partially hashed and need to be done on their own.
+    HashChunk*  batch[Sha1Batch::max_lanes];
+    HashChunk** last = batch;
+
+    *last++ = m_pending.front();
+    m_pending.pop_front();
+
+    if (batch[0]->is_untouched()) {
+      queue_type::iterator itr = m_pending.begin();
+
+      while (itr != m_pending.end() && last != batch + lanes) {
+        if ((*itr)->is_untouched()) {
+          *last++ = *itr;
+          itr = m_pending.erase(itr);
+        } else {
+          ++itr;
+        }
+      }
+    }
+
+    m_active.insert(m_active.end(), batch, last);
+
+    pthread_mutex_unlock(&m_lock);
+
+    if (last - batch > 1)
+      HashChunk::perform_batch(batch, last);
+    else
+      batch[0]->perform(batch[0]->remaining(), true);
+
+    pthread_mutex_lock(&m_lock);
+
+    for (HashChunk** itr = batch; itr != last; ++itr) {
+      m_active.erase(std::find(m_active.begin(), m_active.end(), *itr));
+      m_done.push_back(*itr);
+    }
+
+    pthread_cond_broadcast(&m_condDone);
+
+    // The main thread empties the pipe before taking the done queue,
+    // so only signal when the first chunks get added. If the pipe is
+    // full the main thread has already been signaled.
+    if (m_done.size() == (unsigned int)(last - batch)) {
+      char c = 0;
+      ssize_t __UNUSED result = ::write(m_signalWrite, &c, 1);
+    }
+  }
+
+  pthread_mutex_unlock(&m_lock);
+}
+
+}
@@ -0,0 +1,125 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#ifndef LIBTORRENT_DATA_HASH_THREAD_POOL_H
+#define LIBTORRENT_DATA_HASH_THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+#include <rak/functional.h>
+
+#include "torrent/event.h"
+
+namespace torrent {
+
+class HashChunk;
+class HashQueue;
+
+// Pool of threads that take HashChunk's from HashQueue and hash the
+// whole chunk, page faults and all, off the main thread. Finished
+// chunks are collected and a byte is written to a pipe that is
+// registered with the main thread's Poll, which then passes them
+// back to HashQueue in 'event_read'.
+//
+// Only 'HashChunk::perform' is called from the worker threads, the
+// ChunkHandle is owned by the main thread until the chunk is passed
+// back.
+
+class HashThreadPool : public Event {
+public:
+  typedef std::deque<HashChunk*>                  queue_type;
+  typedef std::vector<pthread_t>                  thread_list;
+  typedef rak::mem_fun1<HashQueue, void, HashChunk*> slot_chunk_type;
+
+  HashThreadPool();
+  ~HashThreadPool();
+
+  bool                is_active() const                 { return !m_threads.empty(); }
+  unsigned int        size() const                      { return m_threads.size(); }
+
+  // Stops all the threads before starting 'count' new ones. Queued
+  // chunks are left in the pending queue.
+  void                resize(unsigned int count);
+
+  void                push_back(HashChunk* chunk);
+
+  // Removes the chunk from the pool, waiting for a worker thread to
+  // finish it if it is being hashed.
+  void                erase(HashChunk* chunk);
+
+  // Takes back the chunks that have not yet been picked up by a
+  // worker thread, and those that are done but not yet passed back.
+  void                take_pending(queue_type* dest);
+  void                take_done(queue_type* dest);
+
+  void                slot_chunk_done(slot_chunk_type s) { m_slotChunkDone = s; }
+
+  virtual void        event_read();
+  virtual void        event_write();
+  virtual void        event_error();
+
+private:
+  HashThreadPool(const HashThreadPool&);
+  void operator = (const HashThreadPool&);
+
+  void                open_signal();
+  void                close_signal();
+
+  void                stop_threads();
+
+  static void*        thread_main(void* pool);
+  void                thread_perform();
+
+  pthread_mutex_t     m_lock;
+  pthread_cond_t      m_condPending;
+  pthread_cond_t      m_condDone;
+
+  bool                m_shutdown;
+  int                 m_signalWrite;
+
+  thread_list         m_threads;
+
+  queue_type          m_pending;
+  queue_type          m_active;
+  queue_type          m_done;
+
+  slot_chunk_type     m_slotChunkDone;
+};
+
+}
+
+#endif
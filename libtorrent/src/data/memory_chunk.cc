@@ -36,6 +36,9 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/mman.h>
@@ -48,6 +51,29 @@ namespace torrent {
 
 uint32_t MemoryChunk::m_pagesize = getpagesize();
 
+// Released buffers are pooled by size class, the length rounded up
+// to a power of two. Chunks are a power of two in size, so the parts
+// of chunks not crossing file boundaries share a class with any other
+// such part.
+static const unsigned int buffer_pool_classes = 32;
+
+typedef std::vector<char*> buffer_pool_type;
+
+static buffer_pool_type buffer_pool[buffer_pool_classes];
+static uint64_t         buffer_pool_used = 0;
+
+uint64_t MemoryChunk::m_bufferPoolMaxSize = 32 << 20;
+
+static unsigned int
+buffer_class(uint32_t length) {
+  unsigned int c = 0;
+
+  while (((uint32_t)1 << c) < length)
+    c++;
+
+  return c;
+}
+
 inline void
 MemoryChunk::align_pair(uint32_t* offset, uint32_t* length) const {
   *offset += page_align();
@@ -82,6 +108,64 @@ MemoryChunk::unmap() {
     throw internal_error("MemoryChunk::unmap() system call failed: " + std::string(rak::error_number::current().c_str()));
 }  
 
+char*
+MemoryChunk::allocate_buffer(uint32_t length) {
+  unsigned int c = buffer_class(std::max(length, m_pagesize));
+
+  if (c >= buffer_pool_classes)
+    return NULL;
+
+  if (!buffer_pool[c].empty()) {
+    char* ptr = buffer_pool[c].back();
+
+    buffer_pool[c].pop_back();
+    buffer_pool_used -= (uint64_t)1 << c;
+    return ptr;
+  }
+
+  char* ptr = NULL;
+
+  if (posix_memalign((void**)&ptr, m_pagesize, (size_t)1 << c) != 0)
+    return NULL;
+
+  return ptr;
+}
+
+void
+MemoryChunk::free_buffer() {
+  if (!is_valid())
+    throw internal_error("MemoryChunk::free_buffer() called on an invalid object");
+
+  unsigned int c = buffer_class(std::max<uint32_t>(m_end - m_ptr, m_pagesize));
+
+  if (buffer_pool_used + ((uint64_t)1 << c) > m_bufferPoolMaxSize) {
+    free(m_ptr);
+    return;
+  }
+
+  buffer_pool_used += (uint64_t)1 << c;
+  buffer_pool[c].push_back(m_ptr);
+}
+
+uint64_t
+MemoryChunk::buffer_pool_size() {
+  return buffer_pool_used;
+}
+
+// Release pooled buffers, largest first, until the pool fits.
+void
+MemoryChunk::set_buffer_pool_max_size(uint64_t size) {
+  m_bufferPoolMaxSize = size;
+
+  for (unsigned int c = buffer_pool_classes; c-- != 0 && buffer_pool_used > size; )
+    while (!buffer_pool[c].empty() && buffer_pool_used > size) {
+      free(buffer_pool[c].back());
+
+      buffer_pool[c].pop_back();
+      buffer_pool_used -= (uint64_t)1 << c;
+    }
+}
+
 void
 MemoryChunk::incore(char* buf, uint32_t offset, uint32_t length) {
   if (!is_valid())
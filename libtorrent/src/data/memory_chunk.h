@@ -98,6 +98,17 @@ class MemoryChunk {
   inline void         clear();
   void                unmap();
 
+  // Page-aligned heap buffers used by the pread/pwrite storage
+  // backend. Released buffers are kept in a pool, of at most
+  // 'buffer_pool_max_size' bytes, so that chunk-sized allocations
+  // don't hit the allocator every time.
+  static char*        allocate_buffer(uint32_t length);
+  void                free_buffer();
+
+  static uint64_t     buffer_pool_size();
+  static uint64_t     buffer_pool_max_size()                               { return m_bufferPoolMaxSize; }
+  static void         set_buffer_pool_max_size(uint64_t size);
+
   // Use errno and strerror if you want to know why these failed.
   void                incore(char* buf, uint32_t offset, uint32_t length);
   bool                advise(uint32_t offset, uint32_t length, int advice);
@@ -119,6 +130,7 @@ private:
   inline void         align_pair(uint32_t* offset, uint32_t* length) const;
 
   static uint32_t     m_pagesize;
+  static uint64_t     m_bufferPoolMaxSize;
 
   char*               m_ptr;
   char*               m_begin;
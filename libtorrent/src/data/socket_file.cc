@@ -39,6 +39,8 @@
 #include "socket_file.h"
 #include "torrent/exceptions.h"
 
+#include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <unistd.h>
 #include <rak/error_number.h>
@@ -171,5 +173,71 @@ SocketFile::create_chunk(uint64_t offset, uint32_t length, int prot, int flags)
   return MemoryChunk(ptr, ptr + align, ptr + align + length, prot, flags);
 }
 
+MemoryChunk
+SocketFile::create_buffer(uint64_t offset, uint32_t length, int prot) const {
+  if (!is_open())
+    throw internal_error("SocketFile::create_buffer() called on a closed file");
+
+  if (length == 0 || offset > size() || offset + length > size())
+    return MemoryChunk();
+
+  char* ptr = MemoryChunk::allocate_buffer(length);
+
+  if (ptr == NULL) {
+    rak::error_number::set_global(rak::error_number::e_nomem);
+    return MemoryChunk();
+  }
+
+  MemoryChunk chunk(ptr, ptr, ptr + length, prot, 0);
+  uint32_t done = 0;
+
+  while (done != length) {
+    ssize_t result = ::pread(m_fd, ptr + done, length - done, offset + done);
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    if (result == -1) {
+      int saved = errno;
+
+      chunk.free_buffer();
+      errno = saved;
+      return MemoryChunk();
+    }
+
+    // Sparse files might be shorter than expected if another process
+    // truncated them, treat the remainder as zero-filled.
+    if (result == 0) {
+      std::memset(ptr + done, 0, length - done);
+      break;
+    }
+
+    done += result;
+  }
+
+  return chunk;
+}
+
+bool
+SocketFile::write_buffer(const char* buffer, uint64_t offset, uint32_t length) const {
+  if (!is_open())
+    throw internal_error("SocketFile::write_buffer() called on a closed file");
+
+  while (length != 0) {
+    ssize_t result = ::pwrite(m_fd, buffer, length, offset);
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    if (result <= 0)
+      return false;
+
+    buffer += result;
+    offset += result;
+    length -= result;
+  }
+
+  return true;
 }
 
+}
@@ -73,6 +73,11 @@ public:
   bool                set_size(uint64_t s, int flags = 0) const;
 
   MemoryChunk         create_chunk(uint64_t offset, uint32_t length, int prot, int flags) const;
+
+  // Read the range into a pooled buffer instead of mapping it, the
+  // caller is responsible for writing back modified buffers.
+  MemoryChunk         create_buffer(uint64_t offset, uint32_t length, int prot) const;
+  bool                write_buffer(const char* buffer, uint64_t offset, uint32_t length) const;
   
   fd_type             fd() const                                        { return m_fd; }
 
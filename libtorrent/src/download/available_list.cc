@@ -53,19 +53,42 @@ AvailableList::pop_random() {
   size_type idx = random() % size();
 
   value_type tmp = *(begin() + idx);
-  *(begin() + idx) = back();
-
-  pop_back();
+  erase(begin() + idx);
 
   return tmp;
 }
 
+void
+AvailableList::clear() {
+  base_type::clear();
+
+  m_index.clear();
+  m_indexUsed = 0;
+}
+
+void
+AvailableList::pop_back() {
+  index_erase(index_key(back()));
+  base_type::pop_back();
+}
+
+bool
+AvailableList::has(const rak::socket_address& sa) const {
+  uint64_t key = index_key(sa);
+
+  if (key == 0)
+    return std::find(begin(), end(), sa) != end();
+
+  return !m_index.empty() && m_index[index_slot(key)] == key;
+}
+
 void
 AvailableList::push_back(const rak::socket_address* sa) {
-  if (std::find(begin(), end(), *sa) != end())
+  if (has(*sa))
     return;
 
   base_type::push_back(*sa);
+  index_insert(index_key(*sa));
 }
 
 void
@@ -73,29 +96,107 @@ AvailableList::insert(AddressList* l) {
   if (!want_more())
     return;
 
-  std::sort(begin(), end());
+  for (AddressList::const_iterator itr = l->begin(), last = l->end(); itr != last; ++itr)
+    push_back(&*itr);
+}
 
-  // Can i use use the std::remove* semantics for this, and just copy
-  // to 'l'?.
-  //
-  // 'l' is guaranteed to be sorted, so we can just do
-  // std::set_difference.
-  AddressList difference;
-  std::set_difference(l->begin(), l->end(), begin(), end(), std::back_inserter(difference));
+void
+AvailableList::erase(const rak::socket_address& sa) {
+  if (!has(sa))
+    return;
 
-  std::copy(difference.begin(), difference.end(), std::back_inserter(*static_cast<base_type*>(this)));
+  erase(std::find(begin(), end(), sa));
 }
 
 void
-AvailableList::erase(const rak::socket_address& sa) {
-  iterator itr = std::find(begin(), end(), sa);
+AvailableList::erase(iterator itr) {
+  index_erase(index_key(*itr));
+
+  *itr = back();
+  base_type::pop_back();
+}
+
+uint64_t
+AvailableList::index_key(const rak::socket_address& sa) {
+  if (sa.family() != rak::socket_address::af_inet)
+    return 0;
+
+  return (((uint64_t)sa.sa_inet()->address_h() << 16) | sa.port()) + 1;
+}
+
+static inline AvailableList::size_type
+index_hash(uint64_t key) {
+  return (key * 0x9e3779b97f4a7c15ull) >> 32;
+}
 
-  if (itr != end()) {
-    value_type tmp = *itr;
-    *itr = back();
+// Returns the slot holding 'key', or the empty slot it would be
+// inserted into. The table is never more than half full.
+AvailableList::index_type::size_type
+AvailableList::index_slot(uint64_t key) const {
+  index_type::size_type mask = m_index.size() - 1;
+  index_type::size_type slot = index_hash(key) & mask;
 
-    pop_back();
+  while (m_index[slot] != 0 && m_index[slot] != key)
+    slot = (slot + 1) & mask;
+
+  return slot;
+}
+
+void
+AvailableList::index_insert(uint64_t key) {
+  if (key == 0)
+    return;
+
+  if (2 * (m_indexUsed + 1) > m_index.size())
+    index_resize(std::max<index_type::size_type>(2 * m_index.size(), 64));
+
+  index_type::size_type slot = index_slot(key);
+
+  if (m_index[slot] == 0) {
+    m_index[slot] = key;
+    m_indexUsed++;
+  }
+}
+
+// Shift back the entries following the erased one that would no
+// longer be reachable from their home slot, so no tombstones are
+// needed.
+void
+AvailableList::index_erase(uint64_t key) {
+  if (key == 0 || m_index.empty())
+    return;
+
+  index_type::size_type mask = m_index.size() - 1;
+  index_type::size_type hole = index_slot(key);
+
+  if (m_index[hole] == 0)
+    return;
+
+  m_index[hole] = 0;
+  m_indexUsed--;
+
+  for (index_type::size_type slot = (hole + 1) & mask; m_index[slot] != 0; slot = (slot + 1) & mask) {
+    index_type::size_type home = index_hash(m_index[slot]) & mask;
+
+    // Distance from home to the current slot must be at least the
+    // distance from home to the hole for the entry to move.
+    if (((slot - home) & mask) < ((slot - hole) & mask))
+      continue;
+
+    m_index[hole] = m_index[slot];
+    m_index[slot] = 0;
+    hole = slot;
   }
 }
 
+void
+AvailableList::index_resize(index_type::size_type s) {
+  index_type old(s, 0);
+  old.swap(m_index);
+
+  for (index_type::const_iterator itr = old.begin(), last = old.end(); itr != last; ++itr)
+    if (*itr != 0)
+      m_index[index_slot(*itr)] = *itr;
+}
+
 }
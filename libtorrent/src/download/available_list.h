@@ -62,40 +62,60 @@ public:
   using base_type::capacity;
   using base_type::reserve;
   using base_type::empty;
-  using base_type::clear;
 
   using base_type::back;
-  using base_type::pop_back;
   using base_type::begin;
   using base_type::end;
   using base_type::rbegin;
   using base_type::rend;
 
-  AvailableList() : m_maxSize(1000) {}
+  AvailableList() : m_maxSize(1000), m_indexUsed(0) {}
 
   value_type          pop_random();
 
+  void                clear();
+  void                pop_back();
+
+  bool                has(const rak::socket_address& sa) const;
+
   // Fuzzy size limit.
   size_type           max_size() const                   { return m_maxSize; }
   void                set_max_size(size_type s)          { m_maxSize = s; }
 
   bool                want_more() const                  { return size() <= m_maxSize; }
 
-  // This push is somewhat inefficient as it iterates through the
-  // whole container to see if the address already exists.
+  // Duplicates are ignored.
   void                push_back(const rak::socket_address* sa);
 
   void                insert(AddressList* l);
   void                erase(const rak::socket_address& sa);
-  void                erase(iterator itr)                 { *itr = back(); pop_back(); }
+  void                erase(iterator itr);
   
   // A place to temporarily put addresses before re-adding them to the
   // AvailableList.
   AddressList*        buffer()                            { return &m_buffer; }
 
 private:
+  // IPv4 addresses are indexed by address and port in an open
+  // addressing hash table using linear probing, so lookups don't
+  // need to scan the list. Zero marks an empty slot and is also the
+  // key of addresses that aren't indexed, which fall back to a
+  // linear search.
+  typedef std::vector<uint64_t> index_type;
+
+  static uint64_t     index_key(const rak::socket_address& sa);
+
+  index_type::size_type index_slot(uint64_t key) const;
+
+  void                index_insert(uint64_t key);
+  void                index_erase(uint64_t key);
+  void                index_resize(index_type::size_type s);
+
   size_type           m_maxSize;
 
+  index_type          m_index;
+  size_type           m_indexUsed;
+
   AddressList         m_buffer;
 };
 
@@ -43,6 +43,8 @@
 #include "protocol/peer_chunks.h"
 #include "torrent/exceptions.h"
 
+#include "globals.h"
+
 #include "chunk_selector.h"
 #include "chunk_statistics.h"
 
@@ -59,6 +61,18 @@ ChunkSelector::initialize(Bitfield* bf, ChunkStatistics* cs) {
   std::transform(bf->begin(), bf->end(), m_bitfield.begin(), rak::invert<Bitfield::value_type>());
   m_bitfield.update();
 
+  // Until the priorities are updated nothing is wanted.
+  m_highBitfield.set_size_bits(bf->size_bits());
+  m_highBitfield.allocate();
+  m_highBitfield.unset_all();
+
+  m_normalBitfield.set_size_bits(bf->size_bits());
+  m_normalBitfield.allocate();
+  m_normalBitfield.unset_all();
+
+  m_highWanted = 0;
+  m_statistics->set_active(&m_normalBitfield);
+
   m_sharedQueue.enable(32);
   m_sharedQueue.clear();
 }
@@ -66,9 +80,22 @@ ChunkSelector::initialize(Bitfield* bf, ChunkStatistics* cs) {
 void
 ChunkSelector::cleanup() {
   m_bitfield.clear();
+  m_highBitfield.clear();
+  m_normalBitfield.clear();
   m_statistics = NULL;
 }
 
+static void
+ranges_to_bitfield(const ChunkSelector::priority_ranges* ranges, Bitfield* bitfield, uint32_t size) {
+  bitfield->clear();
+  bitfield->set_size_bits(size);
+  bitfield->allocate();
+  bitfield->unset_all();
+
+  for (ChunkSelector::priority_ranges::const_iterator itr = ranges->begin(), last = ranges->end(); itr != last && itr->first < size; ++itr)
+    bitfield->set_range(itr->first, std::min(itr->second, size));
+}
+
 // Consider if ChunksSelector::not_using_index(...) needs to be
 // modified.
 void
@@ -78,6 +105,26 @@ ChunkSelector::update_priorities() {
 
   m_sharedQueue.clear();
 
+  ranges_to_bitfield(&m_highPriority, &m_highBitfield, size());
+  ranges_to_bitfield(&m_normalPriority, &m_normalBitfield, size());
+
+  // Only the wanted chunks are kept in the rarity buckets.
+  Bitfield wanted;
+  wanted.set_size_bits(size());
+  wanted.allocate();
+
+  for (Bitfield::size_type i = 0; i < wanted.size_bytes(); ++i)
+    wanted.begin()[i] = m_bitfield.begin()[i] & (m_highBitfield.begin()[i] | m_normalBitfield.begin()[i]);
+
+  wanted.update();
+  m_statistics->set_active(&wanted);
+
+  for (Bitfield::size_type i = 0; i < wanted.size_bytes(); ++i)
+    wanted.begin()[i] = m_bitfield.begin()[i] & m_highBitfield.begin()[i];
+
+  wanted.update();
+  m_highWanted = wanted.size_set();
+
   if (m_position == invalid_chunk)
     m_position = random() % size();
 
@@ -125,8 +172,9 @@ ChunkSelector::find(PeerChunks* pc, __UNUSED bool highPriority) {
 
   queue->clear();
 
-  (search_linear(pc->bitfield(), queue, &m_highPriority, m_position, size()) &&
-   search_linear(pc->bitfield(), queue, &m_highPriority, 0, m_position));
+  // Skip the walk for high priority chunks if none are left.
+  if (m_highWanted != 0)
+    search_rarest(pc->bitfield(), queue, &m_highBitfield);
 
   if (queue->prepare_pop()) {
     // Set that the peer has high priority pieces cached.
@@ -137,8 +185,7 @@ ChunkSelector::find(PeerChunks* pc, __UNUSED bool highPriority) {
     // Urgh...
     queue->clear();
 
-    (search_linear(pc->bitfield(), queue, &m_normalPriority, m_position, size()) &&
-     search_linear(pc->bitfield(), queue, &m_normalPriority, 0, m_position));
+    search_rarest(pc->bitfield(), queue, &m_normalBitfield);
 
     if (!queue->prepare_pop())
       return invalid_chunk;
@@ -152,9 +199,78 @@ ChunkSelector::find(PeerChunks* pc, __UNUSED bool highPriority) {
   return pos;
 }
 
-bool
-ChunkSelector::is_wanted(uint32_t index) const {
-  return m_bitfield.get(index) && (m_normalPriority.has(index) || m_highPriority.has(index));
+uint64_t
+ChunkSelector::stream_position() const {
+  if (!is_streaming())
+    return m_streamPosition;
+
+  return m_streamPosition + (uint64_t)(cachedTime.usec() - m_streamTime) * m_streamRate / 1000000;
+}
+
+void
+ChunkSelector::set_stream(uint64_t position, uint32_t rate, uint32_t chunkSize) {
+  if (rate != 0 && chunkSize == 0)
+    throw internal_error("ChunkSelector::set_stream(...) chunkSize == 0.");
+
+  m_streamPosition = position;
+  m_streamRate = rate;
+  m_streamChunkSize = chunkSize;
+  m_streamTime = cachedTime.usec();
+}
+
+int64_t
+ChunkSelector::chunk_deadline(uint32_t index) const {
+  if (!is_streaming() || index >= size())
+    return no_deadline;
+
+  int64_t offset = (int64_t)index * m_streamChunkSize - (int64_t)m_streamPosition;
+  int64_t deadline = m_streamTime + offset * 1000000 / m_streamRate;
+
+  // Chunks behind the playback position are no longer needed in time.
+  if (deadline + (int64_t)m_streamChunkSize * 1000000 / m_streamRate <= cachedTime.usec() ||
+      deadline > cachedTime.usec() + stream_horizon)
+    return no_deadline;
+
+  return deadline;
+}
+
+uint32_t
+ChunkSelector::find_deadline(PeerChunks* pc) {
+  if (!is_streaming() || m_position == invalid_chunk)
+    return invalid_chunk;
+
+  uint64_t position = stream_position();
+
+  if (position / m_streamChunkSize >= size())
+    return invalid_chunk;
+
+  uint32_t first = position / m_streamChunkSize;
+  uint32_t last  = std::min<uint64_t>((position + (uint64_t)m_streamRate * stream_horizon / 1000000) / m_streamChunkSize + 1, size());
+
+  uint32_t rate = pc->download_throttle()->rate()->rate();
+
+  while ((first = m_bitfield.find_first_set(first, last)) != last) {
+    uint32_t index = first++;
+
+    if (!pc->bitfield()->get(index) || !is_prioritized(index))
+      continue;
+
+    int64_t deadline = chunk_deadline(index);
+
+    if (deadline == no_deadline)
+      continue;
+
+    // Peers we haven't measured yet are given the benefit of the
+    // doubt, the late blocks will be duplicated on faster peers.
+    int64_t remaining = std::max(deadline - cachedTime.usec(), (int64_t)stream_slack);
+
+    if (rate != 0 && (uint64_t)rate * remaining < (uint64_t)m_streamChunkSize * 1000000)
+      continue;
+
+    return index;
+  }
+
+  return invalid_chunk;
 }
 
 void
@@ -167,6 +283,9 @@ ChunkSelector::using_index(uint32_t index) {
 
   m_bitfield.unset(index);
 
+  m_statistics->deactivate(index);
+  m_highWanted -= m_highBitfield.get(index);
+
   // We always know 'm_position' points to a wanted chunk. If it
   // changes, we need to move m_position to the next one.
   if (index == m_position)
@@ -183,6 +302,11 @@ ChunkSelector::not_using_index(uint32_t index) {
 
   m_bitfield.set(index);
 
+  if (is_prioritized(index))
+    m_statistics->activate(index);
+
+  m_highWanted += m_highBitfield.get(index);
+
   // This will make sure that if we enable new chunks, it will start
   // downloading them event when 'index == invalid_chunk'.
   if (m_position == invalid_chunk)
@@ -202,7 +326,7 @@ ChunkSelector::received_have_chunk(PeerChunks* pc, uint32_t index) {
     return false;
 
   // Also check if the peer only has high-priority chunks.
-  if (!m_highPriority.has(index) && !m_normalPriority.has(index))
+  if (!is_prioritized(index))
     return false;
 
   if (pc->download_cache()->is_enabled())
@@ -212,75 +336,61 @@ ChunkSelector::received_have_chunk(PeerChunks* pc, uint32_t index) {
 }
 
 bool
-ChunkSelector::search_linear(const Bitfield* bf, rak::partial_queue* pq, priority_ranges* ranges, uint32_t first, uint32_t last) {
-  priority_ranges::iterator itr = ranges->find(first);
-
-  while (itr != ranges->end() && itr->first < last) {
-
-    if (!search_linear_range(bf, pq, std::max(first, itr->first), std::min(last, itr->second)))
-      return false;
-
-    ++itr;    
-  }
+ChunkSelector::search_rarest(const Bitfield* bf, rak::partial_queue* pq, const Bitfield* priority) {
+  if (priority->is_all_unset())
+    return true;
 
-  return true;
-}
+  for (uint32_t rarity = 0; rarity <= ChunkStatistics::max_accounted; ++rarity) {
+    uint32_t first = m_statistics->rarity_first(rarity);
+    uint32_t count = m_statistics->rarity_last(rarity) - first;
 
-// Could propably add another argument for max seen or something, this
-// would be used to find better chunks to request.
-inline bool
-ChunkSelector::search_linear_range(const Bitfield* bf, rak::partial_queue* pq, uint32_t first, uint32_t last) {
-  if (first >= last || last > size())
-    throw internal_error("ChunkSelector::search_linear_range(...) received an invalid range.");
+    if (count == 0)
+      continue;
 
-  Bitfield::const_iterator local  = m_bitfield.begin() + first / 8;
-  Bitfield::const_iterator source = bf->begin() + first / 8;
+    // Start each bucket at 'm_position' so that peers don't all end
+    // up requesting the same chunks among equally rare ones.
+    uint32_t offset = m_position % count;
 
-  // Unset any bits before 'first'.
-  Bitfield::value_type wanted = (*source & *local) & Bitfield::mask_from(first % 8);
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t index = m_statistics->rarity_order(first + (offset + i) % count);
 
-  while (m_bitfield.position(local + 1) < last) {
-    if (wanted && !search_linear_byte(pq, m_bitfield.position(local), wanted))
-      return false;
+      if (!bf->get(index) || !priority->get(index))
+        continue;
 
-    wanted = (*++source & *++local);
+      // Insert only fails once the queue no longer accepts this
+      // rarity, and every chunk left is at least as common.
+      if (!pq->insert(rarity, index))
+        return false;
+    }
   }
-  
-  // Unset any bits from 'last'.
-  wanted &= Bitfield::mask_before(last - m_bitfield.position(local));
 
-  if (wanted)
-    return search_linear_byte(pq, m_bitfield.position(local), wanted);
-  else
-    return true;
+  return true;
 }
 
-// Take pointer to partial_queue
-inline bool
-ChunkSelector::search_linear_byte(rak::partial_queue* pq, uint32_t index, Bitfield::value_type wanted) {
-  for (int i = 0; i < 8; ++i) {
-    if (!(wanted & Bitfield::mask_at(i)))
-      continue;
+uint32_t
+ChunkSelector::search_wanted(const priority_ranges* ranges, uint32_t first, uint32_t last) const {
+  for (priority_ranges::const_iterator itr = ranges->find(first); itr != ranges->end() && itr->first < last; ++itr) {
+    uint32_t rangeLast = std::min(itr->second, last);
+    uint32_t index = m_bitfield.find_first_set(std::max(itr->first, first), rangeLast);
 
-    if (!pq->insert(m_statistics->rarity(index + i), index + i) && pq->is_full())
-      return false;
+    if (index != rangeLast)
+      return index;
   }
 
-  return true;
+  return invalid_chunk;
 }
 
+// Moves 'm_position' to the next wanted chunk, or sets it to
+// invalid_chunk so that find() can bail out early when there's
+// nothing left to request.
 void
 ChunkSelector::advance_position() {
+  uint32_t position = m_position;
 
-  // Need to replace with a special-purpose function for finding the
-  // next position.
-
-//   int position = m_position;
-
-//   ((m_position = search_linear(&m_bitfield, &m_highPriority, position, size())) == invalid_chunk &&
-//    (m_position = search_linear(&m_bitfield, &m_highPriority, 0, position)) == invalid_chunk &&
-//    (m_position = search_linear(&m_bitfield, &m_normalPriority, position, size())) == invalid_chunk &&
-//    (m_position = search_linear(&m_bitfield, &m_normalPriority, 0, position)) == invalid_chunk);
+  ((m_position = search_wanted(&m_highPriority, position, size())) == invalid_chunk &&
+   (m_position = search_wanted(&m_highPriority, 0, position)) == invalid_chunk &&
+   (m_position = search_wanted(&m_normalPriority, position, size())) == invalid_chunk &&
+   (m_position = search_wanted(&m_normalPriority, 0, position)) == invalid_chunk);
 }
 
 }
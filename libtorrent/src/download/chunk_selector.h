@@ -62,6 +62,16 @@ public:
 
   static const uint32_t invalid_chunk = ~(uint32_t)0;
 
+  // When streaming, chunks with a deadline less than 'stream_horizon'
+  // microseconds away are time-critical. Peers starting such a chunk
+  // are given at least 'stream_slack' to finish it.
+  static const int64_t  stream_horizon = 10 * 1000000;
+  static const int64_t  stream_slack   = 2 * 1000000;
+
+  static const int64_t  no_deadline = (int64_t)(~(uint64_t)0 >> 1);
+
+  ChunkSelector() : m_highWanted(0), m_streamPosition(0), m_streamRate(0), m_streamChunkSize(0), m_streamTime(0) {}
+
   bool                empty() const                 { return size() == 0; }
   uint32_t            size() const                  { return m_bitfield.size_bits(); }
 
@@ -82,7 +92,25 @@ public:
 
   uint32_t            find(PeerChunks* pc, bool highPriority);
 
-  bool                is_wanted(uint32_t index) const;
+  bool                is_wanted(uint32_t index) const   { return m_bitfield.get(index) && is_prioritized(index); }
+
+  // The playback position advances from 'position' at 'rate' bytes
+  // per second, chunk 'i' is due when playback reaches its first
+  // byte. A zero rate disables streaming.
+  bool                is_streaming() const          { return m_streamRate != 0; }
+
+  uint64_t            stream_position() const;
+  uint32_t            stream_rate() const           { return m_streamRate; }
+
+  void                set_stream(uint64_t position, uint32_t rate, uint32_t chunkSize);
+
+  // Absolute deadline in microseconds of a time-critical chunk, or
+  // no_deadline.
+  int64_t             chunk_deadline(uint32_t index) const;
+
+  // Find the wanted time-critical chunk with the earliest deadline
+  // that the peer has and isn't known to be too slow to deliver.
+  uint32_t            find_deadline(PeerChunks* pc);
 
   // Call this to set the index as being downloaded, finished etc,
   // thus ignored. Propably should find a better name for this.
@@ -100,13 +128,15 @@ public:
   bool                received_have_chunk(PeerChunks* pc, uint32_t index);
 
 private:
-  bool                search_linear(const Bitfield* bf, rak::partial_queue* pq, priority_ranges* ranges, uint32_t first, uint32_t last);
-  inline bool         search_linear_range(const Bitfield* bf, rak::partial_queue* pq, uint32_t first, uint32_t last);
-  inline bool         search_linear_byte(rak::partial_queue* pq, uint32_t index, Bitfield::value_type wanted);
+  bool                is_prioritized(uint32_t index) const { return m_highBitfield.get(index) || m_normalBitfield.get(index); }
+
+  // Walks the wanted chunks from the rarest, adding those the peer
+  // has and are set in 'priority' to 'pq' until it is full.
+  bool                search_rarest(const Bitfield* bf, rak::partial_queue* pq, const Bitfield* priority);
 
-//   inline uint32_t     search_rarest(const Bitfield* bf, priority_ranges* ranges, uint32_t first, uint32_t last);
-//   inline uint32_t     search_rarest_range(const Bitfield* bf, uint32_t first, uint32_t last);
-//   inline uint32_t     search_rarest_byte(uint8_t wanted);
+  // Returns the first wanted chunk in 'ranges' within [first, last),
+  // or invalid_chunk.
+  uint32_t            search_wanted(const priority_ranges* ranges, uint32_t first, uint32_t last) const;
 
   void                advance_position();
 
@@ -116,9 +146,19 @@ private:
   priority_ranges     m_highPriority;
   priority_ranges     m_normalPriority;
 
+  // The priority ranges as bitfields, for constant time lookups.
+  Bitfield            m_highBitfield;
+  Bitfield            m_normalBitfield;
+  uint32_t            m_highWanted;
+
   rak::partial_queue  m_sharedQueue;
 
   uint32_t            m_position;
+
+  uint64_t            m_streamPosition;
+  uint32_t            m_streamRate;
+  uint32_t            m_streamChunkSize;
+  int64_t             m_streamTime;
 };
 
 }
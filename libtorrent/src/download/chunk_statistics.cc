@@ -36,6 +36,8 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "torrent/exceptions.h"
 
 #include "protocol/peer_chunks.h"
@@ -49,12 +51,120 @@ ChunkStatistics::should_add(PeerChunks* pc) {
   return m_accounted < max_accounted;
 }
 
+inline void
+ChunkStatistics::swap_position(size_type index, size_type pos) {
+  uint32_t other = m_order[pos];
+
+  m_order[m_position[index]] = other;
+  m_position[other] = m_position[index];
+
+  m_order[pos] = index;
+  m_position[index] = pos;
+}
+
+// Swap the chunk with the last chunk in its bucket, then shrink the
+// bucket so the chunk becomes the first of the next one.
+inline void
+ChunkStatistics::increment(size_type index) {
+  if (!is_active(index)) {
+    base_type::operator[](index)++;
+    return;
+  }
+
+  size_type rarity = base_type::operator[](index)++;
+
+  swap_position(index, --m_bucketFirst[rarity + 1]);
+}
+
+inline void
+ChunkStatistics::decrement(size_type index) {
+  if (!is_active(index)) {
+    base_type::operator[](index)--;
+    return;
+  }
+
+  size_type rarity = base_type::operator[](index)--;
+
+  swap_position(index, m_bucketFirst[rarity]++);
+}
+
+// Every count is non-zero, so each bucket simply takes the place of
+// the one below it. The end of the last bucket stays put as the
+// inactive chunks don't move.
+inline void
+ChunkStatistics::decrement_all() {
+  for (iterator itr = base_type::begin(), last = base_type::end(); itr != last; ++itr)
+    *itr -= 1;
+
+  std::copy(m_bucketFirst.begin() + 1, m_bucketFirst.end(), m_bucketFirst.begin());
+}
+
 void
 ChunkStatistics::initialize(size_type s) {
   if (!empty())
     throw internal_error("ChunkStatistics::initialize(...) called on an initialized object.");
 
   base_type::resize(s);
+
+  m_order.resize(s);
+  m_position.resize(s);
+
+  for (size_type i = 0; i < s; ++i)
+    m_order[i] = m_position[i] = i;
+
+  // All chunks start out in the zero bucket, the extra entry marks
+  // the end of the last bucket.
+  m_bucketFirst.assign(max_accounted + 2, s);
+  m_bucketFirst[0] = 0;
+}
+
+// Walk the chunk up through the buckets above it, leaving it as the
+// first inactive chunk.
+void
+ChunkStatistics::deactivate(size_type index) {
+  if (!is_active(index))
+    return;
+
+  for (size_type rarity = base_type::operator[](index); rarity <= max_accounted; ++rarity)
+    swap_position(index, --m_bucketFirst[rarity + 1]);
+}
+
+void
+ChunkStatistics::activate(size_type index) {
+  if (is_active(index))
+    return;
+
+  swap_position(index, m_bucketFirst[max_accounted + 1]++);
+
+  for (size_type rarity = max_accounted; rarity > base_type::operator[](index); --rarity)
+    swap_position(index, m_bucketFirst[rarity]++);
+}
+
+// Counting sort of the active chunks by rarity, followed by the
+// inactive ones.
+void
+ChunkStatistics::set_active(const Bitfield* bf) {
+  if (bf->size_bits() != size())
+    throw internal_error("ChunkStatistics::set_active(...) bitfield size mismatch.");
+
+  std::fill(m_bucketFirst.begin(), m_bucketFirst.end(), 0);
+
+  for (size_type index = 0; index < size(); ++index)
+    if (bf->get(index))
+      m_bucketFirst[base_type::operator[](index) + 1]++;
+
+  for (size_type rarity = 0; rarity <= max_accounted; ++rarity)
+    m_bucketFirst[rarity + 1] += m_bucketFirst[rarity];
+
+  index_list next(m_bucketFirst.begin(), m_bucketFirst.end() - 1);
+  size_type inactive = m_bucketFirst[max_accounted + 1];
+
+  for (size_type index = 0; index < size(); ++index) {
+    size_type pos = bf->get(index) ? next[base_type::operator[](index)]++ : inactive++;
+
+    m_order[pos] = index;
+    m_position[index] = pos;
+  }
 }
 
 void
@@ -63,6 +173,10 @@ ChunkStatistics::clear() {
     throw internal_error("ChunkStatistics::clear() m_complete != 0.");
 
   base_type::clear();
+
+  m_order.clear();
+  m_position.clear();
+  m_bucketFirst.clear();
 }
 
 void
@@ -80,11 +194,10 @@ ChunkStatistics::received_connect(PeerChunks* pc) {
     pc->set_using_counter(true);
     m_accounted++;
     
-    iterator itr = base_type::begin();
-
     // Use a bitfield iterator instead.
-    for (Bitfield::size_type index = 0; index < pc->bitfield()->size_bits(); ++index, ++itr)
-      *itr += pc->bitfield()->get(index);
+    for (Bitfield::size_type index = 0; index < pc->bitfield()->size_bits(); ++index)
+      if (pc->bitfield()->get(index))
+        increment(index);
   }
 }
 
@@ -108,11 +221,10 @@ ChunkStatistics::received_disconnect(PeerChunks* pc) {
 
     m_accounted--;
 
-    iterator itr = base_type::begin();
-
     // Use a bitfield iterator instead.
-    for (Bitfield::size_type index = 0; index < pc->bitfield()->size_bits(); ++index, ++itr)
-      *itr -= pc->bitfield()->get(index);
+    for (Bitfield::size_type index = 0; index < pc->bitfield()->size_bits(); ++index)
+      if (pc->bitfield()->get(index))
+        decrement(index);
   }
 }
 
@@ -135,7 +247,7 @@ ChunkStatistics::received_have_chunk(PeerChunks* pc, uint32_t index, uint32_t le
   
   if (pc->using_counter()) {
 
-    base_type::operator[](index)++;
+    increment(index);
 
     // The below code should not cause useless work to be done in case
     // of immediate disconnect.
@@ -146,8 +258,7 @@ ChunkStatistics::received_have_chunk(PeerChunks* pc, uint32_t index, uint32_t le
       m_complete++;
       m_accounted--;
       
-      for (iterator itr = base_type::begin(), last = base_type::end(); itr != last; ++itr)
-	*itr -= 1;
+      decrement_all();
     }
 
   } else {
@@ -42,8 +42,18 @@
 
 namespace torrent {
 
+class Bitfield;
 class PeerChunks;
 
+// Besides the per-chunk counts, the chunks are kept ordered by rarity
+// in buckets of equal count. Moving a chunk to the neighbouring
+// bucket is a swap with the bucket's edge, so the order is maintained
+// in O(1) per changed count and can be walked from the rarest chunk.
+//
+// Only active chunks, those the selector still wants, are kept in
+// the buckets. Inactive chunks are placed after the last bucket so
+// that walking the order skips them.
+
 class ChunkStatistics : public std::vector<uint8_t> {
 public:
   typedef std::vector<uint8_t>            base_type;
@@ -56,6 +66,8 @@ public:
   typedef base_type::const_iterator       const_iterator;
   typedef base_type::reverse_iterator     reverse_iterator;
 
+  typedef std::vector<uint32_t>           index_list;
+
   using base_type::empty;
   using base_type::size;
 
@@ -100,14 +112,39 @@ public:
 
   const_reference     operator [] (size_type n) const { return base_type::operator[](n); }
 
+  // Chunk index at position 'pos' in the rarity order, and the range
+  // of positions holding chunks with the given rarity.
+  uint32_t            rarity_order(size_type pos) const   { return m_order[pos]; }
+  size_type           rarity_first(size_type r) const     { return m_bucketFirst[r]; }
+  size_type           rarity_last(size_type r) const      { return m_bucketFirst[r + 1]; }
+
+  bool                is_active(size_type index) const    { return m_position[index] < m_bucketFirst[max_accounted + 1]; }
+
+  // Moving a single chunk in or out of the buckets is O(max_accounted)
+  // swaps, while 'set_active' rebuilds the order from the bitfield in
+  // linear time.
+  void                activate(size_type index);
+  void                deactivate(size_type index);
+  void                set_active(const Bitfield* bf);
+
 private:
   inline bool         should_add(PeerChunks* pc);
 
+  inline void         increment(size_type index);
+  inline void         decrement(size_type index);
+  inline void         decrement_all();
+
+  inline void         swap_position(size_type index, size_type pos);
+
   ChunkStatistics(const ChunkStatistics&);
   void operator = (const ChunkStatistics&);
 
   size_type           m_complete;
   size_type           m_accounted;
+
+  index_list          m_order;
+  index_list          m_position;
+  index_list          m_bucketFirst;
 };
 
 }
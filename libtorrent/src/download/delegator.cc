@@ -46,9 +46,13 @@
 #include "torrent/data/block.h"
 #include "torrent/data/block_list.h"
 #include "torrent/data/block_transfer.h"
+#include "torrent/peer/peer_info.h"
 #include "protocol/peer_chunks.h"
+#include "protocol/peer_connection_base.h"
 
+#include "chunk_selector.h"
 #include "delegator.h"
+#include "globals.h"
 
 namespace torrent {
 
@@ -96,28 +100,49 @@ struct DelegatorCheckPriority {
   const PeerChunks*   m_peerChunks;
 };
 
-// TODO: Should this ensure we don't download pieces that are priority off?
-struct DelegatorCheckAggressive {
-  DelegatorCheckAggressive(Delegator* delegator, Block** target, uint16_t* o, const PeerChunks* peerChunks) :
-    m_delegator(delegator), m_target(target), m_overlapp(o), m_peerChunks(peerChunks) {}
+// Predicted completion time of a transfer, or 'transfer_late' if it
+// is stalled or has overrun its expected time by more than its own
+// expected duration. Transfers we can't predict yet are assumed to be
+// on time.
+static const int64_t transfer_late = (int64_t)(~(uint64_t)0 >> 1);
 
-  bool operator () (BlockList* d) {
-    Block* tmp;
+static int64_t
+transfer_expected_finish(BlockTransfer* transfer, int64_t now) {
+  if (transfer->stall() != 0)
+    return transfer_late;
+
+  if (!transfer->is_queued()) {
+    PeerConnectionBase* pcb = transfer->peer_info()->connection();
+    uint32_t rate = pcb != NULL ? pcb->peer_chunks()->download_throttle()->rate()->rate() : 0;
 
-    if (!m_peerChunks->bitfield()->get(d->index()) ||
-        d->priority() == PRIORITY_OFF ||
-        (tmp = m_delegator->delegate_aggressive(d, m_overlapp, m_peerChunks->peer_info())) == NULL)
-      return false;
+    if (rate == 0)
+      return transfer_late;
 
-    *m_target = tmp;
-    return m_overlapp == 0;
+    return now + (int64_t)(transfer->piece().length() - transfer->position()) * 1000000 / rate;
   }
 
-  Delegator*          m_delegator;
-  Block**             m_target;
-  uint16_t*           m_overlapp;
-  const PeerChunks*   m_peerChunks;
-};
+  if (transfer->expected_time() == 0)
+    return now;
+
+  if (now > transfer->expected_time() + std::max<int64_t>(transfer->expected_time() - transfer->request_time(), 1000000))
+    return transfer_late;
+
+  return std::max(transfer->expected_time(), now);
+}
+
+static int64_t
+block_expected_finish(Block* block, int64_t now) {
+  int64_t finish = transfer_late;
+
+  for (Block::transfer_list_type::const_iterator itr = block->queued()->begin(), last = block->queued()->end(); itr != last; ++itr)
+    finish = std::min(finish, transfer_expected_finish(*itr, now));
+
+  for (Block::transfer_list_type::const_iterator itr = block->transfers()->begin(), last = block->transfers()->end(); itr != last; ++itr)
+    if (!(*itr)->is_erased())
+      finish = std::min(finish, transfer_expected_finish(*itr, now));
+
+  return finish;
+}
 
 BlockTransfer*
 Delegator::delegate(PeerChunks* peerChunks, int affinity) {
@@ -125,6 +150,9 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
   // it timeout cancels them.
   Block* target = NULL;
 
+  if (m_streaming && (target = delegate_deadline(peerChunks)) != NULL)
+    return target->insert(peerChunks->peer_info());
+
   // Find piece with same index as affinity. This affinity should ensure that we
   // never start another piece while the chunk this peer used to download is still
   // in progress.
@@ -155,18 +183,11 @@ Delegator::delegate(PeerChunks* peerChunks, int affinity) {
   if ((target = new_chunk(peerChunks, false)))
     return target->insert(peerChunks->peer_info());
 
-  if (!m_aggressive)
+  if (!m_aggressive || (target = delegate_endgame(peerChunks)) == NULL)
     return NULL;
 
-  // Aggressive mode, look for possible downloads that already have
-  // one or more queued.
-
-  // No more than 4 per piece.
-  uint16_t overlapped = 5;
-
-  std::find_if(m_transfers.begin(), m_transfers.end(), DelegatorCheckAggressive(this, &target, &overlapped, peerChunks));
-
-  return target ? target->insert(peerChunks->peer_info()) : NULL;
+  m_transfers.inc_duplicated();
+  return target->insert(peerChunks->peer_info());
 }
   
 Block*
@@ -186,6 +207,133 @@ Delegator::delegate_seeder(PeerChunks* peerChunks) {
   return NULL;
 }
 
+// Earliest deadline first: blocks nobody is downloading in
+// time-critical chunks, then a new time-critical chunk, and lastly a
+// duplicate request for blocks of chunks about to miss their
+// deadline.
+Block*
+Delegator::delegate_deadline(PeerChunks* peerChunks) {
+  Block* target = NULL;
+  int64_t targetDeadline = ChunkSelector::no_deadline;
+
+  for (TransferList::iterator itr = m_transfers.begin(), last = m_transfers.end(); itr != last; ++itr) {
+    if ((*itr)->priority() == PRIORITY_OFF || !peerChunks->bitfield()->get((*itr)->index()))
+      continue;
+
+    int64_t deadline = m_slotChunkDeadline((*itr)->index());
+    Block* block;
+
+    if (deadline < targetDeadline && (block = delegate_piece(*itr, peerChunks->peer_info())) != NULL) {
+      target = block;
+      targetDeadline = deadline;
+    }
+  }
+
+  if (target != NULL)
+    return target;
+
+  uint32_t index = m_slotChunkFindDeadline(peerChunks);
+
+  if (index != ~(uint32_t)0)
+    return insert_chunk(peerChunks, index, PRIORITY_HIGH);
+
+  // Only duplicate on peers we know are delivering.
+  if (peerChunks->download_throttle()->rate()->rate() == 0)
+    return NULL;
+
+  int64_t urgent = cachedTime.usec() + ChunkSelector::stream_slack;
+
+  for (TransferList::iterator itr = m_transfers.begin(), last = m_transfers.end(); itr != last; ++itr) {
+    if ((*itr)->priority() == PRIORITY_OFF || !peerChunks->bitfield()->get((*itr)->index()))
+      continue;
+
+    int64_t deadline = m_slotChunkDeadline((*itr)->index());
+
+    if (deadline >= urgent || deadline >= targetDeadline)
+      continue;
+
+    // At most two peers on each late block.
+    uint16_t overlapped = 2;
+    Block* block = delegate_aggressive(*itr, &overlapped, peerChunks->peer_info());
+
+    if (block != NULL) {
+      target = block;
+      targetDeadline = deadline;
+    }
+  }
+
+  if (target != NULL && target->size_all() != 0)
+    m_transfers.inc_duplicated();
+
+  return target;
+}
+
+// Pick the block furthest behind among those where this peer is
+// predicted to finish in less than half the time the peers already
+// on it need. Peers we have no rate for only get blocks where
+// everyone else is late.
+Block*
+Delegator::delegate_endgame(PeerChunks* peerChunks) {
+  int64_t now = cachedTime.usec();
+  uint32_t rate = peerChunks->download_throttle()->rate()->rate();
+
+  Block* target = NULL;
+  int64_t targetFinish = now;
+
+  for (TransferList::iterator itr = m_transfers.begin(), last = m_transfers.end(); itr != last; ++itr) {
+    if ((*itr)->priority() == PRIORITY_OFF || !peerChunks->bitfield()->get((*itr)->index()))
+      continue;
+
+    for (BlockList::iterator blockItr = (*itr)->begin(), blockLast = (*itr)->end(); blockItr != blockLast; ++blockItr) {
+      if (blockItr->is_finished() ||
+          blockItr->size_not_stalled() >= endgame_max_peers ||
+          blockItr->find(peerChunks->peer_info()) != NULL)
+        continue;
+
+      int64_t finish = block_expected_finish(&*blockItr, now);
+
+      if (finish <= targetFinish)
+        continue;
+
+      if (finish != transfer_late &&
+          (rate == 0 || 2 * (int64_t)blockItr->piece().length() * 1000000 / rate >= finish - now))
+        continue;
+
+      target = &*blockItr;
+      targetFinish = finish;
+    }
+  }
+
+  return target;
+}
+
+void
+Delegator::cancel_duplicates(PeerChunks* peerChunks, BlockTransfer* leader) {
+  Block* block = leader->block();
+
+  if (block->queued()->empty())
+    return;
+
+  uint32_t rate = peerChunks->download_throttle()->rate()->rate();
+
+  if (rate == 0)
+    return;
+
+  int64_t now = cachedTime.usec();
+  int64_t finish = now + (int64_t)(leader->piece().length() - leader->position()) * 1000000 / rate;
+
+  // Cancelling modifies the queue.
+  Block::transfer_list_type queued(*block->queued());
+
+  for (Block::transfer_list_type::const_iterator itr = queued.begin(), last = queued.end(); itr != last; ++itr) {
+    if (transfer_expected_finish(*itr, now) < finish)
+      continue;
+
+    block->cancel_queued(*itr);
+    m_transfers.inc_cancelled();
+  }
+}
+
 Block*
 Delegator::new_chunk(PeerChunks* pc, bool highPriority) {
   uint32_t index = m_slotChunkFind(pc, highPriority);
@@ -193,14 +341,15 @@ Delegator::new_chunk(PeerChunks* pc, bool highPriority) {
   if (index == ~(uint32_t)0)
     return NULL;
 
+  return insert_chunk(pc, index, highPriority ? PRIORITY_HIGH : PRIORITY_NORMAL);
+}
+
+Block*
+Delegator::insert_chunk(PeerChunks* pc, uint32_t index, priority_t p) {
   TransferList::iterator itr = m_transfers.insert(Piece(index, 0, m_slotChunkSize(index)), block_size);
 
   (*itr)->set_by_seeder(pc->is_seeder());
-
-  if (highPriority)
-    (*itr)->set_priority(PRIORITY_HIGH);
-  else
-    (*itr)->set_priority(PRIORITY_NORMAL);
+  (*itr)->set_priority(p);
 
   return &*(*itr)->begin();
 }
@@ -60,22 +60,42 @@ public:
   typedef rak::mem_fun1<ChunkSelector, void, uint32_t>              SlotChunkIndex;
   typedef rak::mem_fun2<ChunkSelector, uint32_t, PeerChunks*, bool> SlotChunkFind;
   typedef rak::const_mem_fun1<FileList, uint32_t, uint32_t>         SlotChunkSize;
+  typedef rak::mem_fun1<ChunkSelector, uint32_t, PeerChunks*>       SlotChunkFindDeadline;
+  typedef rak::const_mem_fun1<ChunkSelector, int64_t, uint32_t>     SlotChunkDeadline;
 
   static const unsigned int block_size = 1 << 14;
 
-  Delegator() : m_aggressive(false) { }
+  // In endgame a block is only requested from more peers if those
+  // already on it are predicted to be late, and never from more than
+  // 'endgame_max_peers'.
+  static const unsigned int endgame_max_peers = 3;
+
+  Delegator() : m_aggressive(false), m_streaming(false) { }
 
   TransferList*       transfer_list()                     { return &m_transfers; }
   const TransferList* transfer_list() const               { return &m_transfers; }
 
   BlockTransfer*     delegate(PeerChunks* peerChunks, int affinity);
 
+  // Called when 'leader' starts arriving as the first transfer of its
+  // block. Duplicates still queued on other peers that aren't
+  // predicted to finish before it get cancelled.
+  void               cancel_duplicates(PeerChunks* peerChunks, BlockTransfer* leader);
+
   bool               get_aggressive()                     { return m_aggressive; }
   void               set_aggressive(bool a)               { m_aggressive = a; }
 
+  // Time-critical chunks are delegated before anything else while
+  // streaming.
+  bool               get_streaming()                      { return m_streaming; }
+  void               set_streaming(bool s)                { m_streaming = s; }
+
   void               slot_chunk_find(SlotChunkFind s)     { m_slotChunkFind = s; }
   void               slot_chunk_size(SlotChunkSize s)     { m_slotChunkSize = s; }
 
+  void               slot_chunk_find_deadline(SlotChunkFindDeadline s) { m_slotChunkFindDeadline = s; }
+  void               slot_chunk_deadline(SlotChunkDeadline s)          { m_slotChunkDeadline = s; }
+
   // Don't call this from the outside.
   Block*             delegate_piece(BlockList* c, const PeerInfo* peerInfo);
   Block*             delegate_aggressive(BlockList* c, uint16_t* overlapped, const PeerInfo* peerInfo);
@@ -84,17 +104,24 @@ private:
   // Start on a new chunk, returns .end() if none possible. bf is
   // remote peer's bitfield.
   Block*             new_chunk(PeerChunks* pc, bool highPriority);
+  Block*             insert_chunk(PeerChunks* pc, uint32_t index, priority_t p);
 
   Block*             delegate_seeder(PeerChunks* peerChunks);
+  Block*             delegate_deadline(PeerChunks* peerChunks);
+  Block*             delegate_endgame(PeerChunks* peerChunks);
 
   TransferList       m_transfers;
 
   bool               m_aggressive;
+  bool               m_streaming;
 
   // Propably should add a m_slotChunkStart thing, which will take
   // care of enabling etc, and will be possible to listen to.
   SlotChunkFind      m_slotChunkFind;
   SlotChunkSize      m_slotChunkSize;
+
+  SlotChunkFindDeadline m_slotChunkFindDeadline;
+  SlotChunkDeadline     m_slotChunkDeadline;
 };
 
 }
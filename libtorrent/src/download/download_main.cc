@@ -107,6 +107,8 @@ DownloadMain::DownloadMain() :
 
   m_delegator.slot_chunk_find(rak::make_mem_fun(m_chunkSelector, &ChunkSelector::find));
   m_delegator.slot_chunk_size(rak::make_mem_fun(file_list(), &FileList::chunk_index_size));
+  m_delegator.slot_chunk_find_deadline(rak::make_mem_fun(m_chunkSelector, &ChunkSelector::find_deadline));
+  m_delegator.slot_chunk_deadline(rak::make_mem_fun(m_chunkSelector, &ChunkSelector::chunk_deadline));
 
   m_delegator.transfer_list()->slot_canceled(std::bind1st(std::mem_fun(&ChunkSelector::not_using_index), m_chunkSelector));
   m_delegator.transfer_list()->slot_queued(std::bind1st(std::mem_fun(&ChunkSelector::using_index), m_chunkSelector));
@@ -288,6 +290,8 @@ DownloadMain::receive_chunk_done(unsigned int index) {
   if (!handle.is_valid())
     throw storage_error("DownloadState::chunk_done(...) called with an index we couldn't retrieve from storage");
 
+  m_chunkList->flush(&handle);
+
   m_slotHashCheckAdd(handle);
 }
 
@@ -48,9 +48,11 @@
 #include "protocol/peer_connection_base.h"
 #include "torrent/exceptions.h"
 #include "torrent/object.h"
+#include "torrent/data/block_list.h"
 #include "torrent/data/file.h"
 #include "torrent/data/file_list.h"
 #include "torrent/data/file_manager.h"
+#include "torrent/data/transfer_list.h"
 #include "torrent/peer/peer.h"
 #include "torrent/peer/connection_list.h"
 #include "tracker/tracker_manager.h"
@@ -230,8 +232,18 @@ DownloadWrapper::receive_hash_done(ChunkHandle handle, const char* hash) {
 
 void
 DownloadWrapper::check_chunk_hash(ChunkHandle handle) {
+  // Chunks whose blocks were all hashed as they arrived still go
+  // through the queue, so the result is delivered the same way.
+  TransferList* transferList = m_main->delegator()->transfer_list();
+  TransferList::iterator blockListItr = transferList->find(handle.index());
+
+  const Sha1* state = NULL;
+
+  if (blockListItr != transferList->end() && (*blockListItr)->is_hash_complete())
+    state = (*blockListItr)->hash_state();
+
   // Using HashTorrent's queue temporarily.
-  hash_queue()->push_back(handle, rak::make_mem_fun(this, &DownloadWrapper::receive_hash_done));
+  hash_queue()->push_back(handle, rak::make_mem_fun(this, &DownloadWrapper::receive_hash_done), state);
 }
 
 void
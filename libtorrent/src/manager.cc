@@ -42,9 +42,11 @@
 #include "download/download_main.h"
 #include "data/hash_torrent.h"
 #include "data/chunk_list.h"
+#include "data/disk_engine.h"
 #include "protocol/handshake_manager.h"
 #include "data/hash_queue.h"
 #include "net/listen.h"
+#include "net/poll_shards.h"
 
 #include "torrent/chunk_manager.h"
 #include "torrent/connection_manager.h"
@@ -69,6 +71,7 @@ Manager::Manager() :
   m_fileManager(new FileManager),
   m_handshakeManager(new HandshakeManager),
   m_hashQueue(new HashQueue),
+  m_diskEngine(new DiskEngine),
   m_resourceManager(new ResourceManager),
 
   m_chunkManager(new ChunkManager),
@@ -77,6 +80,7 @@ Manager::Manager() :
   m_dhtManager(new DhtManager),
 
   m_poll(NULL),
+  m_pollShards(new PollShards),
 
   m_uploadThrottle(Throttle::create_throttle()),
   m_downloadThrottle(Throttle::create_throttle()),
@@ -99,9 +103,11 @@ Manager::~Manager() {
   m_downloadManager->clear();
 
   delete m_downloadManager;
+  delete m_pollShards;
   delete m_fileManager;
   delete m_handshakeManager;
   delete m_hashQueue;
+  delete m_diskEngine;
 
   delete m_resourceManager;
   delete m_dhtManager;
@@ -56,6 +56,8 @@ class FileManager;
 class ResourceManager;
 class PeerInfo;
 class ChunkManager;
+class DiskEngine;
+class PollShards;
 class ConnectionManager;
 class Throttle;
 class DhtManager;
@@ -71,6 +73,7 @@ public:
   FileManager*        file_manager()                            { return m_fileManager; }
   HandshakeManager*   handshake_manager()                       { return m_handshakeManager; }
   HashQueue*          hash_queue()                              { return m_hashQueue; }
+  DiskEngine*         disk_engine()                             { return m_diskEngine; }
   ResourceManager*    resource_manager()                        { return m_resourceManager; }
 
   ChunkManager*       chunk_manager()                           { return m_chunkManager; }
@@ -81,6 +84,8 @@ public:
   Poll*               poll()                                    { return m_poll; }
   void                set_poll(Poll* p)                         { m_poll = p; }
 
+  PollShards*         poll_shards()                             { return m_pollShards; }
+
   EncodingList*       encoding_list()                           { return &m_encodingList; }
 
   Throttle*           upload_throttle()                         { return m_uploadThrottle; }
@@ -96,6 +101,7 @@ private:
   FileManager*        m_fileManager;
   HandshakeManager*   m_handshakeManager;
   HashQueue*          m_hashQueue;
+  DiskEngine*         m_diskEngine;
   ResourceManager*    m_resourceManager;
 
   ChunkManager*       m_chunkManager;
@@ -103,6 +109,7 @@ private:
   ConnectionManager*  m_connectionManager;
   DhtManager*         m_dhtManager;
   Poll*               m_poll;
+  PollShards*         m_pollShards;
 
   EncodingList        m_encodingList;
 
@@ -0,0 +1,378 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+
+#include "config.h"
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "torrent/exceptions.h"
+#include "torrent/poll_epoll.h"
+#include "torrent/thread_base.h"
+
+#include "globals.h"
+#include "manager.h"
+#include "poll_shards.h"
+
+namespace torrent {
+
+// A network thread and its Poll. The pipe is registered with the
+// thread's own Poll and is only used to wake it up when stopping.
+class PollShard : public Event {
+public:
+  PollShard(PollShards* parent, PollEPoll* poll);
+  ~PollShard();
+
+  PollEPoll*          poll()                            { return m_poll; }
+
+  unsigned int        connections() const               { return m_connections; }
+  void                inc_connections()                 { m_connections++; }
+  void                dec_connections()                 { m_connections--; }
+
+  void                start();
+  void                stop();
+
+  virtual void        event_read();
+  virtual void        event_write();
+  virtual void        event_error();
+
+private:
+  PollShard(const PollShard&);
+  void operator = (const PollShard&);
+
+  static void*        thread_main(void* shard);
+  void                thread_perform();
+
+  PollShards*         m_parent;
+  PollEPoll*          m_poll;
+
+  pthread_t           m_thread;
+  bool                m_active;
+  bool                m_shutdown;
+  int                 m_signalWrite;
+
+  unsigned int        m_connections;
+};
+
+PollShard::PollShard(PollShards* parent, PollEPoll* poll) :
+  m_parent(parent),
+  m_poll(poll),
+  m_active(false),
+  m_shutdown(false),
+  m_connections(0) {
+
+  int fd[2];
+
+  if (::pipe(fd) != 0) {
+    delete m_poll;
+    throw resource_error("Could not create pipe for network thread.");
+  }
+
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(fd[1], F_SETFL, O_NONBLOCK);
+
+  m_fileDesc = fd[0];
+  m_signalWrite = fd[1];
+
+  m_poll->set_flags(Poll::flag_waive_global_lock);
+  m_poll->open(this);
+  m_poll->insert_read(this);
+}
+
+PollShard::~PollShard() {
+  stop();
+
+  m_poll->remove_read(this);
+  m_poll->close(this);
+
+  ::close(m_fileDesc);
+  ::close(m_signalWrite);
+
+  delete m_poll;
+}
+
+void
+PollShard::start() {
+  if (pthread_create(&m_thread, NULL, &PollShard::thread_main, this) != 0)
+    throw resource_error("Could not create network thread.");
+
+  m_active = true;
+}
+
+// The thread needs the global lock to see 'm_shutdown', so it gets
+// released while waiting for the thread to exit.
+void
+PollShard::stop() {
+  if (!m_active)
+    return;
+
+  m_shutdown = true;
+
+  char c = 0;
+  ssize_t __UNUSED result = ::write(m_signalWrite, &c, 1);
+
+  ThreadBase::release_global_lock();
+  pthread_join(m_thread, NULL);
+  ThreadBase::acquire_global_lock();
+
+  m_active = false;
+  m_shutdown = false;
+}
+
+void
+PollShard::event_read() {
+  char buffer[64];
+
+  while (::read(m_fileDesc, buffer, sizeof(buffer)) > 0)
+    ; // Empty.
+}
+
+void
+PollShard::event_write() {
+  throw internal_error("PollShard::event_write() called.");
+}
+
+void
+PollShard::event_error() {
+  throw internal_error("PollShard::event_error() called.");
+}
+
+void*
+PollShard::thread_main(void* shard) {
+  static_cast<PollShard*>(shard)->thread_perform();
+  return NULL;
+}
+
+void
+PollShard::thread_perform() {
+  ThreadBase::acquire_global_lock();
+
+  while (!m_shutdown) {
+    ThreadBase::release_global_lock();
+
+    int status = m_poll->poll(-1);
+    int error = errno;
+
+    ThreadBase::acquire_global_lock();
+
+    if (status == -1) {
+      if (error != EINTR)
+        throw internal_error("PollShard::thread_perform() epoll_wait failed.");
+
+      continue;
+    }
+
+    cachedTime = rak::timer::current();
+
+    bool        wasEmpty = taskScheduler.empty();
+    rak::timer  nextTask = wasEmpty ? rak::timer() : taskScheduler.top()->time();
+
+    m_poll->perform();
+
+    if (!taskScheduler.empty() && (wasEmpty || taskScheduler.top()->time() < nextTask))
+      m_parent->signal_main();
+  }
+
+  ThreadBase::release_global_lock();
+}
+
+PollShards::PollShards() :
+  m_signalWrite(-1) {
+
+  m_fileDesc = -1;
+}
+
+PollShards::~PollShards() {
+  stop_threads();
+  close_signal();
+}
+
+void
+PollShards::resize(unsigned int count) {
+  if (count == m_shards.size())
+    return;
+
+  if (connections() != 0)
+    throw input_error("Network threads can't be changed while peers are connected through them.");
+
+  stop_threads();
+
+  if (count == 0) {
+    close_signal();
+    return;
+  }
+
+  open_signal();
+
+  // The threads inherit the signal mask, so block everything while
+  // creating them to ensure the client's signal handlers only get
+  // called on the main thread.
+  sigset_t fullMask;
+  sigset_t oldMask;
+
+  sigfillset(&fullMask);
+  pthread_sigmask(SIG_SETMASK, &fullMask, &oldMask);
+
+  try {
+    while (m_shards.size() < count) {
+      PollEPoll* poll = PollEPoll::create(manager->poll()->open_max());
+
+      if (poll == NULL)
+        throw input_error("Network threads require epoll support.");
+
+      m_shards.push_back(new PollShard(this, poll));
+      m_shards.back()->start();
+    }
+
+  } catch (local_error&) {
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+    stop_threads();
+    close_signal();
+
+    throw;
+  }
+
+  pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+Poll*
+PollShards::acquire() {
+  if (m_shards.empty())
+    return manager->poll();
+
+  PollShard* shard = m_shards.front();
+
+  for (shard_list::const_iterator itr = m_shards.begin() + 1, last = m_shards.end(); itr != last; ++itr)
+    if ((*itr)->connections() < shard->connections())
+      shard = *itr;
+
+  shard->inc_connections();
+  return shard->poll();
+}
+
+// Connections made before the threads were started use the main
+// thread's Poll and aren't counted.
+void
+PollShards::release(Poll* poll) {
+  for (shard_list::const_iterator itr = m_shards.begin(), last = m_shards.end(); itr != last; ++itr)
+    if ((*itr)->poll() == poll)
+      return (*itr)->dec_connections();
+}
+
+unsigned int
+PollShards::connections() const {
+  unsigned int count = 0;
+
+  for (shard_list::const_iterator itr = m_shards.begin(), last = m_shards.end(); itr != last; ++itr)
+    count += (*itr)->connections();
+
+  return count;
+}
+
+// The main thread empties the pipe before recalculating its timeout,
+// if the pipe is full it has already been signaled.
+void
+PollShards::signal_main() {
+  char c = 0;
+  ssize_t __UNUSED result = ::write(m_signalWrite, &c, 1);
+}
+
+void
+PollShards::event_read() {
+  char buffer[64];
+
+  while (::read(m_fileDesc, buffer, sizeof(buffer)) > 0)
+    ; // Empty.
+}
+
+void
+PollShards::event_write() {
+  throw internal_error("PollShards::event_write() called.");
+}
+
+void
+PollShards::event_error() {
+  throw internal_error("PollShards::event_error() called.");
+}
+
+void
+PollShards::open_signal() {
+  if (m_fileDesc != -1)
+    return;
+
+  int fd[2];
+
+  if (::pipe(fd) != 0)
+    throw resource_error("Could not create pipe for network threads.");
+
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(fd[1], F_SETFL, O_NONBLOCK);
+
+  m_fileDesc = fd[0];
+  m_signalWrite = fd[1];
+
+  manager->poll()->open(this);
+  manager->poll()->insert_read(this);
+}
+
+void
+PollShards::close_signal() {
+  if (m_fileDesc == -1)
+    return;
+
+  manager->poll()->remove_read(this);
+  manager->poll()->close(this);
+
+  ::close(m_fileDesc);
+  ::close(m_signalWrite);
+
+  m_fileDesc = -1;
+  m_signalWrite = -1;
+}
+
+void
+PollShards::stop_threads() {
+  while (!m_shards.empty()) {
+    delete m_shards.back();
+    m_shards.pop_back();
+  }
+}
+
+}
@@ -0,0 +1,110 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+
+#ifndef LIBTORRENT_NET_POLL_SHARDS_H
+#define LIBTORRENT_NET_POLL_SHARDS_H
+
+#include <vector>
+
+#include "torrent/event.h"
+
+namespace torrent {
+
+class Poll;
+class PollShard;
+
+// Network threads that each own a PollEPoll, peer connections are
+// assigned to the thread with the fewest connections when they get
+// initialized. Handshakes, the DHT, trackers and the task scheduler
+// stay on the main thread.
+//
+// Only the waiting for events is done in parallel, a thread takes
+// the global lock before dispatching its events so the handlers stay
+// serialized with the main thread and each other. The client must
+// therefore hold the global lock whenever its main thread isn't
+// polling, as rtorrent does.
+//
+// The main thread's poll timeout is based on the task scheduler, so
+// after dispatching a batch the network thread writes a byte to a
+// pipe registered with the main thread's Poll if the handlers
+// queued a task ahead of those already scheduled.
+
+class PollShards : public Event {
+public:
+  typedef std::vector<PollShard*> shard_list;
+
+  PollShards();
+  ~PollShards();
+
+  unsigned int        size() const                      { return m_shards.size(); }
+
+  // Stops the current threads before starting 'count' new ones,
+  // throws input_error if peers are connected through the threads
+  // being stopped. Must be called with the global lock held.
+  void                resize(unsigned int count);
+
+  // Returns the Poll a new peer connection should use, which is the
+  // main thread's if there are no network threads.
+  Poll*               acquire();
+  void                release(Poll* poll);
+
+  // Number of peer connections using the network threads.
+  unsigned int        connections() const;
+
+  void                signal_main();
+
+  virtual void        event_read();
+  virtual void        event_write();
+  virtual void        event_error();
+
+private:
+  PollShards(const PollShards&);
+  void operator = (const PollShards&);
+
+  void                open_signal();
+  void                close_signal();
+
+  void                stop_threads();
+
+  int                 m_signalWrite;
+
+  shard_list          m_shards;
+};
+
+}
+
+#endif
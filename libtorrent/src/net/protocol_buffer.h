@@ -37,6 +37,7 @@
 #ifndef LIBTORRENT_NET_PROTOCOL_BUFFER_H
 #define LIBTORRENT_NET_PROTOCOL_BUFFER_H
 
+#include <cstring>
 #include <memory>
 #include <inttypes.h>
 #include <netinet/in.h>
@@ -43,6 +43,10 @@
 #include <cstring>
 #include <rak/error_number.h>
 
+#ifdef USE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
 namespace torrent {
 
 std::string
@@ -96,4 +100,83 @@ SocketStream::write_stream_throws(const void* buf, uint32_t length) {
   return r;
 }
 
+uint32_t
+SocketStream::read_vector_throws(const iovec* vec, unsigned int count) {
+  if (count == 0)
+    throw internal_error("Tried to read to vector length 0.");
+
+  ssize_t r = ::readv(m_fileDesc, vec, count);
+
+  if (r == 0)
+    throw close_connection();
+
+  if (r < 0) {
+    if (rak::error_number::current().is_blocked_momentary())
+      return 0;
+    else if (rak::error_number::current().is_closed())
+      throw close_connection();
+    else if (rak::error_number::current().is_blocked_prolonged())
+      throw blocked_connection();
+    else
+      throw connection_error(rak::error_number::current().value());
+  }
+
+  return r;
+}
+
+uint32_t
+SocketStream::write_vector_throws(const iovec* vec, unsigned int count) {
+  if (count == 0)
+    throw internal_error("Tried to write to vector length 0.");
+
+  ssize_t r = ::writev(m_fileDesc, vec, count);
+
+  if (r == 0)
+    throw close_connection();
+
+  if (r < 0) {
+    if (rak::error_number::current().is_blocked_momentary())
+      return 0;
+    else if (rak::error_number::current().is_closed())
+      throw close_connection();
+    else if (rak::error_number::current().is_blocked_prolonged())
+      throw blocked_connection();
+    else
+      throw connection_error(rak::error_number::current().value());
+  }
+
+  return r;
+}
+
+uint32_t
+SocketStream::sendfile_stream_throws(int fd, uint64_t offset, uint32_t length) {
+  if (length == 0)
+    throw internal_error("Tried to sendfile to buffer length 0.");
+
+#ifdef USE_SENDFILE
+  off_t pos = offset;
+  ssize_t r = ::sendfile(m_fileDesc, fd, &pos, length);
+
+  // Nothing sent means the input hit end of file, e.g. the file was
+  // truncated behind our back.
+  if (r == 0)
+    throw storage_error("File chunk read error: unexpected end of file.");
+
+  if (r < 0) {
+    if (rak::error_number::current().is_blocked_momentary())
+      return 0;
+    else if (rak::error_number::current().is_closed())
+      throw close_connection();
+    else if (rak::error_number::current().is_blocked_prolonged())
+      throw blocked_connection();
+    else
+      throw connection_error(rak::error_number::current().value());
+  }
+
+  return r;
+#else
+  throw internal_error("SocketStream::sendfile_stream_throws(...) called but sendfile is not supported.");
+#endif
+}
+
 }
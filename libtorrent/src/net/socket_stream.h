@@ -39,6 +39,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "torrent/exceptions.h"
 #include "socket_base.h"
@@ -56,6 +57,14 @@ public:
   uint32_t            read_stream_throws(void* buf, uint32_t length);
   uint32_t            write_stream_throws(const void* buf, uint32_t length);
 
+  // Scatter/gather versions of the above, 'count' must be non-zero.
+  uint32_t            read_vector_throws(const iovec* vec, unsigned int count);
+  uint32_t            write_vector_throws(const iovec* vec, unsigned int count);
+
+  // Writes directly from the file descriptor, only available if
+  // USE_SENDFILE is defined.
+  uint32_t            sendfile_stream_throws(int fd, uint64_t offset, uint32_t length);
+
   // Handles all the error catching etc. Returns true if the buffer is
   // finished reading/writing.
   bool                read_buffer(void* buf, uint32_t length, uint32_t& pos);
@@ -58,6 +58,8 @@ ThrottleInternal::ThrottleInternal(int flags) :
   m_flags(flags),
   m_nextSlave(m_slaveList.end()),
   m_unusedQuota(0),
+  m_quotaRemainder(0),
+  m_fractionRemainder(0),
   m_timeLastTick(cachedTime) {
 
   if (is_root())
@@ -78,8 +80,12 @@ ThrottleInternal::enable() {
 
   if (is_root()) {
     // We need to start the ticks, and make sure we set timeLastTick
-    // to a value that gives an reasonable initial quota.
-    m_timeLastTick = cachedTime - rak::timer::from_seconds(1);
+    // to a value that gives an reasonable initial quota. Only hand
+    // out a single interval's worth so fast throttles don't start
+    // with a full second of burst.
+    m_timeLastTick = cachedTime - rak::timer(calculate_interval());
+    m_quotaRemainder = 0;
+    m_fractionRemainder = 0;
     receive_tick();
   }
 }
@@ -111,11 +117,23 @@ ThrottleInternal::create_slave() {
 
 void
 ThrottleInternal::receive_tick() {
-  if (cachedTime <= m_timeLastTick + rak::timer::from_milliseconds(90))
+  if (cachedTime < m_timeLastTick + rak::timer(min_tick_interval / 2))
     throw internal_error("ThrottleInternal::receive_tick() called at a to short interval.");
 
-  uint32_t quota = ((uint64_t)(cachedTime.usec() - m_ptr()->m_timeLastTick.usec())) * m_maxRate / 1000000;
-  uint32_t fraction = ((uint64_t)(cachedTime.usec() - m_ptr()->m_timeLastTick.usec())) * fraction_base / 1000000;
+  // Refill as a token bucket at the timer's full resolution. The
+  // sub-byte remainder is kept for the next tick instead of being
+  // truncated away, which at short intervals would otherwise lose a
+  // noticable part of the configured rate.
+  uint64_t elapsed = std::min<uint64_t>(cachedTime.usec() - m_timeLastTick.usec(), 1000000);
+
+  m_quotaRemainder += elapsed * m_maxRate;
+  m_fractionRemainder += elapsed * fraction_base;
+
+  uint32_t quota = m_quotaRemainder / 1000000;
+  uint32_t fraction = m_fractionRemainder / 1000000;
+
+  m_quotaRemainder %= 1000000;
+  m_fractionRemainder %= 1000000;
 
   receive_quota(quota, fraction);
 
@@ -50,6 +50,10 @@ public:
   static const int flag_none = 0;
   static const int flag_root = 1;
 
+  // Ticks shorter than this, in microseconds, would only add
+  // scheduling overhead.
+  static const uint32_t min_tick_interval = 10000;
+
   ThrottleInternal(int flags);
   ~ThrottleInternal();
 
@@ -79,6 +83,11 @@ private:
 
   uint32_t            m_unusedQuota;
 
+  // Refill remainders carried between ticks, in byte-microseconds and
+  // microsecond-fractions, so truncation never loses bandwidth.
+  uint64_t            m_quotaRemainder;
+  uint64_t            m_fractionRemainder;
+
   rak::timer          m_timeLastTick;
   rak::priority_item  m_taskTick;
 };
@@ -62,12 +62,12 @@ ThrottleList::ThrottleList() :
 
 bool
 ThrottleList::is_active(const ThrottleNode* node) const {
-  return std::find(begin(), (const_iterator)m_splitActive, node) != m_splitActive;
+  return is_throttled(node) && node->is_active();
 }
 
 bool
 ThrottleList::is_inactive(const ThrottleNode* node) const {
-  return std::find((const_iterator)m_splitActive, end(), node) != end();
+  return is_throttled(node) && !node->is_active();
 }
 
 bool
@@ -113,7 +113,11 @@ ThrottleList::disable() {
   m_unusedUnthrottledQuota = 0;
 
   std::for_each(begin(), end(), std::mem_fun(&ThrottleNode::clear_quota));
-  std::for_each(m_splitActive, end(), std::mem_fun(&ThrottleNode::activate));
+
+  for (iterator itr = m_splitActive; itr != end(); ++itr) {
+    (*itr)->set_active(true);
+    (*itr)->activate();
+  }
 
   m_splitActive = end();
 }
@@ -140,8 +144,11 @@ ThrottleList::update_quota(uint32_t quota) {
     if ((*m_splitActive)->quota() < m_minChunkSize)
       break;
 
-    (*m_splitActive)->activate();
-    m_splitActive++;
+    // Advance the split before calling the slot so the node is
+    // already considered active if it immediately uses its quota.
+    ThrottleNode* node = *m_splitActive++;
+    node->set_active(true);
+    node->activate();
   }
 
   // Use 'quota' as an upper bound to avoid accumulating unused quota
@@ -223,6 +230,7 @@ ThrottleList::node_deactivate(ThrottleNode* node) {
                          "ThrottleList::node_deactivate(...) could not find node.");
 
   base_type::splice(end(), *this, node->list_iterator());
+  node->set_active(false);
 
   if (m_splitActive == end())
     m_splitActive = node->list_iterator();
@@ -236,12 +244,14 @@ ThrottleList::insert(ThrottleNode* node) {
   if (!m_enabled) {
     // Add to waiting queue.
     node->set_list_iterator(base_type::insert(end(), node));
+    node->set_active(true);
     node->clear_quota();
 
   } else {
     // Add before the active split, so if we only need to decrement
     // m_splitActive to change the queue it is in.
     node->set_list_iterator(base_type::insert(m_splitActive, node));
+    node->set_active(true);
     allocate_quota(node);
   }
 
@@ -272,6 +282,7 @@ ThrottleList::erase(ThrottleNode* node) {
 
   node->clear_quota();
   node->set_list_iterator(end());
+  node->set_active(false);
   m_size--;
 }
 
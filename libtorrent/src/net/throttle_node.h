@@ -53,7 +53,7 @@ public:
   typedef ThrottleList::const_iterator            const_iterator;
   typedef rak::mem_fun0<SocketBase, void>         SlotActivate;
 
-  ThrottleNode(uint32_t rateSpan) : m_rate(rateSpan)  { clear_quota(); }
+  ThrottleNode(uint32_t rateSpan) : m_active(false), m_rate(rateSpan) { clear_quota(); }
 
   Rate*               rate()                          { return &m_rate; }
   const Rate*         rate() const                    { return &m_rate; }
@@ -66,6 +66,11 @@ public:
   const_iterator      list_iterator() const           { return m_listIterator; }
   void                set_list_iterator(iterator itr) { m_listIterator = itr; }
 
+  // Cached side of ThrottleList's active split, so lookups need not
+  // walk the list. Only meaningful while the node is in a list.
+  bool                is_active() const               { return m_active; }
+  void                set_active(bool v)              { m_active = v; }
+
   void                activate()                      { m_slotActivate(); }
 
   void                slot_activate(SlotActivate s)   { m_slotActivate = s; }
@@ -76,6 +81,7 @@ private:
 
   uint32_t            m_quota;
   iterator            m_listIterator;
+  bool                m_active;
 
   Rate                m_rate;
   SlotActivate        m_slotActivate;
@@ -0,0 +1,81 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+#ifndef LIBTORRENT_PROTOCOL_ENCRYPT_BUFFER_H
+#define LIBTORRENT_PROTOCOL_ENCRYPT_BUFFER_H
+
+#include <algorithm>
+#include <sys/uio.h>
+
+#include "net/protocol_buffer.h"
+
+namespace torrent {
+
+// Stages the next 'quota' bytes of a piece, encrypted, in 'buffer'
+// and points 'vec' at the bytes ready to be written. Bytes already
+// staged but not yet consumed are reused, so 'encrypt(offset, dest,
+// length)' is only called for the piece data following them, with
+// 'offset' relative to the first unsent byte of the piece.
+//
+// A drained buffer is rewound before new data is staged, thus 'vec'
+// is only valid after this call and must not be taken from the
+// buffer's position beforehand.
+template <uint16_t tmpl_size, typename Encrypt>
+inline void
+encrypt_buffer_stage(ProtocolBuffer<tmpl_size>* buffer, uint32_t quota, Encrypt encrypt, iovec* vec) {
+  if (quota > buffer->remaining()) {
+    uint32_t staged = buffer->remaining();
+
+    if (staged == 0) {
+      buffer->reset();
+      quota = std::min<uint32_t>(quota, buffer->reserved());
+
+    } else {
+      quota = std::min<uint32_t>(quota - staged, buffer->reserved_left());
+    }
+
+    encrypt(staged, buffer->end(), quota);
+    buffer->move_end(quota);
+
+    quota = buffer->remaining();
+  }
+
+  vec->iov_base = buffer->position();
+  vec->iov_len = quota;
+}
+
+}
+
+#endif
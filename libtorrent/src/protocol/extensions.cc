@@ -36,6 +36,7 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <limits>
 #include <stdarg.h>
 
@@ -313,7 +314,7 @@ ProtocolExtension::parse_handshake() {
   }
 
   if (message[key_reqq].is_value())
-    m_maxQueueLength = message[key_reqq].as_value();
+    m_maxQueueLength = std::max<int64_t>(message[key_reqq].as_value(), 1);
 
   if (message[key_metadataSize].is_value())
     m_download->set_metadata_size(message[key_metadataSize].as_value());
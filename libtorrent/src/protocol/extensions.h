@@ -115,7 +115,10 @@ public:
   void                unset_local_enabled(int t);
   void                set_remote_supported(int t)      { m_flags |= flag_remote_supported_base << t; }
 
-  // General information about peer from extension handshake.
+  // General information about peer from extension handshake. Peers
+  // that don't send 'reqq' are assumed to accept the common default.
+  static const uint32_t default_max_queue_length = 250;
+
   uint32_t            max_queue_length() const         { return m_maxQueueLength; }
 
   // Handle reading extension data from peer.
@@ -217,6 +220,7 @@ inline
 ProtocolExtension::ProtocolExtension() :
   // Set HANDSHAKE as enabled and supported. Those bits should not be
   // touched.
+  m_maxQueueLength(default_max_queue_length),
   m_flags(flag_local_enabled_base | flag_remote_supported_base | flag_initial_handshake),
   m_peerInfo(NULL),
   m_download(NULL),
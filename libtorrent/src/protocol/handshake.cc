@@ -42,6 +42,7 @@
 #include "torrent/download_info.h"
 #include "torrent/exceptions.h"
 #include "torrent/error.h"
+#include "torrent/object_pool.h"
 #include "torrent/poll.h"
 #include "torrent/throttle.h"
 #include "utils/diffie_hellman.h"
@@ -75,6 +76,18 @@ public:
   handshake_succeeded() {}
 };
 
+static ObjectPool& handshake_pool = *new ObjectPool("handshake", sizeof(Handshake), 256);
+
+void*
+Handshake::operator new(size_t size) {
+  return handshake_pool.allocate(size);
+}
+
+void
+Handshake::operator delete(void* ptr) {
+  handshake_pool.deallocate(ptr);
+}
+
 Handshake::Handshake(SocketFd fd, HandshakeManager* m, int encryptionOptions) :
   m_state(INACTIVE),
 
@@ -977,7 +990,7 @@ Handshake::prepare_proxy_connect() {
 
 void
 Handshake::prepare_key_plus_pad() {
-  m_encryption.initialize();
+  m_encryption.initialize(m_manager->key_pool());
 
   m_encryption.key()->store_pub_key(m_writeBuffer.end(), 96);
   m_writeBuffer.move_end(96);
@@ -96,6 +96,10 @@ public:
   Handshake(SocketFd fd, HandshakeManager* m, int encryption_options);
   ~Handshake();
 
+  // Allocated from an ObjectPool.
+  static void*        operator new(size_t size);
+  static void         operator delete(void* ptr);
+
   bool                is_active() const             { return m_state != INACTIVE; }
 
   State               state() const                 { return m_state; }
@@ -70,8 +70,8 @@ HandshakeEncryption::should_retry() const {
 }
 
 void
-HandshakeEncryption::initialize() {
-  m_key = new DiffieHellman(dh_prime, dh_prime_length, dh_generator, dh_generator_length);
+HandshakeEncryption::initialize(DiffieHellmanPool* keyPool) {
+  m_key = keyPool->take();
 }
 
 void
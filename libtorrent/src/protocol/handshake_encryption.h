@@ -44,6 +44,7 @@
 namespace torrent {
 
 class DiffieHellman;
+class DiffieHellmanPool;
 
 class HandshakeEncryption {
 public:
@@ -98,7 +99,7 @@ public:
   unsigned int        length_ia() const                            { return m_lengthIA; }
   void                set_length_ia(unsigned int len)              { m_lengthIA = len; }
 
-  void                initialize();
+  void                initialize(DiffieHellmanPool* keyPool);
   void                cleanup();
 
   void                initialize_decrypt(const char* origHash, bool incoming);
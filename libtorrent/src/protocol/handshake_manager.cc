@@ -49,6 +49,7 @@
 
 #include "peer_connection_base.h"
 #include "handshake.h"
+#include "handshake_encryption.h"
 #include "handshake_manager.h"
 
 #include "manager.h"
@@ -57,6 +58,12 @@ namespace torrent {
 
 ProtocolExtension HandshakeManager::DefaultExtensions = ProtocolExtension::make_default();
 
+HandshakeManager::HandshakeManager() :
+  m_keyPool(HandshakeEncryption::dh_prime, HandshakeEncryption::dh_prime_length,
+            HandshakeEncryption::dh_generator, HandshakeEncryption::dh_generator_length,
+            key_pool_size) {
+}
+
 inline void
 handshake_manager_delete_handshake(Handshake* h) {
   h->deactivate_connection();
@@ -45,6 +45,7 @@
 #include <torrent/connection_manager.h>
 
 #include "net/socket_fd.h"
+#include "utils/diffie_hellman.h"
 
 namespace torrent {
 
@@ -65,7 +66,11 @@ public:
 
   using base_type::empty;
 
-  HandshakeManager() { }
+  // Number of DH keys generated ahead of time for encrypted
+  // handshakes.
+  static const unsigned int key_pool_size = 32;
+
+  HandshakeManager();
   ~HandshakeManager() { clear(); }
 
   size_type           size() const { return base_type::size(); }
@@ -94,6 +99,8 @@ public:
 
   ProtocolExtension*  default_extensions() const                        { return &DefaultExtensions; }
 
+  DiffieHellmanPool*  key_pool()                                        { return &m_keyPool; }
+
 private:
   void                create_outgoing(const rak::socket_address& sa, DownloadMain* info, int encryptionOptions);
   void                erase(Handshake* handshake);
@@ -104,6 +111,8 @@ private:
 
   SlotDownloadId      m_slotDownloadId;
   SlotDownloadId      m_slotDownloadIdObfuscated;
+
+  DiffieHellmanPool   m_keyPool;
 };
 
 }
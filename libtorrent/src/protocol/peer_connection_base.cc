@@ -37,27 +37,35 @@
 #include "config.h"
 
 #include <cstdio>
+#include <cstring>
 #include <fcntl.h>
 #include <rak/error_number.h>
 #include <rak/string_manip.h>
 
+#include "data/block_cache.h"
 #include "data/chunk_iterator.h"
 #include "data/chunk_list.h"
 #include "download/chunk_selector.h"
 #include "download/chunk_statistics.h"
 #include "download/download_main.h"
+#include "net/poll_shards.h"
 #include "net/socket_base.h"
 #include "torrent/exceptions.h"
 #include "torrent/data/block.h"
+#include "torrent/data/block_list.h"
+#include "torrent/data/file.h"
+#include "torrent/data/file_list.h"
 #include "torrent/chunk_manager.h"
 #include "torrent/connection_manager.h"
 #include "torrent/download_info.h"
+#include "torrent/object_pool.h"
 #include "torrent/throttle.h"
 #include "torrent/download/choke_queue.h"
 #include "torrent/peer/peer_info.h"
 #include "torrent/peer/connection_list.h"
 #include "torrent/utils/log_files.h"
 
+#include "encrypt_buffer.h"
 #include "extensions.h"
 #include "peer_connection_base.h"
 
@@ -65,14 +73,86 @@
 
 namespace torrent {
 
+// Fills the vector with the memory segments of the chunk between
+// 'first' and 'last', returns the end of the entries used.
+static inline iovec*
+chunk_fill_vector(Chunk* chunk, uint32_t first, uint32_t last, iovec* vecFirst, iovec* vecLast) {
+  ChunkIterator itr(chunk, first, last);
+
+  do {
+    Chunk::data_type data = itr.data();
+
+    vecFirst->iov_base = data.first;
+    vecFirst->iov_len = data.second;
+
+  } while (++vecFirst != vecLast && itr.next());
+
+  return vecFirst;
+}
+
+struct file_offset_less {
+  bool operator () (uint64_t position, const File* file) const { return position < file->offset(); }
+};
+
+// Files are sorted by offset, and empty files never contain a
+// position, so the file holding 'position' is the last one starting
+// at or before it.
+static File*
+find_file_at_position(FileList* fileList, uint64_t position) {
+  FileList::iterator itr = std::upper_bound(fileList->begin(), fileList->end(), position, file_offset_less());
+
+  if (itr == fileList->begin() || !(*--itr)->is_valid_position(position))
+    return NULL;
+
+  return *itr;
+}
+
+static inline uint32_t
+vector_length(const iovec* first, const iovec* last) {
+  uint32_t length = 0;
+
+  for (; first != last; ++first)
+    length += first->iov_len;
+
+  return length;
+}
+
+static ObjectPool& encrypt_buffer_pool = *new ObjectPool("encrypt_buffer", sizeof(PeerConnectionBase::EncryptBuffer), 64);
+static ObjectPool& protocol_pool       = *new ObjectPool("protocol", sizeof(ProtocolBase), 2048);
+
+void*
+ProtocolBase::operator new(size_t size) {
+  return protocol_pool.allocate(size);
+}
+
+void
+ProtocolBase::operator delete(void* ptr) {
+  protocol_pool.deallocate(ptr);
+}
+
+void*
+PeerConnectionBase::EncryptBuffer::operator new(size_t size) {
+  return encrypt_buffer_pool.allocate(size);
+}
+
+void
+PeerConnectionBase::EncryptBuffer::operator delete(void* ptr) {
+  encrypt_buffer_pool.deallocate(ptr);
+}
+
 PeerConnectionBase::PeerConnectionBase() :
   m_download(NULL),
+  m_poll(NULL),
   
   m_down(new ProtocolRead()),
   m_up(new ProtocolWrite()),
 
   m_downStall(0),
 
+  m_upBlock(NULL),
+  m_upSendfile(false),
+  m_upFile(NULL),
+
   m_downInterested(false),
   m_downUnchoked(false),
 
@@ -151,10 +231,11 @@ PeerConnectionBase::initialize(DownloadMain* download, PeerInfo* peerInfo, Socke
     return;
   }
 
-  manager->poll()->open(this);
-  manager->poll()->insert_read(this);
-  manager->poll()->insert_write(this);
-  manager->poll()->insert_error(this);
+  m_poll = manager->poll_shards()->acquire();
+  m_poll->open(this);
+  m_poll->insert_read(this);
+  m_poll->insert_write(this);
+  m_poll->insert_error(this);
 
   m_timeLastRead = cachedTime;
 
@@ -191,10 +272,13 @@ PeerConnectionBase::cleanup() {
   if (!m_extensions->is_default())
     m_extensions->cleanup();
 
-  manager->poll()->remove_read(this);
-  manager->poll()->remove_write(this);
-  manager->poll()->remove_error(this);
-  manager->poll()->close(this);
+  m_poll->remove_read(this);
+  m_poll->remove_write(this);
+  m_poll->remove_error(this);
+  m_poll->close(this);
+
+  manager->poll_shards()->release(m_poll);
+  m_poll = NULL;
   
   manager->connection_manager()->dec_socket_count();
 
@@ -296,6 +380,27 @@ PeerConnectionBase::receive_download_choke(bool choke) {
 
 void
 PeerConnectionBase::load_up_chunk() {
+  // Unencrypted pieces can be sent straight from the file, so there
+  // is no need to map the chunk.
+  m_upSendfile = !is_encrypted() && manager->connection_manager()->use_sendfile();
+
+  if (m_upSendfile) {
+    up_chunk_release();
+    return;
+  }
+
+  BlockCache* blockCache = manager->chunk_manager()->block_cache();
+
+  up_block_release();
+
+  if (is_encrypted() && m_encryptBuffer == NULL) {
+    m_encryptBuffer = new EncryptBuffer();
+    m_encryptBuffer->reset();
+  }
+
+  if (blockCache->is_enabled() && (m_upBlock = blockCache->find(m_download->chunk_list(), m_upPiece)) != NULL)
+    return;
+
   if (m_upChunk.is_valid() && m_upChunk.index() == m_upPiece.index()) {
     // Better checking needed.
     //     m_upChunk.chunk()->preload(m_upPiece.offset(), m_upChunk.chunk()->size());
@@ -303,6 +408,9 @@ PeerConnectionBase::load_up_chunk() {
     if (log_files[LOG_MINCORE_STATS].is_open())
       log_mincore_stats_func(m_upChunk.chunk()->is_incore(m_upPiece.offset(), m_upPiece.length()), false, m_incoreContinous);
 
+    if (blockCache->is_enabled())
+      m_upBlock = blockCache->insert(m_download->chunk_list(), m_upPiece, m_upChunk.chunk());
+
     return;
   }
 
@@ -313,10 +421,8 @@ PeerConnectionBase::load_up_chunk() {
   if (!m_upChunk.is_valid())
     throw storage_error("File chunk read error: " + std::string(m_upChunk.error_number().c_str()));
 
-  if (is_encrypted() && m_encryptBuffer == NULL) {
-    m_encryptBuffer = new EncryptBuffer();
-    m_encryptBuffer->reset();
-  }
+  if (blockCache->is_enabled())
+    m_upBlock = blockCache->insert(m_download->chunk_list(), m_upPiece, m_upChunk.chunk());
 
   m_incoreContinous = false;
 
@@ -366,6 +472,16 @@ PeerConnectionBase::event_error() {
   m_download->connection_list()->erase(this, 0);
 }
 
+void
+PeerConnectionBase::receive_throttle_down_activate() {
+  m_poll->insert_read(this);
+}
+
+void
+PeerConnectionBase::receive_throttle_up_activate() {
+  m_poll->insert_write(this);
+}
+
 bool
 PeerConnectionBase::down_chunk_start(const Piece& piece) {
   if (!download_queue()->downloading(piece)) {
@@ -398,6 +514,10 @@ PeerConnectionBase::down_chunk_finished() {
     if (!m_downChunk.is_valid())
       throw internal_error("PeerConnectionBase::down_chunk_finished() Transfer is the leader, but no chunk allocated.");
 
+    // Hash the block while it is still hot in the cache, this must be
+    // done before 'finished' as it clears the transfer's block.
+    download_queue()->transfer()->block()->parent()->hash_finished_blocks(m_downChunk.chunk());
+
     download_queue()->finished();
     m_downChunk.object()->set_time_modified(cachedTime);
 
@@ -437,30 +557,51 @@ PeerConnectionBase::down_chunk() {
   uint32_t quota = m_down->throttle()->node_quota(m_peerChunks.download_throttle());
 
   if (quota == 0) {
-    manager->poll()->remove_read(this);
+    m_poll->remove_read(this);
     m_down->throttle()->node_deactivate(m_peerChunks.download_throttle());
     return false;
   }
 
-  uint32_t bytesTransfered = 0;
   BlockTransfer* transfer = m_downloadQueue.transfer();
+  ProtocolRead::Buffer* buffer = m_down->buffer();
 
-  Chunk::data_type data;
-  ChunkIterator itr(m_downChunk.chunk(),
-                    transfer->piece().offset() + transfer->position(),
-                    transfer->piece().offset() + std::min(transfer->position() + quota, transfer->piece().length()));
+  uint32_t first = transfer->piece().offset() + transfer->position();
+  uint32_t last = transfer->piece().offset() + std::min(transfer->position() + quota, transfer->piece().length());
 
-  do {
-    data = itr.data();
-    data.second = read_stream_throws(data.first, data.second);
+  iovec vec[vector_size];
+  iovec* vecLast = chunk_fill_vector(m_downChunk.chunk(), first, last, vec, vec + vector_size - 1);
 
-    if (is_encrypted())
-      m_encryption.decrypt(data.first, data.second);
+  uint32_t length = vector_length(vec, vecLast);
+
+  // When the rest of the piece gets read, also read the start of the
+  // next messages into the empty read buffer.
+  if (first + length == transfer->piece().offset() + transfer->piece().length() &&
+      buffer->remaining() == 0 && buffer->size_end() < read_size) {
+    vecLast->iov_base = buffer->end();
+    vecLast->iov_len = read_size - buffer->size_end();
+    vecLast++;
+  }
+
+  uint32_t bytesRead = read_vector_throws(vec, std::distance(vec, vecLast));
+  uint32_t bytesTransfered = std::min(bytesRead, length);
+
+  if (is_encrypted()) {
+    uint32_t remaining = bytesRead;
+
+    for (iovec* itr = vec; remaining != 0; ++itr) {
+      uint32_t l = std::min<uint32_t>(itr->iov_len, remaining);
 
-    bytesTransfered += data.second;
+      m_encryption.decrypt(itr->iov_base, l);
+      remaining -= l;
+    }
+  }
 
-  } while (data.second != 0 && itr.forward(data.second));
+  if (bytesRead > bytesTransfered)
+    m_down->throttle()->node_used_unthrottled(buffer->move_end(bytesRead - bytesTransfered));
 
+  // The data was read straight into the chunk, so buffered parts need
+  // to be told they must be written back.
+  m_downChunk.chunk()->mark_dirty(first, bytesTransfered);
   transfer->adjust_position(bytesTransfered);
 
   m_down->throttle()->node_used(m_peerChunks.download_throttle(), bytesTransfered);
@@ -492,7 +633,7 @@ PeerConnectionBase::down_chunk_skip() {
   uint32_t quota = throttle->node_quota(m_peerChunks.download_throttle());
 
   if (quota == 0) {
-    manager->poll()->remove_read(this);
+    m_poll->remove_read(this);
     throttle->node_deactivate(m_peerChunks.download_throttle());
     return false;
   }
@@ -557,6 +698,8 @@ PeerConnectionBase::down_chunk_skip_process(const void* buffer, uint32_t length)
   m_download->info()->mutable_skip_rate()->insert(length);
 
   if (!transfer->is_valid()) {
+    m_download->delegator()->transfer_list()->add_wasted(length);
+
     transfer->adjust_position(length);
     return length;
   }
@@ -577,12 +720,15 @@ PeerConnectionBase::down_chunk_skip_process(const void* buffer, uint32_t length)
   if (!m_downChunk.chunk()->compare_buffer(buffer, transfer->piece().offset() + transfer->position(), compareLength)) {
     m_download->info()->signal_network_log().emit("Data does not match what was previously downloaded.");
     
+    m_download->delegator()->transfer_list()->add_dissimilar(length);
+
     m_downloadQueue.transfer_dissimilar();
     m_downloadQueue.transfer()->adjust_position(length);
 
     return length;
   }
 
+  m_download->delegator()->transfer_list()->add_wasted(compareLength);
   transfer->adjust_position(compareLength);
 
   if (compareLength == length)
@@ -622,40 +768,75 @@ PeerConnectionBase::down_extension() {
   // If extension can't be processed yet (due to a pending write),
   // disable reads until the pending message is completely sent.
   if (m_extensions->is_complete() && !m_extensions->is_invalid() && !m_extensions->read_done()) {
-    manager->poll()->remove_read(this);
+    m_poll->remove_read(this);
     return false;
   }
 
   return m_extensions->is_complete();
 }
 
-inline uint32_t
-PeerConnectionBase::up_chunk_encrypt(uint32_t quota) {
+struct PeerConnectionBase::up_chunk_encryptor {
+  up_chunk_encryptor(PeerConnectionBase* pcb) : m_pcb(pcb) {}
+
+  void operator () (uint32_t offset, uint8_t* dest, uint32_t length) { m_pcb->up_chunk_encrypt_range(offset, dest, length); }
+
+  PeerConnectionBase* m_pcb;
+};
+
+// Points 'vec' at up to 'quota' encrypted bytes of the piece, only
+// bytes beyond what is already in the buffer get encrypted.
+inline void
+PeerConnectionBase::up_chunk_encrypt(iovec* vec, uint32_t quota) {
   if (m_encryptBuffer == NULL)
     throw internal_error("PeerConnectionBase::up_chunk: m_encryptBuffer is NULL.");
 
-  if (quota <= m_encryptBuffer->remaining())
-    return quota;
+  encrypt_buffer_stage(m_encryptBuffer, quota, up_chunk_encryptor(this), vec);
+}
 
-  // Also, consider checking here if the number of bytes remaining in
-  // the buffer is small enought that the cost of moving them would
-  // outweigh the extra context switches, etc.
+// Encrypt straight from the block or the mapped chunk into the
+// buffer instead of copying the plaintext there first.
+inline void
+PeerConnectionBase::up_chunk_encrypt_range(uint32_t offset, uint8_t* dest, uint32_t length) {
+  offset += m_upPiece.offset();
 
-  if (m_encryptBuffer->remaining() == 0) {
-    // This handles reset also for new chunk transfers.
-    m_encryptBuffer->reset();
+  if (m_upBlock != NULL) {
+    m_encryption.encrypt(m_upBlock->at_offset(offset), dest, length);
+    return;
+  }
 
-    quota = std::min<uint32_t>(quota, m_encryptBuffer->reserved());
+  if (offset + length > m_upChunk.chunk()->chunk_size())
+    throw internal_error("PeerConnectionBase::up_chunk_encrypt(...) position + length > chunk_size.");
 
-  } else {
-    quota = std::min<uint32_t>(quota - m_encryptBuffer->remaining(), m_encryptBuffer->reserved_left());
-  }
+  ChunkIterator itr(m_upChunk.chunk(), offset, offset + length);
 
-  m_upChunk.chunk()->to_buffer(m_encryptBuffer->end(), m_upPiece.offset() + m_encryptBuffer->remaining(), quota);
-  m_encryption.encrypt(m_encryptBuffer->end(), quota);
-  m_encryptBuffer->move_end(quota);
+  do {
+    Chunk::data_type data = itr.data();
 
-  return m_encryptBuffer->remaining();
+    m_encryption.encrypt(data.first, dest, data.second);
+    dest += data.second;
+  } while (itr.next());
+}
+
+// Sends from the file containing 'offset' in the current piece,
+// 'length' is truncated to the end of that file.
+inline uint32_t
+PeerConnectionBase::up_chunk_sendfile(uint32_t offset, uint32_t& length) {
+  FileList* fileList = m_download->file_list();
+  uint64_t position = (uint64_t)m_upPiece.index() * fileList->chunk_size() + offset;
+
+  // Consecutive sends nearly always hit the file of the last one.
+  if (m_upFile == NULL || !m_upFile->is_valid_position(position))
+    m_upFile = find_file_at_position(fileList, position);
+
+  if (m_upFile == NULL)
+    throw internal_error("PeerConnectionBase::up_chunk_sendfile(...) could not find a valid file.");
+
+  if (!m_upFile->prepare(MemoryChunk::prot_read))
+    throw storage_error("File chunk read error: " + std::string(rak::error_number::current().c_str()));
+
+  length = std::min<uint64_t>(length, m_upFile->offset() + m_upFile->size_bytes() - position);
+
+  return sendfile_stream_throws(m_upFile->file_descriptor(), position - m_upFile->offset(), length);
 }
 
 bool
@@ -663,13 +844,13 @@ PeerConnectionBase::up_chunk() {
   if (!m_up->throttle()->is_throttled(m_peerChunks.upload_throttle()))
     throw internal_error("PeerConnectionBase::up_chunk() tried to write a piece but is not in throttle list");
 
-  if (!m_upChunk.chunk()->is_readable())
+  if (!m_upSendfile && m_upBlock == NULL && !m_upChunk.chunk()->is_readable())
     throw internal_error("ProtocolChunk::write_part() chunk not readable, permission denided");
 
   uint32_t quota = m_up->throttle()->node_quota(m_peerChunks.upload_throttle());
 
   if (quota == 0) {
-    manager->poll()->remove_write(this);
+    m_poll->remove_write(this);
     m_up->throttle()->node_deactivate(m_peerChunks.upload_throttle());
     return false;
   }
@@ -680,33 +861,98 @@ PeerConnectionBase::up_chunk() {
     // Prepare as many bytes as quota specifies, up to end of piece or
     // buffer. Only bytes beyond remaining() are new and will be
     // encrypted.
-    quota = up_chunk_encrypt(std::min(quota, m_upPiece.length()));
+    iovec vec;
+    up_chunk_encrypt(&vec, std::min(quota, m_upPiece.length()));
 
-    bytesTransfered = write_stream_throws(m_encryptBuffer->position(), quota);
+    bytesTransfered = write_stream_throws(vec.iov_base, vec.iov_len);
     m_encryptBuffer->consume(bytesTransfered);
 
-  } else {
-    Chunk::data_type data;
-    ChunkIterator itr(m_upChunk.chunk(), m_upPiece.offset(), m_upPiece.offset() + std::min(quota, m_upPiece.length()));
+  } else if (m_upSendfile) {
+    uint32_t length = std::min(quota, m_upPiece.length());
+    uint32_t attempted;
+    uint32_t written;
 
     do {
-      data = itr.data();
-      data.second = write_stream_throws(data.first, data.second);
+      attempted = length - bytesTransfered;
+      written = up_chunk_sendfile(m_upPiece.offset() + bytesTransfered, attempted);
+
+      bytesTransfered += written;
+
+    } while (written != 0 && written == attempted && bytesTransfered != length);
+
+  } else {
+    iovec vec[vector_size];
+    iovec* last = up_chunk_vector(vec, vec + vector_size, std::min(quota, m_upPiece.length()));
+
+    bytesTransfered = write_vector_throws(vec, std::distance(vec, last));
+  }
+
+  up_chunk_written(bytesTransfered);
+
+  return m_upPiece.length() == 0;
+}
+
+// Writes the queued protocol messages, the last being the piece
+// header, together with the start of the piece using a single
+// writev. Returns true if all the messages were written.
+bool
+PeerConnectionBase::up_chunk_with_messages() {
+  if (m_upSendfile || !m_up->throttle()->is_throttled(m_peerChunks.upload_throttle()))
+    throw internal_error("PeerConnectionBase::up_chunk_with_messages() called in a bad state.");
+
+  ProtocolWrite::Buffer* buffer = m_up->buffer();
+  uint32_t quota = std::min(m_up->throttle()->node_quota(m_peerChunks.upload_throttle()), m_upPiece.length());
 
-      bytesTransfered += data.second;
+  iovec vec[vector_size];
+  iovec* last = vec + 1;
 
-    } while (data.second != 0 && itr.forward(data.second));
+  vec[0].iov_base = buffer->position();
+  vec[0].iov_len = buffer->remaining();
+
+  if (quota != 0 && is_encrypted()) {
+    up_chunk_encrypt(last++, quota);
+
+  } else if (quota != 0) {
+    last = up_chunk_vector(last, vec + vector_size, quota);
   }
 
-  m_up->throttle()->node_used(m_peerChunks.upload_throttle(), bytesTransfered);
-  m_download->info()->mutable_up_rate()->insert(bytesTransfered);
+  uint32_t bytesWritten = write_vector_throws(vec, std::distance(vec, last));
+  uint32_t headerWritten = std::min<uint32_t>(bytesWritten, buffer->remaining());
+
+  m_up->throttle()->node_used_unthrottled(headerWritten);
+
+  if (bytesWritten > headerWritten) {
+    if (is_encrypted())
+      m_encryptBuffer->consume(bytesWritten - headerWritten);
+
+    up_chunk_written(bytesWritten - headerWritten);
+  }
+
+  return buffer->consume(headerWritten);
+}
+
+// Fills the vector with the next 'length' bytes of the piece, returns
+// the end of the entries used.
+inline iovec*
+PeerConnectionBase::up_chunk_vector(iovec* first, iovec* last, uint32_t length) {
+  if (m_upBlock != NULL) {
+    first->iov_base = const_cast<char*>(m_upBlock->at_offset(m_upPiece.offset()));
+    first->iov_len = length;
+    return first + 1;
+  }
+
+  return chunk_fill_vector(m_upChunk.chunk(), m_upPiece.offset(), m_upPiece.offset() + length, first, last);
+}
+
+inline void
+PeerConnectionBase::up_chunk_written(uint32_t bytes) {
+  m_up->throttle()->node_used(m_peerChunks.upload_throttle(), bytes);
+  m_download->info()->mutable_up_rate()->insert(bytes);
 
   // Just modifying the piece to cover the remaining data ends up
   // being much cleaner and we avoid an unnessesary position variable.
-  m_upPiece.set_offset(m_upPiece.offset() + bytesTransfered);
-  m_upPiece.set_length(m_upPiece.length() - bytesTransfered);
-
-  return m_upPiece.length() == 0;
+  m_upPiece.set_offset(m_upPiece.offset() + bytes);
+  m_upPiece.set_length(m_upPiece.length() - bytes);
 }
 
 bool
@@ -743,7 +989,7 @@ PeerConnectionBase::up_extension() {
     if (!m_extensions->read_done())
       throw internal_error("PeerConnectionBase::up_extension could not process complete extension message.");
 
-    manager->poll()->insert_read(this);
+    m_poll->insert_read(this);
   }
 
   return true;
@@ -757,10 +1003,21 @@ PeerConnectionBase::down_chunk_release() {
 
 void
 PeerConnectionBase::up_chunk_release() {
+  up_block_release();
+
   if (m_upChunk.is_valid())
     m_download->chunk_list()->release(&m_upChunk);
 }
 
+void
+PeerConnectionBase::up_block_release() {
+  if (m_upBlock == NULL)
+    return;
+
+  manager->chunk_manager()->block_cache()->release(m_upBlock);
+  m_upBlock = NULL;
+}
+
 void
 PeerConnectionBase::read_request_piece(const Piece& p) {
   PeerChunks::piece_list_type::iterator itr = std::find(m_peerChunks.upload_queue()->begin(), m_peerChunks.upload_queue()->end(), p);
@@ -795,6 +1052,10 @@ PeerConnectionBase::write_prepare_piece() {
   }
   
   m_up->write_piece(m_upPiece);
+
+  // Load the piece now so the header can be sent together with the
+  // data.
+  load_up_chunk();
 }
 
 void
@@ -834,7 +1095,8 @@ PeerConnectionBase::try_request_pieces() {
   if (download_queue()->queued_empty())
     m_downStall = 0;
 
-  uint32_t pipeSize = download_queue()->calculate_pipe_size(m_peerChunks.download_throttle()->rate()->rate());
+  uint32_t pipeSize = download_queue()->calculate_pipe_size(m_peerChunks.download_throttle()->rate()->rate(),
+                                                            m_extensions->max_queue_length());
 
   // Don't start requesting if we can't do it in large enough chunks.
   if (download_queue()->queued_size() >= (pipeSize + 10) / 2)
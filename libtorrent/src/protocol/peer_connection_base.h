@@ -71,14 +71,22 @@ public:
 
 #if USE_EXTRA_DEBUG == 666
   // For testing, use a really small buffer.
-  typedef ProtocolBuffer<256>  EncryptBuffer;
+  typedef ProtocolBuffer<256>    EncryptBufferBase;
 #else
-  typedef ProtocolBuffer<16384>  EncryptBuffer;
+  typedef ProtocolBuffer<16384>  EncryptBufferBase;
 #endif
 
+  struct EncryptBuffer : public EncryptBufferBase {
+    static void*      operator new(size_t size);
+    static void       operator delete(void* ptr);
+  };
+
   // Find an optimal number for this.
   static const uint32_t read_size = 64;
 
+  // Maximum number of segments in a single readv/writev call.
+  static const unsigned int vector_size = 16;
+
   // Bitmasks for peer exchange messages to send.
   static const int PEX_DO      = (1 << 0);
   static const int PEX_ENABLE  = (1 << 1);
@@ -86,6 +94,10 @@ public:
 
   PeerConnectionBase();
   virtual ~PeerConnectionBase();
+
+  // Allocated from an ObjectPool shared by all connection types.
+  static void*        operator new(size_t size);
+  static void         operator delete(void* ptr);
   
   void                initialize(DownloadMain* download, PeerInfo* p, SocketFd fd, Bitfield* bitfield, EncryptionInfo* encryptionInfo, ProtocolExtension* extensions);
   void                cleanup();
@@ -140,6 +152,12 @@ public:
   void                read_insert_poll_safe();
   void                write_insert_poll_safe();
 
+  // Either the main thread's Poll or that of a network thread.
+  Poll*               poll()                          { return m_poll; }
+
+  virtual void        receive_throttle_down_activate();
+  virtual void        receive_throttle_up_activate();
+
   // Communication with the protocol extensions
   virtual void        receive_metadata_piece(uint32_t piece, const char* data, uint32_t length);
 
@@ -170,13 +188,21 @@ protected:
 
   bool                down_extension();
 
+  struct up_chunk_encryptor;
+
   bool                up_chunk();
-  inline uint32_t     up_chunk_encrypt(uint32_t quota);
+  bool                up_chunk_with_messages();
+  inline iovec*       up_chunk_vector(iovec* first, iovec* last, uint32_t length);
+  inline void         up_chunk_written(uint32_t bytes);
+  inline void         up_chunk_encrypt(iovec* vec, uint32_t quota);
+  inline void         up_chunk_encrypt_range(uint32_t offset, uint8_t* dest, uint32_t length);
+  inline uint32_t     up_chunk_sendfile(uint32_t offset, uint32_t& length);
 
   bool                up_extension();
 
   void                down_chunk_release();
   void                up_chunk_release();
+  void                up_block_release();
 
   bool                should_request();
   bool                try_request_pieces();
@@ -185,6 +211,7 @@ protected:
   bool                send_ext_message();
 
   DownloadMain*       m_download;
+  Poll*               m_poll;
 
   ProtocolRead*       m_down;
   ProtocolWrite*      m_up;
@@ -197,6 +224,9 @@ protected:
 
   Piece               m_upPiece;
   ChunkHandle         m_upChunk;
+  BlockCacheEntry*    m_upBlock;
+  bool                m_upSendfile;
+  File*               m_upFile;
 
   // The interested state no longer follows the spec's wording as it
   // has been swapped.
@@ -257,7 +287,7 @@ PeerConnectionBase::read_insert_poll_safe() {
   if (m_down->get_state() != ProtocolRead::IDLE)
     return;
 
-  manager->poll()->insert_read(this);
+  m_poll->insert_read(this);
 }
 
 inline void
@@ -265,7 +295,7 @@ PeerConnectionBase::write_insert_poll_safe() {
   if (m_up->get_state() != ProtocolWrite::IDLE)
     return;
 
-  manager->poll()->insert_write(this);
+  m_poll->insert_write(this);
 }
 
 }
@@ -581,21 +581,33 @@ PeerConnection<type>::event_write() {
         fill_write_buffer();
 
         if (m_up->buffer()->remaining() == 0) {
-          manager->poll()->remove_write(this);
+          m_poll->remove_write(this);
           return;
         }
 
         m_up->set_state(ProtocolWrite::MSG);
 
       case ProtocolWrite::MSG:
-        if (!m_up->buffer()->consume(m_up->throttle()->node_used_unthrottled(write_stream_throws(m_up->buffer()->position(), m_up->buffer()->remaining()))))
+        if (m_up->last_command() == ProtocolBase::PIECE && !m_upSendfile &&
+            m_up->throttle()->is_throttled(m_peerChunks.upload_throttle())) {
+          // The piece was loaded when its header was queued, so send
+          // both using a single writev.
+          if (!up_chunk_with_messages())
+            return;
+
+        } else if (!m_up->buffer()->consume(m_up->throttle()->node_used_unthrottled(write_stream_throws(m_up->buffer()->position(), m_up->buffer()->remaining())))) {
           return;
+        }
 
         m_up->buffer()->reset();
 
         if (m_up->last_command() == ProtocolBase::PIECE) {
           // We're uploading a piece.
-          load_up_chunk();
+          if (m_upPiece.length() == 0) {
+            m_up->set_state(ProtocolWrite::IDLE);
+            break;
+          }
+
           m_up->set_state(ProtocolWrite::WRITE_PIECE);
 
           // fall through to WRITE_PIECE case below
@@ -337,7 +337,7 @@ PeerConnectionMetadata::event_write() {
         fill_write_buffer();
 
         if (m_up->buffer()->remaining() == 0) {
-          manager->poll()->remove_write(this);
+          m_poll->remove_write(this);
           return;
         }
 
@@ -420,7 +420,8 @@ PeerConnectionMetadata::try_request_metadata_pieces() {
   if (download_queue()->queued_empty())
     m_downStall = 0;
 
-  uint32_t pipeSize = download_queue()->calculate_pipe_size(m_peerChunks.download_throttle()->rate()->rate());
+  uint32_t pipeSize = download_queue()->calculate_pipe_size(m_peerChunks.download_throttle()->rate()->rate(),
+                                                            m_extensions->max_queue_length());
 
   // Don't start requesting if we can't do it in large enough chunks.
   if (download_queue()->queued_size() >= (pipeSize + 10) / 2)
@@ -36,12 +36,33 @@
 
 #include "config.h"
 
+#include <algorithm>
+
+#include "torrent/object_pool.h"
+
 #include "peer_factory.h"
 #include "peer_connection_leech.h"
 #include "peer_connection_metadata.h"
 
 namespace torrent {
 
+static ObjectPool& peer_connection_pool = *new ObjectPool("peer_connection",
+                                                           std::max(std::max(sizeof(PeerConnection<Download::CONNECTION_LEECH>),
+                                                                             sizeof(PeerConnection<Download::CONNECTION_SEED>)),
+                                                                    std::max(sizeof(PeerConnection<Download::CONNECTION_INITIAL_SEED>),
+                                                                             sizeof(PeerConnectionMetadata))),
+                                                           1024);
+
+void*
+PeerConnectionBase::operator new(size_t size) {
+  return peer_connection_pool.allocate(size);
+}
+
+void
+PeerConnectionBase::operator delete(void* ptr) {
+  peer_connection_pool.deallocate(ptr);
+}
+
 PeerConnectionBase*
 createPeerConnectionDefault(bool encrypted) {
   PeerConnectionBase* pc = new PeerConnection<Download::CONNECTION_LEECH>;
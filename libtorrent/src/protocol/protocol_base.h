@@ -89,6 +89,10 @@ public:
     m_buffer.reset();
   }
 
+  // Allocated from an ObjectPool, two for each peer connection.
+  static void*        operator new(size_t size);
+  static void         operator delete(void* ptr);
+
   Protocol            last_command() const                    { return m_lastCommand; }
   void                set_last_command(Protocol p)            { m_lastCommand = p; }
 
@@ -44,8 +44,13 @@
 #include "torrent/data/block.h"
 #include "torrent/data/block_list.h"
 #include "torrent/exceptions.h"
+#include "torrent/connection_manager.h"
+#include "torrent/rate.h"
 #include "download/delegator.h"
+#include "net/throttle_node.h"
 
+#include "globals.h"
+#include "manager.h"
 #include "peer_chunks.h"
 #include "request_list.h"
 
@@ -69,6 +74,24 @@ RequestList::delegate() {
   BlockTransfer* r = m_delegator->delegate(m_peerChunks, m_affinity);
 
   if (r) {
+    // Note when the piece would start arriving if the peer answers
+    // immediately, which needs the rate once there are requests
+    // ahead of it.
+    uint32_t ahead = outstanding_bytes();
+    uint32_t rate = m_peerChunks->download_throttle()->rate()->rate();
+
+    if (ahead == 0)
+      r->set_request_time(cachedTime.usec());
+    else if (rate != 0)
+      r->set_request_time(cachedTime.usec() + (int64_t)ahead * 1000000 / rate);
+    else
+      r->set_request_time(0);
+
+    if (rate != 0 && r->request_time() != 0)
+      r->set_expected_time(r->request_time() + (int64_t)r->piece().length() * 1000000 / rate);
+    else
+      r->set_expected_time(0);
+
     m_affinity = r->index();
     m_queued.push_back(r);
 
@@ -136,6 +159,8 @@ RequestList::downloading(const Piece& piece) {
     m_transfer = *itr;
     cancel_range(itr);
     m_queued.pop_front();
+
+    update_rtt(m_transfer);
   }
   
   // We received an invalid piece length, propably zero length due to
@@ -156,7 +181,9 @@ RequestList::downloading(const Piece& piece) {
   if (!m_transfer->is_valid())
     return false;
 
-  m_transfer->block()->transfering(m_transfer);
+  if (m_transfer->block()->transfering(m_transfer))
+    m_delegator->cancel_duplicates(m_peerChunks, m_transfer);
+
   return true;
 
  downloading_error:
@@ -263,22 +290,64 @@ RequestList::cancel_range(ReserveeList::iterator end) {
 }
 
 uint32_t
-RequestList::calculate_pipe_size(uint32_t rate) {
+RequestList::outstanding_bytes() const {
+  uint32_t bytes = 0;
+
+  if (m_transfer != NULL)
+    bytes += m_transfer->piece().length() - m_transfer->position();
+
+  for (ReserveeList::const_iterator itr = m_queued.begin(), last = m_queued.end(); itr != last; ++itr)
+    bytes += (*itr)->piece().length();
+
+  return bytes;
+}
+
+void
+RequestList::update_rtt(const BlockTransfer* transfer) {
+  if (transfer->request_time() == 0 || cachedTime.usec() <= transfer->request_time())
+    return;
+
+  uint32_t sample = std::min<int64_t>(cachedTime.usec() - transfer->request_time(), 60 * 1000000);
+
+  // Pieces delayed by a stall or choke say nothing about the link, so
+  // don't let a single sample grow the estimate by more than 4 times.
+  if (m_rtt != 0)
+    sample = std::min<uint64_t>(sample, (uint64_t)m_rtt * 4);
+
+  if (m_rtt == 0)
+    m_rtt = sample;
+  else
+    m_rtt = ((uint64_t)m_rtt * 7 + sample) / 8;
+}
+
+uint32_t
+RequestList::calculate_pipe_size(uint32_t rate, uint32_t limit) {
   // Change into KB.
-  rate /= 1024;
+  uint32_t rateKB = rate / 1024;
+  uint32_t size;
 
   if (!m_delegator->get_aggressive()) {
-    if (rate < 20)
-      return rate + 2;
+    if (rateKB < 20)
+      size = rateKB + 2;
     else
-      return rate / 5 + 18;
+      size = rateKB / 5 + 18;
+
+    // Keep at least twice the bandwidth-delay product outstanding so
+    // high latency peers aren't limited by the pipe and the rate has
+    // room to grow.
+    if (m_rtt != 0)
+      size = std::max<uint64_t>(size, 2 * ((uint64_t)rate * m_rtt / 1000000) / Delegator::block_size + 2);
 
   } else {
-    if (rate < 10)
-      return rate / 5 + 1;
+    if (rateKB < 10)
+      size = rateKB / 5 + 1;
     else
-      return rate / 10 + 2;
+      size = rateKB / 10 + 2;
   }
+
+  ConnectionManager* cm = manager->connection_manager();
+
+  return std::min(std::min(std::max(size, cm->pipe_size_min()), cm->pipe_size_max()), limit);
 }
 
 }
@@ -54,7 +54,8 @@ public:
     m_delegator(NULL),
     m_peerChunks(NULL),
     m_transfer(NULL),
-    m_affinity(-1) {}
+    m_affinity(-1),
+    m_rtt(0) {}
 
   // Some parameters here, like how fast we are downloading and stuff
   // when we start considering those.
@@ -89,7 +90,13 @@ public:
   bool                 canceled_empty() const             { return m_canceled.empty(); }
   size_t               canceled_size() const              { return m_queued.size(); }
 
-  uint32_t             calculate_pipe_size(uint32_t rate);
+  // Never exceeds 'limit', the request queue length the peer accepts.
+  uint32_t             calculate_pipe_size(uint32_t rate, uint32_t limit);
+
+  // Smoothed round-trip time in microseconds, measured from sending
+  // a request to the piece starting to arrive less the time spent
+  // waiting behind earlier requests. Zero until the first sample.
+  uint32_t             rtt() const                        { return m_rtt; }
 
   void                 set_delegator(Delegator* d)       { m_delegator = d; }
   void                 set_peer_chunks(PeerChunks* b)    { m_peerChunks = b; }
@@ -102,6 +109,9 @@ public:
 private:
   void                 cancel_range(ReserveeList::iterator end);
 
+  uint32_t             outstanding_bytes() const;
+  void                 update_rtt(const BlockTransfer* transfer);
+
   Delegator*           m_delegator;
   PeerChunks*          m_peerChunks;
 
@@ -109,6 +119,7 @@ private:
 
   // Replace m_downloading with a pointer to BlockTransfer.
   int32_t              m_affinity;
+  uint32_t             m_rtt;
 
   ReserveeList         m_queued;
   ReserveeList         m_canceled;
@@ -37,6 +37,7 @@
 #include "config.h"
 
 #include <algorithm>
+#include <cstddef>
 
 #include "bitfield.h"
 #include "exceptions.h"
@@ -64,6 +65,119 @@ static const unsigned char bit_count_256[] =
   4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
 };
 
+// The bulk of the work is done a machine word at a time, the words
+// are only used for counting and testing against zero so the byte
+// order within them doesn't matter.
+typedef uint64_t word_type;
+
+static const Bitfield::size_type word_size = sizeof(word_type);
+
+static inline word_type
+load_word(const uint8_t* data) {
+  word_type w;
+  std::memcpy(&w, data, sizeof(word_type));
+  return w;
+}
+
+static inline Bitfield::size_type
+count_word(word_type w) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(w);
+#else
+  Bitfield::size_type count = 0;
+
+  for (; w != 0; w >>= 8)
+    count += bit_count_256[w & 0xff];
+
+  return count;
+#endif
+}
+
+static Bitfield::size_type
+count_bytes(const uint8_t* first, const uint8_t* last) {
+  Bitfield::size_type count = 0;
+
+  for (; last - first >= (ptrdiff_t)word_size; first += word_size)
+    count += count_word(load_word(first));
+
+  for (; first != last; ++first)
+    count += bit_count_256[*first];
+
+  return count;
+}
+
+// Position of the first set bit in a non-zero byte, counting from
+// the most significant bit.
+static inline Bitfield::size_type
+first_bit(uint8_t b) {
+#if defined(__GNUC__)
+  return __builtin_clz(b) - (sizeof(unsigned int) - 1) * 8;
+#else
+  Bitfield::size_type idx = 0;
+
+  while (!(b & Bitfield::mask_at(idx)))
+    idx++;
+
+  return idx;
+#endif
+}
+
+struct bitfield_bytes {
+  bitfield_bytes(const uint8_t* d) : m_data(d) {}
+
+  uint8_t   byte(Bitfield::size_type i) const { return m_data[i]; }
+  word_type word(Bitfield::size_type i) const { return load_word(m_data + i); }
+
+  const uint8_t* m_data;
+};
+
+struct bitfield_bytes_and_not {
+  bitfield_bytes_and_not(const uint8_t* d, const uint8_t* n) : m_data(d), m_not(n) {}
+
+  uint8_t   byte(Bitfield::size_type i) const { return m_data[i] & ~m_not[i]; }
+  word_type word(Bitfield::size_type i) const { return load_word(m_data + i) & ~load_word(m_not + i); }
+
+  const uint8_t* m_data;
+  const uint8_t* m_not;
+};
+
+template <typename Bytes>
+static Bitfield::size_type
+find_first(const Bytes& bytes, Bitfield::size_type first, Bitfield::size_type last) {
+  if (first >= last)
+    return last;
+
+  Bitfield::size_type idx = first / 8;
+  Bitfield::size_type lastIdx = last / 8;
+
+  uint8_t b = bytes.byte(idx) & Bitfield::mask_from(first % 8);
+
+  if (idx == lastIdx) {
+    b &= Bitfield::mask_before(last % 8);
+    return b != 0 ? idx * 8 + first_bit(b) : last;
+  }
+
+  if (b != 0)
+    return idx * 8 + first_bit(b);
+
+  ++idx;
+
+  while (idx + word_size <= lastIdx && bytes.word(idx) == 0)
+    idx += word_size;
+
+  while (idx < lastIdx && (b = bytes.byte(idx)) == 0)
+    ++idx;
+
+  if (idx < lastIdx)
+    return idx * 8 + first_bit(b);
+
+  if (last % 8 == 0)
+    return last;
+
+  b = bytes.byte(idx) & Bitfield::mask_before(last % 8);
+  return b != 0 ? idx * 8 + first_bit(b) : last;
+}
+
 void
 Bitfield::set_size_bits(size_type s) {
   if (m_data != NULL)
@@ -85,12 +199,7 @@ Bitfield::update() {
   // Clears the unused bits.
   clear_tail();
 
-  m_set = 0;
-
-  // Some archs have bitcounting instructions, look into writing a
-  // wrapper for those.
-  for (iterator itr = m_data, last = end(); itr != last; ++itr)
-    m_set += bit_count_256[*itr];
+  m_set = count_bytes(m_data, end());
 }
 
 void
@@ -130,18 +239,81 @@ Bitfield::unset_all() {
   std::memset(m_data, value_type(), size_bytes());
 }
 
-// Quick hack. Speed improvements would require that m_set is kept
-// up-to-date.
 void
 Bitfield::set_range(size_type first, size_type last) {
-  while (first != last)
-    set(first++);
+  if (first >= last)
+    return;
+
+  m_set += (last - first) - count_range(first, last);
+
+  iterator itr = m_data + first / 8;
+  iterator lastItr = m_data + last / 8;
+
+  if (itr == lastItr) {
+    *itr |= mask_from(first % 8) & mask_before(last % 8);
+    return;
+  }
+
+  *itr++ |= mask_from(first % 8);
+  std::memset(itr, ~value_type(), lastItr - itr);
+
+  if (last % 8)
+    *lastItr |= mask_before(last % 8);
 }
 
 void
 Bitfield::unset_range(size_type first, size_type last) {
-  while (first != last)
-    unset(first++);
+  if (first >= last)
+    return;
+
+  m_set -= count_range(first, last);
+
+  iterator itr = m_data + first / 8;
+  iterator lastItr = m_data + last / 8;
+
+  if (itr == lastItr) {
+    *itr &= ~(mask_from(first % 8) & mask_before(last % 8));
+    return;
+  }
+
+  *itr++ &= ~mask_from(first % 8);
+  std::memset(itr, value_type(), lastItr - itr);
+
+  if (last % 8)
+    *lastItr &= ~mask_before(last % 8);
+}
+
+Bitfield::size_type
+Bitfield::count_range(size_type first, size_type last) const {
+  if (first >= last)
+    return 0;
+
+  const_iterator itr = m_data + first / 8;
+  const_iterator lastItr = m_data + last / 8;
+
+  if (itr == lastItr)
+    return bit_count_256[*itr & mask_from(first % 8) & mask_before(last % 8)];
+
+  size_type count = bit_count_256[*itr & mask_from(first % 8)];
+  count += count_bytes(itr + 1, lastItr);
+
+  if (last % 8)
+    count += bit_count_256[*lastItr & mask_before(last % 8)];
+
+  return count;
+}
+
+Bitfield::size_type
+Bitfield::find_first_set(size_type first, size_type last) const {
+  return find_first(bitfield_bytes(m_data), first, last);
+}
+
+Bitfield::size_type
+Bitfield::find_first_and_not(const Bitfield& bf, size_type first, size_type last) const {
+  if (bf.m_size != m_size)
+    throw internal_error("Bitfield::find_first_and_not(...) size mismatch.");
+
+  return find_first(bitfield_bytes_and_not(m_data, bf.m_data), first, last);
 }
 
 }
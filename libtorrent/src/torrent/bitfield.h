@@ -90,6 +90,15 @@ public:
   void                unset_all();
   void                unset_range(size_type first, size_type last);
 
+  // Number of set bits in [first, last).
+  size_type           count_range(size_type first, size_type last) const;
+
+  // Returns the first set bit in [first, last), or 'last' if there
+  // is none. The 'and_not' version looks for a bit that is set here
+  // but not in 'bf', e.g. a chunk the peer has that we lack.
+  size_type           find_first_set(size_type first, size_type last) const;
+  size_type           find_first_and_not(const Bitfield& bf, size_type first, size_type last) const;
+
   bool                get(size_type idx) const      { return m_data[idx / 8] & mask_at(idx % 8); }
 
   void                set(size_type idx)            { m_set += !get(idx); m_data[idx / 8] |=  mask_at(idx % 8); }
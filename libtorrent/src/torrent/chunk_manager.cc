@@ -40,7 +40,9 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 
+#include "data/block_cache.h"
 #include "data/chunk_list.h"
+#include "data/memory_chunk.h"
 #include "utils/log_files.h"
 
 #include "exceptions.h"
@@ -53,6 +55,11 @@ ChunkManager::ChunkManager() :
   m_memoryUsage(0),
   m_memoryBlockCount(0),
 
+  m_storageType(storage_mmap),
+  m_useWriteBack(false),
+
+  m_blockCache(new BlockCache),
+
   m_safeSync(false),
   m_timeoutSync(600),
   m_timeoutSafeSync(900),
@@ -76,6 +83,56 @@ ChunkManager::ChunkManager() :
 ChunkManager::~ChunkManager() {
   if (m_memoryUsage != 0 || m_memoryBlockCount != 0)
     throw internal_error("ChunkManager::~ChunkManager() m_memoryUsage != 0 || m_memoryBlockCount != 0.");
+
+  delete m_blockCache;
+}
+
+uint64_t
+ChunkManager::block_cache_memory_usage() const {
+  return m_blockCache->memory_usage();
+}
+
+uint64_t
+ChunkManager::block_cache_max_memory_usage() const {
+  return m_blockCache->max_memory_usage();
+}
+
+void
+ChunkManager::set_block_cache_max_memory_usage(uint64_t bytes) {
+  m_blockCache->set_max_memory_usage(bytes);
+}
+
+uint64_t
+ChunkManager::block_cache_hits() const {
+  return m_blockCache->stats_hits();
+}
+
+uint64_t
+ChunkManager::block_cache_misses() const {
+  return m_blockCache->stats_misses();
+}
+
+void
+ChunkManager::set_storage_type(uint32_t t) {
+  if (t != storage_mmap && t != storage_buffer)
+    throw input_error("Invalid storage type.");
+
+  m_storageType = t;
+}
+
+uint64_t
+ChunkManager::buffer_pool_size() const {
+  return MemoryChunk::buffer_pool_size();
+}
+
+uint64_t
+ChunkManager::buffer_pool_max_size() const {
+  return MemoryChunk::buffer_pool_max_size();
+}
+
+void
+ChunkManager::set_buffer_pool_max_size(uint64_t bytes) {
+  MemoryChunk::set_buffer_pool_max_size(bytes);
 }
 
 uint64_t
@@ -77,6 +77,38 @@ public:
 
   uint64_t            safe_free_diskspace() const;
 
+  // Cache of blocks read for uploading, budgeted separately from the
+  // memory used for chunks. A max of zero disables the cache.
+  BlockCache*         block_cache()                             { return m_blockCache; }
+
+  uint64_t            block_cache_memory_usage() const;
+  uint64_t            block_cache_max_memory_usage() const;
+  void                set_block_cache_max_memory_usage(uint64_t bytes);
+
+  uint64_t            block_cache_hits() const;
+  uint64_t            block_cache_misses() const;
+
+  // Select how new chunks are backed; 'storage_mmap' maps the files
+  // while 'storage_buffer' reads chunks into pooled buffers with
+  // pread and writes them back with pwrite when synced. Changing the
+  // type only affects chunks created afterwards.
+  static const uint32_t storage_mmap   = 0;
+  static const uint32_t storage_buffer = 1;
+
+  uint32_t            storage_type() const                      { return m_storageType; }
+  void                set_storage_type(uint32_t t);
+
+  // Bytes of released storage buffers kept for reuse.
+  uint64_t            buffer_pool_size() const;
+  uint64_t            buffer_pool_max_size() const;
+  void                set_buffer_pool_max_size(uint64_t bytes);
+
+  // Download into buffers regardless of the storage type, writing
+  // each chunk back once it is complete instead of leaving dirty
+  // pages to be synced.
+  bool                use_write_back() const                    { return m_useWriteBack; }
+  void                set_use_write_back(bool state)            { m_useWriteBack = state; }
+
   bool                safe_sync() const                         { return m_safeSync; }
   void                set_safe_sync(uint32_t state)             { m_safeSync = state; }
 
@@ -149,6 +181,11 @@ private:
 
   uint32_t            m_memoryBlockCount;
 
+  uint32_t            m_storageType;
+  bool                m_useWriteBack;
+
+  BlockCache*         m_blockCache;
+
   bool                m_safeSync;
   uint32_t            m_timeoutSync;
   uint32_t            m_timeoutSafeSync;
@@ -57,6 +57,8 @@ typedef priority_enum priority_t;
 class AvailableList;
 class Bitfield;
 class Block;
+class BlockCache;
+class BlockCacheEntry;
 class BlockFailed;
 class BlockList;
 class BlockTransfer;
@@ -74,6 +74,9 @@ ConnectionManager::ConnectionManager() :
   m_sendBufferSize(0),
   m_receiveBufferSize(0),
   m_encryptionOptions(encryption_none),
+  m_useSendfile(false),
+  m_pipeSizeMin(1),
+  m_pipeSizeMax(256),
 
   m_listen(new Listen),
   m_listenPort(0),
@@ -121,6 +124,32 @@ ConnectionManager::set_encryption_options(uint32_t options) {
 #endif
 }
 
+void
+ConnectionManager::set_use_sendfile(bool state) {
+#ifdef USE_SENDFILE
+  m_useSendfile = state;
+#else
+  if (state)
+    throw input_error("Compiled without sendfile support.");
+#endif
+}
+
+void
+ConnectionManager::set_pipe_size_min(uint32_t s) {
+  if (s == 0 || s > m_pipeSizeMax)
+    throw input_error("Minimum pipe size must be between 1 and the maximum pipe size.");
+
+  m_pipeSizeMin = s;
+}
+
+void
+ConnectionManager::set_pipe_size_max(uint32_t s) {
+  if (s < m_pipeSizeMin || s > (1 << 16))
+    throw input_error("Maximum pipe size must be between the minimum pipe size and 65536.");
+
+  m_pipeSizeMax = s;
+}
+
 void
 ConnectionManager::set_bind_address(const sockaddr* sa) {
   const rak::socket_address* rsa = rak::socket_address::cast_from(sa);
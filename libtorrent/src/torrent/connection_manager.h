@@ -130,11 +130,24 @@ public:
   uint32_t            receive_buffer_size() const             { return m_receiveBufferSize; }
   uint32_t            encryption_options()                    { return m_encryptionOptions; }
 
+  // Upload unencrypted piece data with sendfile from the file
+  // descriptor rather than through the mapped chunk.
+  bool                use_sendfile() const                    { return m_useSendfile; }
+
+  // Bounds on the number of outstanding block requests per peer. The
+  // depth is otherwise chosen from the peer's rate and round-trip
+  // time.
+  uint32_t            pipe_size_min() const                   { return m_pipeSizeMin; }
+  uint32_t            pipe_size_max() const                   { return m_pipeSizeMax; }
+
   void                set_max_size(size_type s)               { m_maxSize = s; }
   void                set_priority(priority_type p)           { m_priority = p; }
   void                set_send_buffer_size(uint32_t s);
   void                set_receive_buffer_size(uint32_t s);
   void                set_encryption_options(uint32_t options); 
+  void                set_use_sendfile(bool state);
+  void                set_pipe_size_min(uint32_t s);
+  void                set_pipe_size_max(uint32_t s);
 
   // Setting the addresses creates a copy of the address.
   const sockaddr*     bind_address() const                    { return m_bindAddress; }
@@ -187,6 +200,9 @@ private:
   uint32_t            m_sendBufferSize;
   uint32_t            m_receiveBufferSize;
   int                 m_encryptionOptions;
+  bool                m_useSendfile;
+  uint32_t            m_pipeSizeMin;
+  uint32_t            m_pipeSizeMax;
 
   sockaddr*           m_bindAddress;
   sockaddr*           m_localAddress;
@@ -48,9 +48,22 @@
 #include "block_list.h"
 #include "block_transfer.h"
 #include "exceptions.h"
+#include "object_pool.h"
 
 namespace torrent {
 
+static ObjectPool& block_transfer_pool = *new ObjectPool("block_transfer", sizeof(BlockTransfer), 4096);
+
+void*
+BlockTransfer::operator new(size_t size) {
+  return block_transfer_pool.allocate(size);
+}
+
+void
+BlockTransfer::operator delete(void* ptr) {
+  block_transfer_pool.deallocate(ptr);
+}
+
 Block::~Block() {
   m_leader = NULL;
 
@@ -248,6 +261,17 @@ Block::transfer_dissimilar(BlockTransfer* transfer) {
   transfer->set_block(NULL);
 }
 
+void
+Block::cancel_queued(BlockTransfer* transfer) {
+  transfer_list_type::iterator itr = std::find(m_queued.begin(), m_queued.end(), transfer);
+
+  if (itr == m_queued.end())
+    throw internal_error("Block::cancel_queued(...) transfer not queued.");
+
+  m_queued.erase(itr);
+  invalidate_transfer(transfer);
+}
+
 void
 Block::stalled_transfer(BlockTransfer* transfer) {
   if (transfer->stall() == 0) {
@@ -104,6 +104,10 @@ public:
 
   void                      transfer_dissimilar(BlockTransfer* transfer);
 
+  // Removes a queued transfer and sends a cancel to its peer, the
+  // invalidated transfer is released by the peer's RequestList.
+  void                      cancel_queued(BlockTransfer* transfer);
+
   static void               stalled(BlockTransfer* transfer)             { if (!transfer->is_valid()) return; transfer->block()->stalled_transfer(transfer); }
   void                      stalled_transfer(BlockTransfer* transfer);
 
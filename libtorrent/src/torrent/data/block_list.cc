@@ -39,6 +39,9 @@
 #include <algorithm>
 #include <functional>
 
+#include "data/chunk.h"
+#include "utils/sha1.h"
+
 #include "block_transfer.h"
 #include "block_list.h"
 #include "exceptions.h"
@@ -53,7 +56,10 @@ BlockList::BlockList(const Piece& piece, uint32_t blockLength) :
   m_failed(0),
   m_attempt(0),
 
-  m_bySeeder(false) {
+  m_bySeeder(false),
+
+  m_hash(NULL),
+  m_hashPosition(0) {
 
   if (piece.length() == 0)
     throw internal_error("BlockList::BlockList(...) received zero length piece.");
@@ -75,6 +81,46 @@ BlockList::BlockList(const Piece& piece, uint32_t blockLength) :
 }
 
 BlockList::~BlockList() {
+  delete m_hash;
+}
+
+void
+BlockList::hash_finished_blocks(Chunk* chunk) {
+  if (m_hashPosition == m_piece.length())
+    return;
+
+  for (iterator itr = begin() + m_hashPosition / base_type::front().piece().length(); itr != end() && itr->is_finished(); ++itr) {
+    if (itr->piece().offset() != m_hashPosition)
+      throw internal_error("BlockList::hash_finished_blocks(...) block offset does not match the hash position.");
+
+    if (m_hash == NULL) {
+      m_hash = new Sha1;
+      m_hash->init();
+    }
+
+    uint32_t position = itr->piece().offset();
+    uint32_t length = itr->piece().length();
+
+    while (length != 0) {
+      Chunk::iterator part = chunk->at_position(position);
+      uint32_t l = std::min(length, part->size() - (position - part->position()));
+
+      m_hash->update(part->chunk().begin() + position - part->position(), l);
+
+      position += l;
+      length   -= l;
+    }
+
+    m_hashPosition += itr->piece().length();
+  }
+}
+
+void
+BlockList::hash_clear() {
+  delete m_hash;
+
+  m_hash = NULL;
+  m_hashPosition = 0;
 }
 
 }
@@ -44,6 +44,8 @@
 
 namespace torrent {
 
+class Sha1;
+
 class LIBTORRENT_EXPORT BlockList : public std::vector<Block> {
 public:
   typedef std::vector<Block> base_type;
@@ -96,6 +98,16 @@ public:
   bool                by_seeder() const             { return m_bySeeder; }
   void                set_by_seeder(bool state)     { m_bySeeder = state; }
 
+  // Blocks finished in order are fed into a running hash so the
+  // digest is ready when the last block arrives. Blocks finished out
+  // of order are caught up once the gap before them is filled.
+  uint32_t            hash_position() const         { return m_hashPosition; }
+  bool                is_hash_complete() const      { return m_hash != NULL && m_hashPosition == m_piece.length(); }
+  const Sha1*         hash_state() const            { return m_hash; }
+
+  void                hash_finished_blocks(Chunk* chunk) LIBTORRENT_NO_EXPORT;
+  void                hash_clear() LIBTORRENT_NO_EXPORT;
+
 private:
   BlockList(const BlockList&);
   void operator = (const BlockList&);
@@ -108,6 +120,9 @@ private:
   uint32_t            m_attempt;
 
   bool                m_bySeeder;
+
+  Sha1*               m_hash;
+  uint32_t            m_hashPosition;
 };
 
 }
@@ -55,7 +55,11 @@ public:
     STATE_NOT_LEADER
   } state_type;
 
-  BlockTransfer() {}
+  BlockTransfer() : m_requestTime(0), m_expectedTime(0) {}
+
+  // Allocated from an ObjectPool.
+  static void*        operator new(size_t size);
+  static void         operator delete(void* ptr);
 
   bool                is_valid() const              { return m_block != NULL; }
 
@@ -82,6 +86,14 @@ public:
   uint32_t            stall() const                 { return m_stall; }
   uint32_t            failed_index() const          { return m_failedIndex; }
 
+  // Time in microseconds the piece is expected to start arriving if
+  // the peer answers immediately, or zero if unknown.
+  int64_t             request_time() const          { return m_requestTime; }
+
+  // Time in microseconds the piece is expected to have arrived at the
+  // peer's current rate, or zero if unknown.
+  int64_t             expected_time() const         { return m_expectedTime; }
+
   void                set_peer_info(key_type p)     { m_peerInfo = p; }
   void                set_block(Block* b)           { m_block = b; }
   void                set_piece(const Piece& p)     { m_piece = p; }
@@ -92,6 +104,8 @@ public:
 
   void                set_stall(uint32_t s)         { m_stall = s; }
   void                set_failed_index(uint32_t i)  { m_failedIndex = i; }
+  void                set_request_time(int64_t t)   { m_requestTime = t; }
+  void                set_expected_time(int64_t t)  { m_expectedTime = t; }
 
 private:
   BlockTransfer(const BlockTransfer&);
@@ -106,6 +120,9 @@ private:
   uint32_t            m_position;
   uint32_t            m_stall;
   uint32_t            m_failedIndex;
+
+  int64_t             m_requestTime;
+  int64_t             m_expectedTime;
 };
 
 }
@@ -39,6 +39,7 @@
 #include <rak/error_number.h>
 #include <rak/file_stat.h>
 
+#include "data/disk_engine.h"
 #include "data/memory_chunk.h"
 #include "data/socket_file.h"
 #include "torrent/exceptions.h"
@@ -176,6 +177,17 @@ File::resize_file() {
   if (m_flags & flag_fallocate)
     flags |= SocketFile::flag_fallocate_blocking;
 
+  // Let the disk engine do the allocation, the file only needs to
+  // have the right size before it can be used. If the engine can't
+  // allocate or queue the request, do it synchronously.
+  if ((m_flags & flag_fallocate) && manager->disk_engine()->can_fallocate()) {
+    if (!SocketFile(m_fd).set_size(m_size))
+      return false;
+
+    if (manager->disk_engine()->fallocate(m_fd, 0, m_size))
+      return true;
+  }
+
   return SocketFile(m_fd).set_size(m_size, flags);
 }
 
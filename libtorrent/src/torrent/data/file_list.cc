@@ -51,6 +51,7 @@
 #include "data/memory_chunk.h"
 #include "data/socket_file.h"
 
+#include "torrent/chunk_manager.h"
 #include "torrent/exceptions.h"
 #include "torrent/path.h"
 
@@ -560,6 +561,13 @@ FileList::open_file(File* node, const Path& lastPath, int flags) {
   return node->prepare(MemoryChunk::prot_read, 0);
 }
 
+inline bool
+FileList::is_chunk_buffered(int prot) const {
+  return
+    manager->chunk_manager()->storage_type() == ChunkManager::storage_buffer ||
+    ((prot & MemoryChunk::prot_write) && manager->chunk_manager()->use_write_back());
+}
+
 MemoryChunk
 FileList::create_chunk_part(FileList::iterator itr, uint64_t offset, uint32_t length, int prot) {
   offset -= (*itr)->offset();
@@ -573,6 +581,9 @@ FileList::create_chunk_part(FileList::iterator itr, uint64_t offset, uint32_t le
   if (!(*itr)->prepare(prot))
     return MemoryChunk();
 
+  if (is_chunk_buffered(prot))
+    return SocketFile((*itr)->file_descriptor()).create_buffer(offset, length, prot);
+
   return SocketFile((*itr)->file_descriptor()).create_chunk(offset, length, prot, MemoryChunk::map_shared);
 }
 
@@ -582,6 +593,7 @@ FileList::create_chunk(uint64_t offset, uint32_t length, int prot) {
     throw internal_error("Tried to access chunk out of range in FileList");
 
   std::auto_ptr<Chunk> chunk(new Chunk);
+  bool buffered = is_chunk_buffered(prot);
 
   for (iterator itr = std::find_if(begin(), end(), std::bind2nd(std::mem_fun(&File::is_valid_position), offset)); length != 0; ++itr) {
 
@@ -602,7 +614,7 @@ FileList::create_chunk(uint64_t offset, uint32_t length, int prot) {
     if (mc.size() > length)
       throw internal_error("FileList::create_chunk(...) mc.size() > length.");
 
-    chunk->push_back(ChunkPart::MAPPED_MMAP, mc);
+    chunk->push_back(buffered ? ChunkPart::MAPPED_BUFFER : ChunkPart::MAPPED_MMAP, mc, *itr, offset - (*itr)->offset());
 
     offset += mc.size();
     length -= mc.size();
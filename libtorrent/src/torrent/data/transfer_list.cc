@@ -61,7 +61,11 @@ TransferList::TransferList() :
   m_slotQueued(slot_queued_type(slot_queued_op(NULL), NULL)),
   m_slotCorrupt(slot_corrupt_type(slot_corrupt_op(NULL), NULL)),
   m_succeededCount(0),
-  m_failedCount(0) { }
+  m_failedCount(0),
+  m_duplicatedCount(0),
+  m_wastedBytes(0),
+  m_dissimilarBytes(0),
+  m_cancelledCount(0) { }
 
 TransferList::iterator
 TransferList::find(uint32_t index) {
@@ -174,6 +178,10 @@ TransferList::hash_failed(uint32_t index, Chunk* chunk) {
 
   m_failedCount++;
 
+  // The chunk data may be replaced below, so any incremental hash
+  // state is no longer valid.
+  (*blockListItr)->hash_clear();
+
   // Could propably also check promoted against size of the block
   // list.
 
@@ -74,6 +74,19 @@ public:
   uint32_t            succeeded_count() const { return m_succeededCount; }
   uint32_t            failed_count() const { return m_failedCount; }
 
+  // Duplicate requests made for blocks predicted to be late, and the
+  // bytes received that we already had from another peer.
+  uint32_t            duplicated_count() const { return m_duplicatedCount; }
+  uint64_t            wasted_bytes() const     { return m_wastedBytes; }
+
+  // Duplicate requests cancelled before they started arriving,
+  // because another peer's transfer of the block got ahead.
+  uint32_t            cancelled_count() const  { return m_cancelledCount; }
+
+  // Bytes received for a block that didn't match the data another
+  // peer sent for it.
+  uint64_t            dissimilar_bytes() const { return m_dissimilarBytes; }
+
   //
   // Internal to libTorrent:
   //
@@ -85,6 +98,11 @@ public:
 
   void                finished(BlockTransfer* transfer);
 
+  void                inc_duplicated()                { m_duplicatedCount++; }
+  void                inc_cancelled()                 { m_cancelledCount++; }
+  void                add_wasted(uint32_t bytes)      { m_wastedBytes += bytes; }
+  void                add_dissimilar(uint32_t bytes)  { m_dissimilarBytes += bytes; }
+
   void                hash_succeeded(uint32_t index, Chunk* chunk);
   void                hash_failed(uint32_t index, Chunk* chunk);
 
@@ -124,6 +142,11 @@ private:
 
   uint32_t            m_succeededCount;
   uint32_t            m_failedCount;
+
+  uint32_t            m_duplicatedCount;
+  uint64_t            m_wastedBytes;
+  uint64_t            m_dissimilarBytes;
+  uint32_t            m_cancelledCount;
 };
 
 }
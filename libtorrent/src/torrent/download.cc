@@ -409,6 +409,25 @@ Download::set_uploads_max(uint32_t v) {
   m_ptr->main()->upload_choke_manager()->balance();
 }
 
+uint64_t
+Download::stream_position() const {
+  return m_ptr->main()->chunk_selector()->stream_position();
+}
+
+uint32_t
+Download::stream_rate() const {
+  return m_ptr->main()->chunk_selector()->stream_rate();
+}
+
+void
+Download::set_stream(uint64_t position, uint32_t rate) {
+  if (rate != 0 && position >= m_ptr->main()->file_list()->size_bytes())
+    throw input_error("Stream position is beyond the end of the torrent.");
+
+  m_ptr->main()->chunk_selector()->set_stream(position, rate, m_ptr->main()->file_list()->chunk_size());
+  m_ptr->main()->delegator()->set_streaming(rate != 0);
+}
+
 Download::ConnectionType
 Download::connection_type() const {
   return (ConnectionType)m_ptr->connection_type();
@@ -152,6 +152,16 @@ public:
   
   void                set_uploads_max(uint32_t v);
 
+  // Streaming mode requests chunks in the order a playback position,
+  // starting at byte 'position' and advancing 'rate' bytes per
+  // second, reaches them. Chunks due soon are given to the fastest
+  // peers and late blocks are requested from several peers. A zero
+  // rate disables streaming.
+  uint64_t            stream_position() const;
+  uint32_t            stream_rate() const;
+
+  void                set_stream(uint64_t position, uint32_t rate);
+
   void                set_upload_throttle(Throttle* t);
   void                set_download_throttle(Throttle* t);
 
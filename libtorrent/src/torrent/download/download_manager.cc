@@ -36,8 +36,15 @@
 
 #include "config.h"
 
+#include <cstring>
 #include <rak/functional.h>
 
+#if HAVE_TR1
+#include <tr1/unordered_map>
+#else
+#include <map>
+#endif
+
 #include "torrent/exceptions.h"
 
 #include "download/download_wrapper.h"
@@ -45,27 +52,77 @@
 
 namespace torrent {
 
+#if HAVE_TR1
+// Info hashes are uniformly distributed, so any aligned word of the
+// hash is a good hash value.
+struct download_manager_hash : public std::unary_function<HashString, size_t> {
+  size_t operator () (const HashString& n) const {
+    size_t result;
+    std::memcpy(&result, n.data() + 8, sizeof(size_t));
+    return result;
+  }
+};
+
+// The indexes map to the position of the download, so find(...)
+// can return an iterator without scanning.
+class DownloadManager::hash_index : public std::tr1::unordered_map<HashString, DownloadManager::size_type, download_manager_hash> {
+};
+#else
+class DownloadManager::hash_index : public std::map<HashString, DownloadManager::size_type> {
+};
+#endif
+
+DownloadManager::DownloadManager() :
+  m_hashIndex(new hash_index),
+  m_obfuscatedIndex(new hash_index) {
+}
+
+DownloadManager::~DownloadManager() {
+  clear();
+
+  delete m_hashIndex;
+  delete m_obfuscatedIndex;
+}
+
 DownloadManager::iterator
 DownloadManager::insert(DownloadWrapper* d) {
-  if (find(d->info()->hash()) != end())
+  if (!m_hashIndex->insert(hash_index::value_type(d->info()->hash(), size())).second)
     throw internal_error("Could not add torrent as it already exists.");
 
+  (*m_obfuscatedIndex)[d->info()->hash_obfuscated()] = size();
+
   return base_type::insert(end(), d);
 }
 
 DownloadManager::iterator
 DownloadManager::erase(DownloadWrapper* d) {
-  iterator itr = std::find(begin(), end(), d);
+  hash_index::iterator hashItr = m_hashIndex->find(d->info()->hash());
 
-  if (itr == end())
+  if (hashItr == m_hashIndex->end() || base_type::operator[](hashItr->second) != d)
     throw internal_error("Tried to remove a torrent that doesn't exist");
     
-  delete *itr;
-  return base_type::erase(itr);
+  size_type pos = hashItr->second;
+
+  m_hashIndex->erase(hashItr);
+  m_obfuscatedIndex->erase(d->info()->hash_obfuscated());
+
+  delete d;
+  iterator itr = base_type::erase(begin() + pos);
+
+  // Downloads after the erased one moved down a position.
+  for (size_type i = pos; i != size(); ++i) {
+    (*m_hashIndex)[base_type::operator[](i)->info()->hash()] = i;
+    (*m_obfuscatedIndex)[base_type::operator[](i)->info()->hash_obfuscated()] = i;
+  }
+
+  return itr;
 }
 
 void
 DownloadManager::clear() {
+  m_hashIndex->clear();
+  m_obfuscatedIndex->clear();
+
   while (!empty()) {
     delete base_type::back();
     base_type::pop_back();
@@ -74,13 +131,17 @@ DownloadManager::clear() {
 
 DownloadManager::iterator
 DownloadManager::find(const std::string& hash) {
-  return std::find_if(begin(), end(), rak::equal(*HashString::cast_from(hash),
-                                                 rak::on(std::mem_fun(&DownloadWrapper::info), std::mem_fun(&DownloadInfo::hash))));
+  return find(*HashString::cast_from(hash));
 }
 
 DownloadManager::iterator
 DownloadManager::find(const HashString& hash) {
-  return std::find_if(begin(), end(), rak::equal(hash, rak::on(std::mem_fun(&DownloadWrapper::info), std::mem_fun(&DownloadInfo::hash))));
+  hash_index::iterator itr = m_hashIndex->find(hash);
+
+  if (itr == m_hashIndex->end())
+    return end();
+
+  return begin() + itr->second;
 }
 
 DownloadManager::iterator
@@ -90,24 +151,22 @@ DownloadManager::find(DownloadInfo* info) {
 
 DownloadMain*
 DownloadManager::find_main(const char* hash) {
-  iterator itr = std::find_if(begin(), end(), rak::equal(*HashString::cast_from(hash),
-                                                         rak::on(std::mem_fun(&DownloadWrapper::info), std::mem_fun(&DownloadInfo::hash))));
+  hash_index::iterator itr = m_hashIndex->find(*HashString::cast_from(hash));
 
-  if (itr == end())
+  if (itr == m_hashIndex->end())
     return NULL;
   else
-    return (*itr)->main();
+    return base_type::operator[](itr->second)->main();
 }
 
 DownloadMain*
 DownloadManager::find_main_obfuscated(const char* hash) {
-  iterator itr = std::find_if(begin(), end(), rak::equal(*HashString::cast_from(hash),
-                                                         rak::on(std::mem_fun(&DownloadWrapper::info), std::mem_fun(&DownloadInfo::hash_obfuscated))));
+  hash_index::iterator itr = m_obfuscatedIndex->find(*HashString::cast_from(hash));
 
-  if (itr == end())
+  if (itr == m_obfuscatedIndex->end())
     return NULL;
   else
-    return (*itr)->main();
+    return base_type::operator[](itr->second)->main();
 }
 
 }
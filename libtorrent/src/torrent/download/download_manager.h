@@ -70,7 +70,8 @@ public:
   using base_type::rbegin;
   using base_type::rend;
 
-  ~DownloadManager() { clear(); }
+  DownloadManager();
+  ~DownloadManager();
 
   iterator            find(const std::string& hash);
   iterator            find(const HashString& hash);
@@ -87,6 +88,17 @@ public:
   iterator            erase(DownloadWrapper* d) LIBTORRENT_NO_EXPORT;
 
   void                clear() LIBTORRENT_NO_EXPORT;
+
+private:
+  DownloadManager(const DownloadManager&);
+  void operator = (const DownloadManager&);
+
+  // Indexes on the info hash and the obfuscated info hash, so that
+  // incoming handshakes don't need to scan all downloads.
+  class hash_index;
+
+  hash_index*         m_hashIndex;
+  hash_index*         m_obfuscatedIndex;
 };
 
 }
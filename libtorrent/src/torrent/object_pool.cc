@@ -0,0 +1,131 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#include "config.h"
+
+#include <algorithm>
+#include <new>
+
+#include "exceptions.h"
+#include "object_pool.h"
+
+namespace torrent {
+
+static ObjectPool::list_type&
+object_pool_list() {
+  static ObjectPool::list_type* pools = new ObjectPool::list_type;
+
+  return *pools;
+}
+
+ObjectPool::ObjectPool(const char* name, size_t objectSize, uint32_t maxCached) :
+  m_name(name),
+  m_objectSize(std::max(objectSize, sizeof(node_type))),
+  m_first(NULL),
+  m_inUse(0),
+  m_cached(0),
+  m_maxCached(maxCached),
+  m_allocations(0),
+  m_reused(0) {
+
+  object_pool_list().push_back(this);
+}
+
+const ObjectPool::list_type&
+ObjectPool::pool_list() {
+  return object_pool_list();
+}
+
+void
+ObjectPool::set_max_cached(uint32_t v) {
+  m_maxCached = v;
+  trim(v);
+}
+
+void*
+ObjectPool::allocate(size_t size) {
+  if (size > m_objectSize)
+    throw internal_error("ObjectPool::allocate(...) object too large for the pool.");
+
+  m_allocations++;
+  m_inUse++;
+
+  if (m_first == NULL)
+    return ::operator new(m_objectSize);
+
+  node_type* node = m_first;
+  m_first = node->next;
+
+  m_cached--;
+  m_reused++;
+
+  return node;
+}
+
+void
+ObjectPool::deallocate(void* ptr) {
+  if (ptr == NULL)
+    return;
+
+  if (m_inUse == 0)
+    throw internal_error("ObjectPool::deallocate(...) called on a pool with no objects in use.");
+
+  m_inUse--;
+
+  if (m_cached >= m_maxCached) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  node_type* node = static_cast<node_type*>(ptr);
+  node->next = m_first;
+  m_first = node;
+
+  m_cached++;
+}
+
+void
+ObjectPool::trim(uint32_t size) {
+  while (m_cached > size) {
+    node_type* node = m_first;
+    m_first = node->next;
+
+    ::operator delete(node);
+    m_cached--;
+  }
+}
+
+}
@@ -0,0 +1,114 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#ifndef LIBTORRENT_OBJECT_POOL_H
+#define LIBTORRENT_OBJECT_POOL_H
+
+#include <vector>
+#include <torrent/common.h>
+
+namespace torrent {
+
+// Free list of fixed-size blocks for objects that are created and
+// destroyed at a high rate, like peer connections, handshakes and
+// block transfers. Released blocks are kept for reuse up to
+// 'max_cached', which avoids heap churn and fragmentation during
+// connection floods.
+//
+// Pools are only used from the main thread and are not thread-safe.
+//
+// Pools are allocated with 'new' and never destroyed, as objects may
+// still be released during static destruction, e.g. by a client that
+// skips torrent::cleanup().
+
+class LIBTORRENT_EXPORT ObjectPool {
+public:
+  typedef std::vector<ObjectPool*> list_type;
+
+  ObjectPool(const char* name, size_t objectSize, uint32_t maxCached);
+
+  // All pools in the process, in order of construction.
+  static const list_type& pool_list();
+
+  const char*         name() const                  { return m_name; }
+  size_t              object_size() const           { return m_objectSize; }
+
+  uint32_t            in_use() const                { return m_inUse; }
+  uint32_t            cached() const                { return m_cached; }
+
+  uint32_t            max_cached() const            { return m_maxCached; }
+  void                set_max_cached(uint32_t v);
+
+  // Total number of allocations, and how many of those reused a
+  // cached block.
+  uint64_t            allocations() const           { return m_allocations; }
+  uint64_t            reused() const                { return m_reused; }
+
+  void*               allocate(size_t size);
+  void                deallocate(void* ptr);
+
+  // Release all cached blocks.
+  void                clear()                       { trim(0); }
+
+private:
+  ObjectPool(const ObjectPool&);
+  void operator = (const ObjectPool&);
+
+  // Not defined, pools are never destroyed.
+  ~ObjectPool();
+
+  struct node_type {
+    node_type*        next;
+  };
+
+  void                trim(uint32_t size);
+
+  const char*         m_name;
+  size_t              m_objectSize;
+
+  node_type*          m_first;
+
+  uint32_t            m_inUse;
+  uint32_t            m_cached;
+  uint32_t            m_maxCached;
+
+  uint64_t            m_allocations;
+  uint64_t            m_reused;
+};
+
+}
+
+#endif
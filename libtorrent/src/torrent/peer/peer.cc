@@ -77,6 +77,7 @@ const Bitfield*   Peer::bitfield() const   { return c_ptr()->c_peer_chunks()->bi
 uint32_t Peer::incoming_queue_size() const { return c_ptr()->download_queue()->queued_size(); }
 uint32_t Peer::outgoing_queue_size() const { return c_ptr()->c_peer_chunks()->upload_queue()->size(); }  
 uint32_t Peer::chunks_done() const         { return c_ptr()->c_peer_chunks()->bitfield()->size_set(); }  
+uint32_t Peer::rtt() const                 { return c_ptr()->download_queue()->rtt(); }
 
 const BlockTransfer*
 Peer::transfer() const {
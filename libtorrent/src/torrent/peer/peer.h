@@ -90,6 +90,10 @@ public:
 
   uint32_t             chunks_done() const;
 
+  // Smoothed request round-trip time in microseconds, zero if not
+  // yet measured.
+  uint32_t             rtt() const;
+
   uint32_t             failed_counter() const             { return peer_info()->failed_counter(); }
 
   void                 disconnect(int flags);
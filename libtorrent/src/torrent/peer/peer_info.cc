@@ -43,10 +43,23 @@
 #include "protocol/peer_connection_base.h"
 
 #include "exceptions.h"
+#include "object_pool.h"
 #include "peer_info.h"
 
 namespace torrent {
 
+static ObjectPool& peer_info_pool = *new ObjectPool("peer_info", sizeof(PeerInfo), 4096);
+
+void*
+PeerInfo::operator new(size_t size) {
+  return peer_info_pool.allocate(size);
+}
+
+void
+PeerInfo::operator delete(void* ptr) {
+  peer_info_pool.deallocate(ptr);
+}
+
 // Move this to peer_info.cc when these are made into the public API.
 PeerInfo::PeerInfo(const sockaddr* address) : 
   m_flags(0),
@@ -64,6 +64,10 @@ public:
   PeerInfo(const sockaddr* address);
   ~PeerInfo();
 
+  // Allocated from an ObjectPool.
+  static void*        operator new(size_t size);
+  static void         operator delete(void* ptr);
+
   bool                is_connected() const                  { return m_flags & flag_connected; }
   bool                is_incoming() const                   { return m_flags & flag_incoming; }
   bool                is_handshake() const                  { return m_flags & flag_handshake; }
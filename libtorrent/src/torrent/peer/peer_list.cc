@@ -126,11 +126,6 @@ PeerList::insert_address(const sockaddr* sa, int flags) {
   return peerInfo;
 }
 
-inline bool
-socket_address_less_rak(const rak::socket_address& s1, const rak::socket_address& s2) {
-  return socket_address_less(s1.c_sockaddr(), s2.c_sockaddr());
-}
-
 uint32_t
 PeerList::insert_available(const void* al) {
   uint32_t inserted = 0;
@@ -139,25 +134,17 @@ PeerList::insert_available(const void* al) {
   if (m_availableList->size() + addressList->size() > m_availableList->capacity())
     m_availableList->reserve(m_availableList->size() + addressList->size() + 128);
 
-  // Optimize this so that we don't traverse the tree for every
-  // insert, since we know 'al' is sorted.
-
   AddressList::const_iterator itr   = addressList->begin();
   AddressList::const_iterator last  = addressList->end();
-  AvailableList::const_iterator availItr  = m_availableList->begin();
-  AvailableList::const_iterator availLast = m_availableList->end();
 
   for (; itr != last; itr++) {
     if (!socket_address_key::is_comparable(itr->c_sockaddr()) || itr->port() == 0)
       continue;
 
-    availItr = std::find_if(availItr, availLast, rak::bind2nd(std::ptr_fun(&socket_address_less_rak), *itr));
-
-    if (availItr != availLast && !socket_address_less(availItr->c_sockaddr(), itr->c_sockaddr())) {
-      // The address is already in m_availableList, so don't bother
-      // going further.
+    // The address is already in m_availableList, so don't bother
+    // going further.
+    if (m_availableList->has(*itr))
       continue;
-    }
 
     // Check if the peerinfo exists, if it does, check if we would
     // ever want to connect. Just update the timer for the last
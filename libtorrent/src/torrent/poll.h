@@ -47,6 +47,11 @@ class LIBTORRENT_EXPORT Poll {
 public:
   static const uint32_t flag_waive_global_lock = 0x1;
 
+  // Interest changes are only recorded, and get applied in a batch
+  // when the owner calls 'flush' before polling. Only supported by
+  // PollEPoll.
+  static const uint32_t flag_batch_changes     = 0x2;
+
   Poll() : m_flags(0) {}
   virtual ~Poll() {}
 
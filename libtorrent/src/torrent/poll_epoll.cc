@@ -67,18 +67,45 @@ PollEPoll::set_event_mask(Event* e, uint32_t m) {
 }
 
 inline void
-PollEPoll::modify(Event* event, int op, uint32_t mask) {
+PollEPoll::modify(Event* event, uint32_t mask) {
   if (event_mask(event) == mask)
     return;
 
+  set_event_mask(event, mask);
+  m_statsChanges++;
+
+  int fd = event->file_descriptor();
+
+  if (!(flags() & flag_batch_changes))
+    return apply(fd);
+
+  if (m_changeQueued[fd])
+    return;
+
+  m_changeQueued[fd] = true;
+  m_changes.push_back(fd);
+}
+
+// Bring the kernel's mask for 'fd' in line with the one in 'm_table'.
+void
+PollEPoll::apply(int fd) {
+  uint32_t mask = m_table[fd].first;
+  uint32_t current = m_kernelMasks[fd];
+
+  if (mask == current)
+    return;
+
+  int op = current == 0 ? EPOLL_CTL_ADD : mask == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+
   epoll_event e;
   e.data.u64 = 0; // Make valgrind happy? Remove please.
-  e.data.fd = event->file_descriptor();
+  e.data.fd = fd;
   e.events = mask;
 
-  set_event_mask(event, mask);
+  m_kernelMasks[fd] = mask;
+  m_statsCtlCalls++;
 
-  if (epoll_ctl(m_fd, op, event->file_descriptor(), &e)) {
+  if (epoll_ctl(m_fd, op, fd, &e)) {
     // Socket was probably already closed. Ignore this.
     if (op == EPOLL_CTL_DEL && errno == ENOENT)
       return;
@@ -94,11 +121,11 @@ PollEPoll::modify(Event* event, int op, uint32_t mask) {
       errno = 0;
     }
 
-    if (errno || epoll_ctl(m_fd, retry, event->file_descriptor(), &e)) {
+    if (errno || epoll_ctl(m_fd, retry, fd, &e)) {
       char errmsg[1024];
       snprintf(errmsg, sizeof(errmsg),
-               "PollEPoll::modify(...) epoll_ctl(%d, %d -> %d, %d, [%p:%x]) = %d: %s",
-               m_fd, op, retry, event->file_descriptor(), event, mask, errno, strerror(errno));
+               "PollEPoll::apply(...) epoll_ctl(%d, %d -> %d, %d, [%p:%x]) = %d: %s",
+               m_fd, op, retry, fd, m_table[fd].second, mask, errno, strerror(errno));
 
       throw internal_error(errmsg);
     }
@@ -119,9 +146,22 @@ PollEPoll::PollEPoll(int fd, int maxEvents, int maxOpenSockets) :
   m_fd(fd),
   m_maxEvents(maxEvents),
   m_waitingEvents(0),
-  m_events(new epoll_event[m_maxEvents]) {
+  m_events(new epoll_event[m_maxEvents]),
+
+  m_statsChanges(0),
+  m_statsCtlCalls(0),
+  m_statsWaitCalls(0),
+  m_statsEvents(0),
+
+  m_lastChanges(0),
+  m_lastCtlCalls(0),
+  m_lastEvents(0),
+  m_markChanges(0),
+  m_markCtlCalls(0) {
 
   m_table.resize(maxOpenSockets);
+  m_kernelMasks.resize(maxOpenSockets);
+  m_changeQueued.resize(maxOpenSockets);
 }
 
 PollEPoll::~PollEPoll() {
@@ -133,14 +173,36 @@ PollEPoll::~PollEPoll() {
 
 int
 PollEPoll::poll(int msec) {
+  m_lastChanges = m_statsChanges - m_markChanges;
+  m_lastCtlCalls = m_statsCtlCalls - m_markCtlCalls;
+  m_markChanges = m_statsChanges;
+  m_markCtlCalls = m_statsCtlCalls;
+
   int nfds = epoll_wait(m_fd, m_events, m_maxEvents, msec);
 
-  if (nfds == -1)
+  m_statsWaitCalls++;
+
+  if (nfds == -1) {
+    m_lastEvents = 0;
     return -1;
+  }
+
+  m_statsEvents += nfds;
+  m_lastEvents = nfds;
 
   return m_waitingEvents = nfds;
 }
 
+void
+PollEPoll::flush() {
+  for (std::vector<int>::const_iterator itr = m_changes.begin(), last = m_changes.end(); itr != last; ++itr) {
+    m_changeQueued[*itr] = false;
+    apply(*itr);
+  }
+
+  m_changes.clear();
+}
+
 // We check m_table to make sure the Event is still listening to the
 // event, so it is safe to remove Event's while in working.
 //
@@ -192,6 +254,10 @@ PollEPoll::close(Event* event) {
   if (event_mask(event) != 0)
     throw internal_error("PollEPoll::close(...) called but the file descriptor is active");
 
+  // A batched removal must reach the kernel before the file
+  // descriptor gets closed and possibly reused.
+  apply(event->file_descriptor());
+
   m_table[event->file_descriptor()] = Table::value_type();
 
   // Clear the event list just in case we open a new socket with the
@@ -205,8 +271,10 @@ void
 PollEPoll::closed(Event* event) {
   // Kernel removes closed FDs automatically, so just clear the mask and remove it from pending calls.
   // Don't touch if the FD was re-used before we received the close notification.
-  if (m_table[event->file_descriptor()].second == event)
+  if (m_table[event->file_descriptor()].second == event) {
     m_table[event->file_descriptor()] = Table::value_type();
+    m_kernelMasks[event->file_descriptor()] = 0;
+  }
 
   /*
   for (epoll_event *itr = m_events, *last = m_events + m_waitingEvents; itr != last; ++itr) {
@@ -235,44 +303,32 @@ PollEPoll::in_error(Event* event) {
 
 void
 PollEPoll::insert_read(Event* event) {
-  modify(event,
-	 event_mask(event) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
-	 event_mask(event) | EPOLLIN);
+  modify(event, event_mask(event) | EPOLLIN);
 }
 
 void
 PollEPoll::insert_write(Event* event) {
-  modify(event,
-	 event_mask(event) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
-	 event_mask(event) | EPOLLOUT);
+  modify(event, event_mask(event) | EPOLLOUT);
 }
 
 void
 PollEPoll::insert_error(Event* event) {
-  modify(event,
-	 event_mask(event) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
-	 event_mask(event) | EPOLLERR);
+  modify(event, event_mask(event) | EPOLLERR);
 }
 
 void
 PollEPoll::remove_read(Event* event) {
-  uint32_t mask = event_mask(event) & ~EPOLLIN;
-
-  modify(event, mask ? EPOLL_CTL_MOD : EPOLL_CTL_DEL, mask);
+  modify(event, event_mask(event) & ~EPOLLIN);
 }
 
 void
 PollEPoll::remove_write(Event* event) {
-  uint32_t mask = event_mask(event) & ~EPOLLOUT;
-
-  modify(event, mask ? EPOLL_CTL_MOD : EPOLL_CTL_DEL, mask);
+  modify(event, event_mask(event) & ~EPOLLOUT);
 }
 
 void
 PollEPoll::remove_error(Event* event) {
-  uint32_t mask = event_mask(event) & ~EPOLLERR;
-
-  modify(event, mask ? EPOLL_CTL_MOD : EPOLL_CTL_DEL, mask);
+  modify(event, event_mask(event) & ~EPOLLERR);
 }
 
 #else // USE_EPOLL
@@ -282,6 +338,7 @@ PollEPoll::~PollEPoll() {}
 
 int PollEPoll::poll(int msec) { throw internal_error("An PollEPoll function was called, but it is disabled."); }
 void PollEPoll::perform() { throw internal_error("An PollEPoll function was called, but it is disabled."); }
+void PollEPoll::flush() {}
 uint32_t PollEPoll::open_max() const { throw internal_error("An PollEPoll function was called, but it is disabled."); }
 
 void PollEPoll::open(torrent::Event* event) {}
@@ -54,6 +54,11 @@ public:
   int                 poll(int msec);
   void                perform();
 
+  // Apply the interest changes recorded with 'flag_batch_changes',
+  // must be called with the global lock held before 'poll'. Changes
+  // that cancel each other out result in no syscalls.
+  void                flush();
+
   int                 file_descriptor() { return m_fd; }
 
   virtual uint32_t    open_max() const;
@@ -81,13 +86,27 @@ public:
   virtual void        remove_write(torrent::Event* event);
   virtual void        remove_error(torrent::Event* event);
 
+  // Totals since creation.
+  uint64_t            stats_changes() const   { return m_statsChanges; }
+  uint64_t            stats_ctl_calls() const { return m_statsCtlCalls; }
+  uint64_t            stats_wait_calls() const { return m_statsWaitCalls; }
+  uint64_t            stats_events() const    { return m_statsEvents; }
+
+  // Counts for the last poll loop iteration; the changes and
+  // epoll_ctl calls made before the last wait, and the events it
+  // returned.
+  uint64_t            stats_last_changes() const   { return m_lastChanges; }
+  uint64_t            stats_last_ctl_calls() const { return m_lastCtlCalls; }
+  uint64_t            stats_last_events() const    { return m_lastEvents; }
+
 private:
   PollEPoll(int fd, int maxEvents, int maxOpenSockets);
 
   inline uint32_t     event_mask(Event* e);
   inline void         set_event_mask(Event* e, uint32_t m);
 
-  inline void         modify(torrent::Event* event, int op, uint32_t mask);
+  inline void         modify(torrent::Event* event, uint32_t mask);
+  void                apply(int fd);
 
   int                 m_fd;
 
@@ -96,6 +115,25 @@ private:
 
   Table               m_table;
   epoll_event*        m_events;
+
+  // The masks currently registered with the kernel, which differ from
+  // those in 'm_table' only for file descriptors in 'm_changes'.
+  std::vector<uint32_t> m_kernelMasks;
+  std::vector<bool>     m_changeQueued;
+  std::vector<int>      m_changes;
+
+  uint64_t            m_statsChanges;
+  uint64_t            m_statsCtlCalls;
+  uint64_t            m_statsWaitCalls;
+  uint64_t            m_statsEvents;
+
+  uint64_t            m_lastChanges;
+  uint64_t            m_lastCtlCalls;
+  uint64_t            m_lastEvents;
+
+  // Totals at the time of the last wait.
+  uint64_t            m_markChanges;
+  uint64_t            m_markCtlCalls;
 };
 
 }
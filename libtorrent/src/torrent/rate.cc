@@ -36,27 +36,108 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "globals.h"
 #include "rate.h"
 #include "exceptions.h"
 
 namespace torrent {
 
+Rate::Rate(timer_type span) :
+  m_head(0),
+  m_current(0),
+  m_snapshot(0),
+  m_total(0),
+  m_span(span) {
+
+  if (span <= 0)
+    throw internal_error("Rate::Rate(...) received an invalid span.");
+
+  m_width = (span + bucket_count - 1) / bucket_count;
+  m_used = (span + m_width - 1) / m_width;
+
+  reset_rate();
+}
+
+void
+Rate::set_span(timer_type s) {
+  if (s <= 0)
+    throw internal_error("Rate::set_span(...) received an invalid span.");
+
+  discard_old();
+
+  rate_type current = m_current;
+
+  m_span = s;
+  m_width = (s + bucket_count - 1) / bucket_count;
+  m_used = (s + m_width - 1) / m_width;
+
+  reset_rate();
+
+  m_buckets[m_head % m_used] = current;
+  m_current = current;
+
+  publish();
+}
+
+void
+Rate::set_total(total_type bytes) {
+  __atomic_store_n(&m_total, bytes, __ATOMIC_RELAXED);
+}
+
+void
+Rate::reset_rate() {
+  std::fill(m_buckets, m_buckets + bucket_count, rate_type());
+
+  m_head = cachedTime.seconds() / m_width;
+  m_current = 0;
+
+  publish();
+}
+
+// Buckets that have fallen out of the span are cleared as the head
+// advances, which touches at most 'm_used' buckets per call.
 inline void
 Rate::discard_old() const {
-  while (!m_container.empty() && m_container.back().first < cachedTime.seconds() - m_span) {
-    m_current -= m_container.back().second;
-    m_container.pop_back();
+  timer_type slot = cachedTime.seconds() / m_width;
+
+  if (slot <= m_head)
+    return;
+
+  for (timer_type i = std::min(slot - m_head, m_used); i != 0; --i) {
+    rate_type& bucket = m_buckets[(slot - i + 1) % m_used];
+
+    m_current -= bucket;
+    bucket = 0;
   }
+
+  m_head = slot;
+}
+
+inline void
+Rate::publish() const {
+  __atomic_store_n(&m_snapshot, m_current / m_span, __ATOMIC_RELAXED);
 }
 
 Rate::rate_type
 Rate::rate() const {
   discard_old();
+  publish();
 
   return m_current / m_span;
 }
 
+Rate::rate_type
+Rate::rate_snapshot() const {
+  return __atomic_load_n(&m_snapshot, __ATOMIC_RELAXED);
+}
+
+Rate::total_type
+Rate::total_snapshot() const {
+  return __atomic_load_n(&m_total, __ATOMIC_RELAXED);
+}
+
 void
 Rate::insert(rate_type bytes) {
   discard_old();
@@ -64,13 +145,11 @@ Rate::insert(rate_type bytes) {
   if (m_current > ((rate_type)1 << 40) || bytes > ((rate_type)1 << 28))
     throw internal_error("Rate::insert(bytes) received out-of-bounds values..");
 
-  if (m_container.empty() || m_container.front().first != cachedTime.seconds())
-    m_container.push_front(value_type(cachedTime.seconds(), bytes));
-  else
-    m_container.front().second += bytes;
-
-  m_total += bytes;
+  m_buckets[m_head % m_used] += bytes;
   m_current += bytes;
+
+  __atomic_store_n(&m_total, m_total + bytes, __ATOMIC_RELAXED);
+  publish();
 }
 
 }
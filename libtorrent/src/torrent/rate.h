@@ -37,14 +37,19 @@
 #ifndef LIBTORRENT_UTILS_RATE_H
 #define LIBTORRENT_UTILS_RATE_H
 
-#include <deque>
 #include <torrent/common.h>
 
 namespace torrent {
 
 // Keep the current rate count up to date for each call to rate() and
 // insert(...). This requires a mutable since rate() can be const, but
-// is justified as we avoid iterating the deque for each call.
+// is justified as we avoid iterating the buckets for each call.
+//
+// Transfers are summed into a fixed ring of buckets, each covering
+// 'span / bucket_count' seconds rounded up, so both insert and rate
+// are O(1) and the object never allocates. The most recently
+// calculated rate is also published for lock-free reads from other
+// threads through rate_snapshot() and total_snapshot().
 
 class LIBTORRENT_EXPORT Rate {
 public:
@@ -52,25 +57,32 @@ public:
   typedef uint64_t                         rate_type;
   typedef uint64_t                         total_type;
 
-  typedef std::pair<timer_type, rate_type> value_type;
-  typedef std::deque<value_type>           queue_type;
+  static const unsigned int bucket_count = 16;
 
-  Rate(timer_type span) : m_current(0), m_total(0), m_span(span) {}
+  Rate(timer_type span);
 
   // Bytes per second.
   rate_type           rate() const;
 
   // Total bytes transfered.
   total_type          total() const                           { return m_total; }
-  void                set_total(total_type bytes)             { m_total = bytes; }
+  void                set_total(total_type bytes);
 
-  // Interval in seconds used to calculate the rate.
+  // Interval in seconds used to calculate the rate. Changing it keeps
+  // the bytes currently in the window, but they are counted as
+  // transfered during the last bucket.
   timer_type          span() const                            { return m_span; }
-  void                set_span(timer_type s)                  { m_span = s; }
+  void                set_span(timer_type s);
+
+  // May be called without holding the global lock. The rate is the
+  // one calculated by the last call to rate() or insert(...), so it
+  // only decays once the main thread reads rate() again.
+  rate_type           rate_snapshot() const;
+  total_type          total_snapshot() const;
 
   void                insert(rate_type bytes);
 
-  void                reset_rate()                            { m_current = 0; m_container.clear(); }
+  void                reset_rate();
   
   bool                operator <  (Rate& r) const             { return rate() < r.rate(); }
   bool                operator >  (Rate& r) const             { return rate() > r.rate(); }
@@ -84,12 +96,19 @@ public:
 
 private:
   inline void         discard_old() const;
+  inline void         publish() const;
 
-  mutable queue_type  m_container;
+  mutable rate_type   m_buckets[bucket_count];
+  mutable timer_type  m_head;
 
   mutable rate_type   m_current;
+  mutable rate_type   m_snapshot;
   total_type          m_total;
   timer_type          m_span;
+
+  // Seconds per bucket and the number of buckets in use.
+  timer_type          m_width;
+  timer_type          m_used;
 };
 
 }
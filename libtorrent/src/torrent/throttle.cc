@@ -36,6 +36,7 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <rak/timer.h> 
 
 #include "net/throttle_internal.h"
@@ -145,17 +146,13 @@ Throttle::calculate_interval() const {
   uint32_t rate = m_throttleList->rate_slow()->rate();
 
   if (rate < 1024)
-    return 10 * 100000;
+    return 1000000;
 
-  // At least two max chunks per tick.
-  uint32_t interval = (5 * m_throttleList->max_chunk_size()) / rate;
+  // At least two max chunks per tick, measured in microseconds so
+  // fast throttles get short ticks and correspondingly small bursts.
+  uint64_t interval = (uint64_t)5 * m_throttleList->max_chunk_size() * 1000000 / rate;
 
-  if (interval == 0)
-    return 1 * 100000;
-  else if (interval > 10)
-    return 10 * 100000;
-  else
-    return interval * 100000;
+  return std::max<uint64_t>(std::min<uint64_t>(interval, 1000000), ThrottleInternal::min_tick_interval);
 }
 
 }
@@ -52,12 +52,14 @@
 
 #include "protocol/handshake_manager.h"
 #include "protocol/peer_factory.h"
+#include "data/disk_engine.h"
 #include "data/file_manager.h"
 #include "data/hash_queue.h"
 #include "data/hash_torrent.h"
 #include "download/download_constructor.h"
 #include "download/download_manager.h"
 #include "download/download_wrapper.h"
+#include "net/poll_shards.h"
 #include "torrent/peer/connection_list.h"
 #include "torrent/download/resource_manager.h"
 
@@ -91,6 +93,21 @@ calculate_reserved(uint32_t openMax) {
     return 16;
 }    
 
+// File descriptors duplicated by requests queued on the disk engine.
+uint32_t
+calculate_disk_engine_files(uint32_t openMax) {
+  if (openMax >= 8096)
+    return 64;
+  else if (openMax >= 1024)
+    return 32;
+  else if (openMax >= 512)
+    return 16;
+  else if (openMax >= 128)
+    return 8;
+  else // Assumes we don't try less than 64.
+    return 4;
+}
+
 void
 initialize(Poll* poll) {
   if (manager != NULL)
@@ -105,9 +122,11 @@ initialize(Poll* poll) {
   manager->set_poll(poll);
 
   uint32_t maxFiles = calculate_max_open_files(poll->open_max());
+  uint32_t engineFiles = calculate_disk_engine_files(poll->open_max());
 
-  manager->connection_manager()->set_max_size(poll->open_max() - maxFiles - calculate_reserved(poll->open_max()));
+  manager->connection_manager()->set_max_size(poll->open_max() - maxFiles - engineFiles - calculate_reserved(poll->open_max()));
   manager->file_manager()->set_max_open_files(maxFiles);
+  manager->disk_engine()->set_max_open_files(engineFiles);
 }
 
 // Clean up and close stuff. Stopping all torrents and waiting for
@@ -162,6 +181,19 @@ total_handshakes() {
   return manager->handshake_manager()->size();
 }
 
+uint32_t
+network_thread_count() {
+  return manager->poll_shards()->size();
+}
+
+void
+set_network_thread_count(uint32_t count) {
+  if (count > 64)
+    throw input_error("Network thread count must be between 0 and 64.");
+
+  manager->poll_shards()->resize(count);
+}
+
 int64_t
 next_timeout() {
   cachedTime = rak::timer::current();
@@ -216,6 +248,32 @@ set_hash_max_tries(uint32_t tries) {
   manager->hash_queue()->set_max_tries(tries);
 }  
 
+uint32_t
+hash_thread_count() {
+  return manager->hash_queue()->thread_count();
+}
+
+void
+set_hash_thread_count(uint32_t count) {
+  if (count > 64)
+    throw input_error("Hash thread count must be between 0 and 64.");
+
+  manager->hash_queue()->set_thread_count(count);
+}
+
+uint32_t
+disk_engine_type() {
+  return manager->disk_engine()->type();
+}
+
+void
+set_disk_engine_type(uint32_t type) {
+  if (type > DiskEngine::engine_io_uring)
+    throw input_error("Disk engine type must be between 0 and 2.");
+
+  manager->disk_engine()->open(type);
+}
+
 EncodingList*
 encoding_list() {
   return manager->encoding_list();
@@ -74,6 +74,14 @@ ResourceManager*    resource_manager() LIBTORRENT_EXPORT;
 
 uint32_t            total_handshakes() LIBTORRENT_EXPORT;
 
+// Number of threads polling the peer connections, if zero they are
+// polled on the main thread. The handlers still run one at a time
+// under the global lock, which the client's main thread must hold
+// while not polling. Can't be changed while peers are connected
+// through the threads.
+uint32_t            network_thread_count() LIBTORRENT_EXPORT;
+void                set_network_thread_count(uint32_t count) LIBTORRENT_EXPORT;
+
 Throttle*           down_throttle_global() LIBTORRENT_EXPORT;
 Throttle*           up_throttle_global() LIBTORRENT_EXPORT;
 
@@ -94,6 +102,18 @@ void                set_hash_interval(uint32_t usec) LIBTORRENT_EXPORT;
 uint32_t            hash_max_tries() LIBTORRENT_EXPORT;
 void                set_hash_max_tries(uint32_t tries) LIBTORRENT_EXPORT;
 
+// Number of threads used for hash checking, if zero the chunks are
+// hashed on the main thread.
+uint32_t            hash_thread_count() LIBTORRENT_EXPORT;
+void                set_hash_thread_count(uint32_t count) LIBTORRENT_EXPORT;
+
+// Engine used for fallocate and read-ahead off the main
+// thread; 0 disables it, 1 uses worker threads and 2 uses io_uring,
+// falling back to worker threads if unsupported. The getter returns
+// the engine actually in use.
+uint32_t            disk_engine_type() LIBTORRENT_EXPORT;
+void                set_disk_engine_type(uint32_t type) LIBTORRENT_EXPORT;
+
 typedef std::list<Download> DList;
 typedef std::list<std::string> EncodingList;
 
@@ -36,6 +36,10 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include <rak/file_stat.h>
 #include <rak/socket_address.h>
 
@@ -46,6 +50,7 @@
 #include "data/file_list.h"
 #include "data/transfer_list.h"
 #include "net/address_list.h"
+#include "utils/sha1.h"
 
 #include "common.h"
 #include "bitfield.h"
@@ -61,8 +66,91 @@
 
 namespace torrent {
 
+// The fingerprint hashes the file size and a few blocks spread evenly
+// across the file, enough to notice files that were replaced or
+// modified without reading more than a few hundred KiB.
+static const unsigned int resume_fingerprint_samples = 8;
+static const unsigned int resume_fingerprint_block   = 16 << 10;
+
+static bool
+resume_file_fingerprint(const std::string& path, uint64_t size, char* digest) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd == -1)
+    return false;
+
+  char buffer[resume_fingerprint_block];
+  uint32_t length = std::min<uint64_t>(size, resume_fingerprint_block);
+
+  Sha1 sha1;
+  sha1.init();
+
+  for (int i = 56; i >= 0; i -= 8) {
+    char c = size >> i;
+    sha1.update(&c, 1);
+  }
+
+  for (unsigned int i = 0; i < resume_fingerprint_samples; i++) {
+    uint64_t offset = (size - length) / (resume_fingerprint_samples - 1) * i;
+
+    if (::pread(fd, buffer, length, offset) != (ssize_t)length) {
+      ::close(fd);
+      return false;
+    }
+
+    sha1.update(buffer, length);
+  }
+
+  ::close(fd);
+  sha1.final_c(digest);
+  return true;
+}
+
+// Call before updating 'mtime', the samples are only rehashed if the
+// file might have changed since the fingerprint was made.
+static void
+resume_save_fingerprint(Object& file, const std::string& path, const rak::file_stat& fs) {
+  if (file.has_key_string("fingerprint") && file.has_key_value("inode") && file.has_key_value("mtime") &&
+      file.get_key_value("inode") == (int64_t)fs.inode() &&
+      file.get_key_value("mtime") == (int64_t)fs.modified_time())
+    return;
+
+  char digest[20];
+
+  if (!resume_file_fingerprint(path, fs.size(), digest)) {
+    file.erase_key("fingerprint");
+    file.erase_key("inode");
+    return;
+  }
+
+  file.insert_key("inode", (int64_t)fs.inode());
+  file.insert_key("fingerprint", std::string(digest, 20));
+}
+
+// A matching 'mtime' is trusted without reading the file. The
+// fingerprint is only checked when the 'mtime' differs, e.g. after
+// the file was copied or touched without being modified.
+static bool
+resume_file_unchanged(const Object& file, const std::string& path, const rak::file_stat& fs, int verify) {
+  bool sameInode = !file.has_key_value("inode") || file.get_key_value("inode") == (int64_t)fs.inode();
+
+  if (file.get_key_value("mtime") == (int64_t)fs.modified_time() && sameInode)
+    return true;
+
+  if (verify != resume_verify_fingerprint || !file.has_key_string("fingerprint"))
+    return false;
+
+  const Object::string_type& fingerprint = file.get_key_string("fingerprint");
+  char digest[20];
+
+  return
+    fingerprint.size() == 20 &&
+    resume_file_fingerprint(path, fs.size(), digest) &&
+    std::memcmp(digest, fingerprint.c_str(), 20) == 0;
+}
+
 void
-resume_load_progress(Download download, const Object& object) {
+resume_load_progress(Download download, const Object& object, int verify) {
   if (!object.has_key_list("files"))
     return;
 
@@ -111,8 +199,9 @@ resume_load_progress(Download download, const Object& object) {
       continue;
     }
 
-    int64_t mtimeValue = filesItr->get_key_value("mtime");
-    bool    fileExists = fs.update(fileList->root_dir() + (*listItr)->path()->as_string());
+    int64_t     mtimeValue = filesItr->get_key_value("mtime");
+    std::string filePath   = fileList->root_dir() + (*listItr)->path()->as_string();
+    bool        fileExists = fs.update(filePath);
 
     // The default action when we have 'mtime' is not to create nor
     // resize the file.
@@ -160,11 +249,11 @@ resume_load_progress(Download download, const Object& object) {
     // old rtorrent version which does not include 'uncertain_pieces'
     // field, and thus can't be relied upon.
     //
-    // If the 'mtime' is an actual mtime we check to see if it matches
-    // the file, else clear the range. This should be set only for
-    // files that have completed and got no indices in
-    // TransferList::completed_list().
-    if (mtimeValue == ~int64_t(2) || mtimeValue != fs.modified_time()) {
+    // If the 'mtime' is an actual mtime we check to see if it, or the
+    // fingerprint when verifying those, matches the file, else clear
+    // the range. This should be set only for files that have
+    // completed and got no indices in TransferList::completed_list().
+    if (mtimeValue == ~int64_t(2) || !resume_file_unchanged(*filesItr, filePath, fs, verify)) {
       download.update_range(Download::update_range_clear | Download::update_range_recheck,
                             (*listItr)->range().first, (*listItr)->range().second);
       continue;
@@ -217,7 +306,13 @@ resume_save_progress(Download download, Object& object) {
     filesItr->insert_key("completed", (int64_t)(*listItr)->completed_chunks());
 
     rak::file_stat fs;
-    bool fileExists = fs.update(fileList->root_dir() + (*listItr)->path()->as_string());
+    std::string filePath = fileList->root_dir() + (*listItr)->path()->as_string();
+    bool fileExists = fs.update(filePath);
+
+    if (!fileExists) {
+      filesItr->erase_key("fingerprint");
+      filesItr->erase_key("inode");
+    }
 
     if (!fileExists) {
       
@@ -237,18 +332,24 @@ resume_save_progress(Download download, Object& object) {
 
       // This assumes the syncs are properly called before
       // resume_save_progress gets called after finishing a torrent.
+      resume_save_fingerprint(*filesItr, filePath, fs);
       filesItr->insert_key("mtime", (int64_t)fs.modified_time());
 
-    } else if (!download.info()->is_active()) {
+    } else if (!download.info()->is_active() || (*listItr)->completed_chunks() == (*listItr)->size_chunks()) {
 
       // When stopped, all chunks should have received sync, thus the
-      // file's mtime will be correct. (We hope)
+      // file's mtime will be correct. (We hope) Completed files of an
+      // active torrent are no longer written to and were synced
+      // above, so they are trusted too.
+      resume_save_fingerprint(*filesItr, filePath, fs);
       filesItr->insert_key("mtime", (int64_t)fs.modified_time());
 
     } else {
       // If the torrent isn't done and we've not shut down, then set
       // 'mtime' to ~3 so as to indicate that the 'mtime' is not to be
-      // trusted, yet we have a partial bitfield for the file.
+      // trusted, yet we have a partial bitfield for the file. Any
+      // fingerprint is kept, it is refreshed once the file's 'mtime'
+      // can be trusted again.
       filesItr->insert_key("mtime", ~int64_t(3));
     }
   }
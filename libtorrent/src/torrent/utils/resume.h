@@ -52,8 +52,17 @@ namespace torrent {
 // When saving resume data for a torrent that is currently active, set
 // 'onlyCompleted' to ensure that a crash, etc, will cause incomplete
 // files to be hashed.
+//
+// Files with a trusted 'mtime' also get a fingerprint of their inode
+// and a hash of sampled blocks. With 'resume_verify_fingerprint' a
+// file whose 'mtime' changed is still considered unchanged if the
+// fingerprint matches, and only the chunks of files that fail the
+// check are rehashed.
+
+static const int resume_verify_mtime       = 0;
+static const int resume_verify_fingerprint = 1;
 
-void resume_load_progress(Download download, const Object& object) LIBTORRENT_EXPORT;
+void resume_load_progress(Download download, const Object& object, int verify = resume_verify_mtime) LIBTORRENT_EXPORT;
 void resume_save_progress(Download download, Object& object) LIBTORRENT_EXPORT;
 void resume_clear_progress(Download download, Object& object) LIBTORRENT_EXPORT;
 
@@ -36,11 +36,13 @@
 
 #include "config.h"
 
+#include <csignal>
 #include <cstring>
 #include <string>
 
 #ifdef USE_OPENSSL
 #include <openssl/bn.h>
+#include <openssl/crypto.h>
 #endif
 
 #include "diffie_hellman.h"
@@ -57,6 +59,11 @@ DiffieHellman::DiffieHellman(const unsigned char *prime, int primeLength,
   m_dh->p = BN_bin2bn(prime, primeLength, NULL);
   m_dh->g = BN_bin2bn(generator, generatorLength, NULL);
 
+  // The MSE spec requires at least 128 bits of private key and
+  // anything beyond 180 bits adds no security, while a full-length
+  // exponent makes the modexp several times slower.
+  m_dh->length = private_key_bits;
+
   DH_generate_key(m_dh);
 #else
   throw internal_error("Compiled without encryption support.");
@@ -94,4 +101,152 @@ DiffieHellman::store_pub_key(unsigned char* dest, unsigned int length) {
 #endif
 }
 
+#if defined(USE_OPENSSL) && OPENSSL_VERSION_NUMBER < 0x10100000L
+// OpenSSL before 1.1 is only thread-safe if the application provides
+// locking callbacks. Install them unless the client already has.
+
+static pthread_mutex_t* openssl_locks = NULL;
+
+static void
+openssl_locking_callback(int mode, int n, const char* file, int line) {
+  if (mode & CRYPTO_LOCK)
+    pthread_mutex_lock(openssl_locks + n);
+  else
+    pthread_mutex_unlock(openssl_locks + n);
+}
+
+static unsigned long
+openssl_id_callback() {
+  return (unsigned long)pthread_self();
+}
+
+static void
+openssl_thread_setup() {
+  if (CRYPTO_get_locking_callback() != NULL)
+    return;
+
+  openssl_locks = new pthread_mutex_t[CRYPTO_num_locks()];
+
+  for (int i = 0; i < CRYPTO_num_locks(); i++)
+    pthread_mutex_init(openssl_locks + i, NULL);
+
+  CRYPTO_set_id_callback(&openssl_id_callback);
+  CRYPTO_set_locking_callback(&openssl_locking_callback);
+}
+#elif defined(USE_OPENSSL)
+static void
+openssl_thread_setup() {
+}
+#endif
+
+DiffieHellmanPool::DiffieHellmanPool(const unsigned char prime[], int primeLength,
+                                     const unsigned char generator[], int generatorLength,
+                                     unsigned int maxSize) :
+  m_prime(prime),
+  m_primeLength(primeLength),
+  m_generator(generator),
+  m_generatorLength(generatorLength),
+  m_maxSize(maxSize),
+  m_started(false),
+  m_shutdown(false) {
+
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_condRefill, NULL);
+}
+
+DiffieHellmanPool::~DiffieHellmanPool() {
+  if (m_started) {
+    pthread_mutex_lock(&m_lock);
+    m_shutdown = true;
+    pthread_cond_signal(&m_condRefill);
+    pthread_mutex_unlock(&m_lock);
+
+    pthread_join(m_thread, NULL);
+  }
+
+  for (key_list::iterator itr = m_keys.begin(), last = m_keys.end(); itr != last; ++itr)
+    delete *itr;
+
+  pthread_cond_destroy(&m_condRefill);
+  pthread_mutex_destroy(&m_lock);
+}
+
+DiffieHellman*
+DiffieHellmanPool::create_key() const {
+  return new DiffieHellman(m_prime, m_primeLength, m_generator, m_generatorLength);
+}
+
+DiffieHellman*
+DiffieHellmanPool::take() {
+  if (!m_started && m_maxSize != 0)
+    start_thread();
+
+  if (!m_started)
+    return create_key();
+
+  DiffieHellman* key = NULL;
+
+  pthread_mutex_lock(&m_lock);
+
+  if (!m_keys.empty()) {
+    key = m_keys.back();
+    m_keys.pop_back();
+  }
+
+  pthread_cond_signal(&m_condRefill);
+  pthread_mutex_unlock(&m_lock);
+
+  return key != NULL ? key : create_key();
+}
+
+void
+DiffieHellmanPool::start_thread() {
+#ifdef USE_OPENSSL
+  openssl_thread_setup();
+
+  // The worker thread inherits the signal mask, so block everything
+  // while creating it as done for HashThreadPool.
+  sigset_t fullMask;
+  sigset_t oldMask;
+
+  sigfillset(&fullMask);
+  pthread_sigmask(SIG_SETMASK, &fullMask, &oldMask);
+
+  m_started = pthread_create(&m_thread, NULL, &DiffieHellmanPool::thread_main, this) == 0;
+
+  pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+#endif
+
+  // Without a worker thread 'take' simply generates keys inline.
+  if (!m_started)
+    m_maxSize = 0;
+}
+
+void*
+DiffieHellmanPool::thread_main(void* pool) {
+  static_cast<DiffieHellmanPool*>(pool)->thread_perform();
+  return NULL;
+}
+
+void
+DiffieHellmanPool::thread_perform() {
+  pthread_mutex_lock(&m_lock);
+
+  while (true) {
+    while (m_keys.size() >= m_maxSize && !m_shutdown)
+      pthread_cond_wait(&m_condRefill, &m_lock);
+
+    if (m_shutdown)
+      break;
+
+    pthread_mutex_unlock(&m_lock);
+    DiffieHellman* key = create_key();
+    pthread_mutex_lock(&m_lock);
+
+    m_keys.push_back(key);
+  }
+
+  pthread_mutex_unlock(&m_lock);
+}
+
 };
@@ -40,6 +40,8 @@
 #include "config.h"
 
 #include <string>
+#include <vector>
+#include <pthread.h>
 
 #ifdef USE_OPENSSL
 #include <openssl/dh.h>
@@ -49,6 +51,8 @@ namespace torrent {
 
 class DiffieHellman {
 public:
+  static const int    private_key_bits = 160;
+
   DiffieHellman(const unsigned char prime[], int primeLength,
                 const unsigned char generator[], int generatorLength);
   ~DiffieHellman();
@@ -72,6 +76,55 @@ private:
   unsigned int        m_size;
 };
 
+// Keeps a number of DiffieHellman keys generated ahead of time by a
+// background thread, as generating the key pair is the expensive
+// part of accepting an encrypted connection. The thread is only
+// started on the first call to 'take', so clients that never use
+// encryption don't pay for it.
+
+class DiffieHellmanPool {
+public:
+  typedef std::vector<DiffieHellman*> key_list;
+
+  DiffieHellmanPool(const unsigned char prime[], int primeLength,
+                    const unsigned char generator[], int generatorLength,
+                    unsigned int maxSize);
+  ~DiffieHellmanPool();
+
+  // Returns a pre-generated key if one is available, else generates
+  // one on the calling thread. The caller owns the returned key.
+  DiffieHellman*      take();
+
+  unsigned int        max_size() const     { return m_maxSize; }
+
+private:
+  DiffieHellmanPool(const DiffieHellmanPool&);
+  void operator = (const DiffieHellmanPool&);
+
+  DiffieHellman*      create_key() const;
+
+  void                start_thread();
+
+  static void*        thread_main(void* pool);
+  void                thread_perform();
+
+  const unsigned char* m_prime;
+  int                 m_primeLength;
+  const unsigned char* m_generator;
+  int                 m_generatorLength;
+
+  unsigned int        m_maxSize;
+
+  pthread_mutex_t     m_lock;
+  pthread_cond_t      m_condRefill;
+
+  bool                m_started;
+  bool                m_shutdown;
+  pthread_t           m_thread;
+
+  key_list            m_keys;
+};
+
 };
 
 #endif
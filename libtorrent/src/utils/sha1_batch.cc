@@ -0,0 +1,439 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "torrent/exceptions.h"
+
+#include "sha1_batch.h"
+
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define USE_SHA1_BATCH_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace torrent {
+
+static const uint32_t sha1_k[4] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
+
+typedef uint32_t sha1_state_type[Sha1Batch::max_lanes];
+
+static inline uint32_t
+sha1_rotl(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t
+sha1_load_be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void
+sha1_compress_lane(sha1_state_type* state, unsigned int lane, const uint8_t* block) {
+  uint32_t w[80];
+
+  for (int t = 0; t < 16; t++)
+    w[t] = sha1_load_be32(block + 4 * t);
+
+  for (int t = 16; t < 80; t++)
+    w[t] = sha1_rotl(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+
+  uint32_t a = state[0][lane];
+  uint32_t b = state[1][lane];
+  uint32_t c = state[2][lane];
+  uint32_t d = state[3][lane];
+  uint32_t e = state[4][lane];
+
+  for (int t = 0; t < 80; t++) {
+    uint32_t f;
+
+    if (t < 20)
+      f = (b & c) | (~b & d);
+    else if (t < 40 || t >= 60)
+      f = b ^ c ^ d;
+    else
+      f = (b & c) | (d & (b | c));
+
+    uint32_t tmp = sha1_rotl(a, 5) + f + e + sha1_k[t / 20] + w[t];
+
+    e = d;
+    d = c;
+    c = sha1_rotl(b, 30);
+    b = a;
+    a = tmp;
+  }
+
+  state[0][lane] += a;
+  state[1][lane] += b;
+  state[2][lane] += c;
+  state[3][lane] += d;
+  state[4][lane] += e;
+}
+
+#ifdef USE_SHA1_BATCH_X86
+
+// The vector implementations only differ in the register type and
+// intrinsics, so the rounds are shared through the SHA1_V* macros
+// defined before each implementation. The message words are gathered
+// lane by lane as the blocks are at unrelated addresses.
+
+#define SHA1_VROTL(x, n) SHA1_VOR(SHA1_VSLLI(x, n), SHA1_VSRLI(x, 32 - n))
+
+#define SHA1_VROUNDS(first, last, fexpr, k)                             \
+  for (int t = first; t < last; t++) {                                  \
+    SHA1_VTYPE wt;                                                      \
+                                                                        \
+    if (t < 16)                                                         \
+      wt = SHA1_VLOAD(t);                                               \
+    else                                                                \
+      wt = SHA1_VROTL(SHA1_VXOR(SHA1_VXOR(w[(t - 3) & 15], w[(t - 8) & 15]), \
+                                SHA1_VXOR(w[(t - 14) & 15], w[(t - 16) & 15])), 1); \
+                                                                        \
+    w[t & 15] = wt;                                                     \
+                                                                        \
+    SHA1_VTYPE tmp = SHA1_VADD(SHA1_VADD(SHA1_VROTL(a, 5), fexpr),      \
+                               SHA1_VADD(SHA1_VADD(e, k), wt));         \
+    e = d;                                                              \
+    d = c;                                                              \
+    c = SHA1_VROTL(b, 30);                                              \
+    b = a;                                                              \
+    a = tmp;                                                            \
+  }
+
+#define SHA1_VCOMPRESS()                                                \
+  SHA1_VTYPE w[16];                                                     \
+  SHA1_VTYPE a = a0, b = b0, c = c0, d = d0, e = e0;                    \
+                                                                        \
+  SHA1_VROUNDS( 0, 20, SHA1_VOR(SHA1_VAND(b, c), SHA1_VANDNOT(b, d)), SHA1_VSET1(sha1_k[0])); \
+  SHA1_VROUNDS(20, 40, SHA1_VXOR(SHA1_VXOR(b, c), d), SHA1_VSET1(sha1_k[1])); \
+  SHA1_VROUNDS(40, 60, SHA1_VOR(SHA1_VAND(b, c), SHA1_VAND(d, SHA1_VOR(b, c))), SHA1_VSET1(sha1_k[2])); \
+  SHA1_VROUNDS(60, 80, SHA1_VXOR(SHA1_VXOR(b, c), d), SHA1_VSET1(sha1_k[3])); \
+                                                                        \
+  a = SHA1_VADD(a, a0);                                                 \
+  b = SHA1_VADD(b, b0);                                                 \
+  c = SHA1_VADD(c, c0);                                                 \
+  d = SHA1_VADD(d, d0);                                                 \
+  e = SHA1_VADD(e, e0);
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+#define SHA1_VTYPE         __m128i
+#define SHA1_VOR           _mm_or_si128
+#define SHA1_VXOR          _mm_xor_si128
+#define SHA1_VAND          _mm_and_si128
+#define SHA1_VANDNOT       _mm_andnot_si128
+#define SHA1_VADD          _mm_add_epi32
+#define SHA1_VSLLI         _mm_slli_epi32
+#define SHA1_VSRLI         _mm_srli_epi32
+#define SHA1_VSET1         _mm_set1_epi32
+#define SHA1_VLOAD(t)                                                   \
+  _mm_set_epi32(sha1_load_be32(blocks[3] + 4 * t), sha1_load_be32(blocks[2] + 4 * t), \
+                sha1_load_be32(blocks[1] + 4 * t), sha1_load_be32(blocks[0] + 4 * t))
+
+static void
+sha1_compress_x4(sha1_state_type* state, unsigned int first, const uint8_t* const* blocks) {
+  __m128i a0 = _mm_loadu_si128((const __m128i*)&state[0][first]);
+  __m128i b0 = _mm_loadu_si128((const __m128i*)&state[1][first]);
+  __m128i c0 = _mm_loadu_si128((const __m128i*)&state[2][first]);
+  __m128i d0 = _mm_loadu_si128((const __m128i*)&state[3][first]);
+  __m128i e0 = _mm_loadu_si128((const __m128i*)&state[4][first]);
+
+  SHA1_VCOMPRESS();
+
+  _mm_storeu_si128((__m128i*)&state[0][first], a);
+  _mm_storeu_si128((__m128i*)&state[1][first], b);
+  _mm_storeu_si128((__m128i*)&state[2][first], c);
+  _mm_storeu_si128((__m128i*)&state[3][first], d);
+  _mm_storeu_si128((__m128i*)&state[4][first], e);
+}
+
+#undef SHA1_VTYPE
+#undef SHA1_VOR
+#undef SHA1_VXOR
+#undef SHA1_VAND
+#undef SHA1_VANDNOT
+#undef SHA1_VADD
+#undef SHA1_VSLLI
+#undef SHA1_VSRLI
+#undef SHA1_VSET1
+#undef SHA1_VLOAD
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#define SHA1_VTYPE         __m256i
+#define SHA1_VOR           _mm256_or_si256
+#define SHA1_VXOR          _mm256_xor_si256
+#define SHA1_VAND          _mm256_and_si256
+#define SHA1_VANDNOT       _mm256_andnot_si256
+#define SHA1_VADD          _mm256_add_epi32
+#define SHA1_VSLLI         _mm256_slli_epi32
+#define SHA1_VSRLI         _mm256_srli_epi32
+#define SHA1_VSET1         _mm256_set1_epi32
+#define SHA1_VLOAD(t)                                                   \
+  _mm256_set_epi32(sha1_load_be32(blocks[7] + 4 * t), sha1_load_be32(blocks[6] + 4 * t), \
+                   sha1_load_be32(blocks[5] + 4 * t), sha1_load_be32(blocks[4] + 4 * t), \
+                   sha1_load_be32(blocks[3] + 4 * t), sha1_load_be32(blocks[2] + 4 * t), \
+                   sha1_load_be32(blocks[1] + 4 * t), sha1_load_be32(blocks[0] + 4 * t))
+
+static void
+sha1_compress_x8(sha1_state_type* state, const uint8_t* const* blocks) {
+  __m256i a0 = _mm256_loadu_si256((const __m256i*)state[0]);
+  __m256i b0 = _mm256_loadu_si256((const __m256i*)state[1]);
+  __m256i c0 = _mm256_loadu_si256((const __m256i*)state[2]);
+  __m256i d0 = _mm256_loadu_si256((const __m256i*)state[3]);
+  __m256i e0 = _mm256_loadu_si256((const __m256i*)state[4]);
+
+  SHA1_VCOMPRESS();
+
+  _mm256_storeu_si256((__m256i*)state[0], a);
+  _mm256_storeu_si256((__m256i*)state[1], b);
+  _mm256_storeu_si256((__m256i*)state[2], c);
+  _mm256_storeu_si256((__m256i*)state[3], d);
+  _mm256_storeu_si256((__m256i*)state[4], e);
+}
+
+#undef SHA1_VTYPE
+#undef SHA1_VOR
+#undef SHA1_VXOR
+#undef SHA1_VAND
+#undef SHA1_VANDNOT
+#undef SHA1_VADD
+#undef SHA1_VSLLI
+#undef SHA1_VSRLI
+#undef SHA1_VSET1
+#undef SHA1_VLOAD
+
+#pragma GCC pop_options
+
+// OpenSSL uses the SHA extensions when available, which beats the
+// multi-lane version, so only use the latter with OpenSSL's SHA1 if
+// the CPU lacks them.
+static unsigned int
+sha1_detect_lanes() {
+  __builtin_cpu_init();
+
+#ifdef USE_OPENSSL_SHA
+  unsigned int eax, ebx, ecx, edx;
+
+  if (__get_cpuid_max(0, NULL) >= 7) {
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    if (ebx & (1 << 29))
+      return 1;
+  }
+#endif
+
+  if (__builtin_cpu_supports("avx2"))
+    return 8;
+  else if (__builtin_cpu_supports("sse2"))
+    return 4;
+  else
+    return 1;
+}
+
+#endif // USE_SHA1_BATCH_X86
+
+unsigned int
+Sha1Batch::lane_count() {
+#ifdef USE_SHA1_BATCH_X86
+  static unsigned int lanes = sha1_detect_lanes();
+  return lanes;
+#else
+  return 1;
+#endif
+}
+
+void
+Sha1Batch::init(unsigned int lanes) {
+  if (lanes == 0 || lanes > max_lanes)
+    throw internal_error("Sha1Batch::init(...) received an invalid lane count.");
+
+  m_size = lanes;
+
+  for (unsigned int i = 0; i < max_lanes; i++) {
+    m_state[0][i] = 0x67452301;
+    m_state[1][i] = 0xefcdab89;
+    m_state[2][i] = 0x98badcfe;
+    m_state[3][i] = 0x10325476;
+    m_state[4][i] = 0xc3d2e1f0;
+
+    m_bufferSize[i] = 0;
+    m_length[i] = 0;
+  }
+}
+
+void
+Sha1Batch::update(const char* const* data, const uint32_t* length) {
+  const uint8_t* position[max_lanes];
+  uint32_t       left[max_lanes];
+
+  for (unsigned int i = 0; i < m_size; i++) {
+    position[i] = (const uint8_t*)data[i];
+    left[i] = length[i];
+    m_length[i] += length[i];
+  }
+
+  while (true) {
+    const uint8_t* blocks[max_lanes];
+    uint32_t       active = 0;
+
+    for (unsigned int i = 0; i < m_size; i++) {
+      if (m_bufferSize[i] != 0) {
+        // Fill up the partial block left by the previous call before
+        // reading directly from the span.
+        uint32_t l = std::min(block_size - m_bufferSize[i], left[i]);
+
+        std::memcpy(m_buffer[i] + m_bufferSize[i], position[i], l);
+        m_bufferSize[i] += l;
+        position[i] += l;
+        left[i] -= l;
+
+        if (m_bufferSize[i] != block_size)
+          continue;
+
+        blocks[i] = m_buffer[i];
+        m_bufferSize[i] = 0;
+
+      } else if (left[i] >= block_size) {
+        blocks[i] = position[i];
+        position[i] += block_size;
+        left[i] -= block_size;
+
+      } else {
+        continue;
+      }
+
+      active |= 1 << i;
+    }
+
+    if (active == 0)
+      break;
+
+    compress(blocks, active);
+  }
+
+  for (unsigned int i = 0; i < m_size; i++) {
+    std::memcpy(m_buffer[i] + m_bufferSize[i], position[i], left[i]);
+    m_bufferSize[i] += left[i];
+  }
+}
+
+void
+Sha1Batch::final_c(unsigned int lane, char* buffer) {
+  if (lane >= m_size)
+    throw internal_error("Sha1Batch::final_c(...) received an invalid lane.");
+
+  uint8_t* block = m_buffer[lane];
+  uint32_t size = m_bufferSize[lane];
+  uint64_t bits = m_length[lane] << 3;
+
+  block[size++] = 0x80;
+
+  if (size > block_size - 8) {
+    std::memset(block + size, 0, block_size - size);
+    sha1_compress_lane(m_state, lane, block);
+    size = 0;
+  }
+
+  std::memset(block + size, 0, block_size - 8 - size);
+
+  for (int i = 0; i < 8; i++)
+    block[block_size - 8 + i] = bits >> (56 - 8 * i);
+
+  sha1_compress_lane(m_state, lane, block);
+  m_bufferSize[lane] = 0;
+
+  for (int i = 0; i < 5; i++) {
+    buffer[4 * i + 0] = m_state[i][lane] >> 24;
+    buffer[4 * i + 1] = m_state[i][lane] >> 16;
+    buffer[4 * i + 2] = m_state[i][lane] >> 8;
+    buffer[4 * i + 3] = m_state[i][lane];
+  }
+}
+
+// Lanes not in 'active' are given a dummy block and have their state
+// restored afterwards, single active lanes use the scalar version.
+void
+Sha1Batch::compress(const uint8_t* const* blocks, uint32_t active) {
+#ifdef USE_SHA1_BATCH_X86
+  unsigned int lanes = lane_count();
+
+  if (lanes > 1 && (active & (active - 1)) != 0) {
+    static const uint8_t dummy[block_size] = { 0 };
+
+    const uint8_t* vecBlocks[max_lanes];
+    uint32_t       saved[5][max_lanes];
+
+    std::memcpy(saved, m_state, sizeof(saved));
+
+    for (unsigned int i = 0; i < max_lanes; i++)
+      vecBlocks[i] = active & (1 << i) ? blocks[i] : dummy;
+
+    if (lanes == 8) {
+      sha1_compress_x8(m_state, vecBlocks);
+
+    } else {
+      if (active & 0x0f)
+        sha1_compress_x4(m_state, 0, vecBlocks);
+
+      if (active & 0xf0)
+        sha1_compress_x4(m_state, 4, vecBlocks + 4);
+    }
+
+    for (unsigned int i = 0; i < max_lanes; i++)
+      if (!(active & (1 << i)))
+        for (int j = 0; j < 5; j++)
+          m_state[j][i] = saved[j][i];
+
+    return;
+  }
+#endif
+
+  for (unsigned int i = 0; i < m_size; i++)
+    if (active & (1 << i))
+      sha1_compress_lane(m_state, i, blocks[i]);
+}
+
+}
@@ -0,0 +1,84 @@
+// libTorrent - BitTorrent library
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#ifndef LIBTORRENT_UTILS_SHA1_BATCH_H
+#define LIBTORRENT_UTILS_SHA1_BATCH_H
+
+#include <inttypes.h>
+
+namespace torrent {
+
+// Computes the SHA1 digest of several independent streams at once,
+// with each stream in its own lane of a SIMD register. The lane count
+// depends on what the CPU supports, 8 lanes with AVX2 and 4 with SSE2.
+//
+// If lane_count() is 1 there is no vector implementation available,
+// or the CPU has the SHA extensions, and the caller should use the
+// regular Sha1 class instead.
+
+class Sha1Batch {
+public:
+  static const unsigned int max_lanes  = 8;
+  static const unsigned int block_size = 64;
+
+  static unsigned int lane_count();
+
+  unsigned int        size() const                     { return m_size; }
+
+  void                init(unsigned int lanes);
+
+  // Each lane consumes the whole of its span, with partial blocks
+  // buffered until the next call. Lanes without any more data should
+  // pass a zero length.
+  void                update(const char* const* data, const uint32_t* length);
+
+  void                final_c(unsigned int lane, char* buffer);
+
+private:
+  void                compress(const uint8_t* const* blocks, uint32_t active);
+
+  uint32_t            m_state[5][max_lanes];
+
+  uint8_t             m_buffer[max_lanes][block_size];
+  uint32_t            m_bufferSize[max_lanes];
+  uint64_t            m_length[max_lanes];
+
+  unsigned int        m_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "config.h"
+
+#include <cstring>
+
+#include "torrent/data/piece.h"
+
+#include "block_cache_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BlockCacheTest);
+
+#define CHUNK_LIST(i) reinterpret_cast<torrent::ChunkList*>(m_chunkLists + (i))
+
+void
+BlockCacheTest::setUp() {
+  static const int prot = torrent::MemoryChunk::prot_read | torrent::MemoryChunk::prot_write;
+
+  char* ptr = torrent::MemoryChunk::allocate_buffer(chunk_size);
+  CPPUNIT_ASSERT(ptr != NULL);
+
+  for (uint32_t i = 0; i < chunk_size; i++)
+    ptr[i] = i % 251;
+
+  m_chunk = new torrent::Chunk;
+  m_chunk->push_back(torrent::ChunkPart::MAPPED_BUFFER, torrent::MemoryChunk(ptr, ptr, ptr + chunk_size, prot, 0));
+}
+
+void
+BlockCacheTest::tearDown() {
+  m_cache.erase(CHUNK_LIST(0));
+  m_cache.erase(CHUNK_LIST(1));
+
+  delete m_chunk;
+}
+
+torrent::BlockCacheEntry*
+BlockCacheTest::insert_block(uint32_t index, uint32_t offset) {
+  return m_cache.insert(CHUNK_LIST(0), torrent::Piece(index, offset, block_size), m_chunk);
+}
+
+bool
+BlockCacheTest::has_block(uint32_t index, uint32_t offset) {
+  torrent::BlockCacheEntry* entry = m_cache.find(CHUNK_LIST(0), torrent::Piece(index, offset, block_size));
+
+  if (entry == NULL)
+    return false;
+
+  m_cache.release(entry);
+  return true;
+}
+
+void
+BlockCacheTest::test_disabled() {
+  CPPUNIT_ASSERT(!m_cache.is_enabled());
+  CPPUNIT_ASSERT(insert_block(0, 0) == NULL);
+  CPPUNIT_ASSERT(m_cache.size() == 0);
+
+  m_cache.set_max_memory_usage(block_size / 2);
+
+  // Blocks larger than the whole cache are never inserted.
+  CPPUNIT_ASSERT(m_cache.is_enabled());
+  CPPUNIT_ASSERT(insert_block(0, 0) == NULL);
+}
+
+void
+BlockCacheTest::test_find() {
+  m_cache.set_max_memory_usage(4 * block_size);
+
+  torrent::BlockCacheEntry* entry = insert_block(0, 2048);
+
+  CPPUNIT_ASSERT(entry != NULL);
+  CPPUNIT_ASSERT(entry->index() == 0 && entry->offset() == 2048 && entry->length() == block_size);
+  CPPUNIT_ASSERT(std::memcmp(entry->data(), m_chunk->begin()->chunk().begin() + 2048, block_size) == 0);
+  CPPUNIT_ASSERT(entry->at_offset(2048 + 10) == entry->data() + 10);
+  CPPUNIT_ASSERT(m_cache.memory_usage() == block_size);
+
+  m_cache.release(entry);
+
+  // Only exact matches of chunk list, index, offset and length hit.
+  CPPUNIT_ASSERT(m_cache.find(CHUNK_LIST(0), torrent::Piece(0, 2048, block_size)) == entry);
+  CPPUNIT_ASSERT(m_cache.find(CHUNK_LIST(0), torrent::Piece(0, 2048, block_size / 2)) == NULL);
+  CPPUNIT_ASSERT(m_cache.find(CHUNK_LIST(0), torrent::Piece(1, 2048, block_size)) == NULL);
+  CPPUNIT_ASSERT(m_cache.find(CHUNK_LIST(1), torrent::Piece(0, 2048, block_size)) == NULL);
+
+  CPPUNIT_ASSERT(m_cache.stats_hits() == 1);
+  CPPUNIT_ASSERT(m_cache.stats_misses() == 3);
+
+  m_cache.release(entry);
+}
+
+void
+BlockCacheTest::test_segmented_lru() {
+  m_cache.set_max_memory_usage(4 * block_size);
+
+  for (uint32_t i = 0; i < 4; i++)
+    m_cache.release(insert_block(i, 0));
+
+  CPPUNIT_ASSERT(m_cache.size() == 4);
+
+  // A hit moves block 0 to the protected segment, so the new blocks
+  // push out the other blocks that were only requested once.
+  CPPUNIT_ASSERT(has_block(0, 0));
+
+  m_cache.release(insert_block(4, 0));
+  m_cache.release(insert_block(5, 0));
+
+  CPPUNIT_ASSERT(m_cache.size() == 4);
+  CPPUNIT_ASSERT(m_cache.memory_usage() == 4 * block_size);
+
+  CPPUNIT_ASSERT(!has_block(1, 0));
+  CPPUNIT_ASSERT(!has_block(2, 0));
+  CPPUNIT_ASSERT(has_block(0, 0));
+  CPPUNIT_ASSERT(has_block(3, 0));
+  CPPUNIT_ASSERT(has_block(5, 0));
+
+  // Shrinking the cache evicts down to the new limit.
+  m_cache.set_max_memory_usage(2 * block_size);
+
+  CPPUNIT_ASSERT(m_cache.size() == 2);
+  CPPUNIT_ASSERT(m_cache.memory_usage() == 2 * block_size);
+}
+
+void
+BlockCacheTest::test_pinned() {
+  m_cache.set_max_memory_usage(2 * block_size);
+
+  torrent::BlockCacheEntry* entry0 = insert_block(0, 0);
+  torrent::BlockCacheEntry* entry1 = insert_block(1, 0);
+  torrent::BlockCacheEntry* entry2 = insert_block(2, 0);
+
+  // Pinned entries can't be evicted, so the cache may go over the
+  // limit until they are released.
+  CPPUNIT_ASSERT(entry0 != NULL && entry1 != NULL && entry2 != NULL);
+  CPPUNIT_ASSERT(m_cache.size() == 3);
+  CPPUNIT_ASSERT(m_cache.memory_usage() == 3 * block_size);
+
+  m_cache.release(entry0);
+
+  CPPUNIT_ASSERT(m_cache.memory_usage() == 2 * block_size);
+  CPPUNIT_ASSERT(!has_block(0, 0));
+
+  m_cache.release(entry1);
+  m_cache.release(entry2);
+
+  CPPUNIT_ASSERT(m_cache.size() == 2);
+}
+
+void
+BlockCacheTest::test_erase() {
+  m_cache.set_max_memory_usage(8 * block_size);
+
+  m_cache.release(insert_block(0, 0));
+  m_cache.release(insert_block(0, 1024));
+  m_cache.release(insert_block(1, 0));
+  m_cache.release(m_cache.insert(CHUNK_LIST(1), torrent::Piece(0, 0, block_size), m_chunk));
+
+  torrent::BlockCacheEntry* pinned = m_cache.find(CHUNK_LIST(0), torrent::Piece(0, 1024, block_size));
+
+  // Erasing a chunk that is about to be written leaves pinned entries
+  // valid until released, but they can no longer be found.
+  m_cache.erase(CHUNK_LIST(0), 0);
+
+  CPPUNIT_ASSERT(m_cache.size() == 2);
+  CPPUNIT_ASSERT(!has_block(0, 0));
+  CPPUNIT_ASSERT(!has_block(0, 1024));
+  CPPUNIT_ASSERT(has_block(1, 0));
+
+  CPPUNIT_ASSERT(std::memcmp(pinned->data(), m_chunk->begin()->chunk().begin() + 1024, block_size) == 0);
+  CPPUNIT_ASSERT(m_cache.memory_usage() == 3 * block_size);
+
+  m_cache.release(pinned);
+  CPPUNIT_ASSERT(m_cache.memory_usage() == 2 * block_size);
+
+  // Closing a chunk list only erases its own blocks.
+  m_cache.erase(CHUNK_LIST(0));
+
+  torrent::BlockCacheEntry* other = m_cache.find(CHUNK_LIST(1), torrent::Piece(0, 0, block_size));
+
+  CPPUNIT_ASSERT(m_cache.size() == 1);
+  CPPUNIT_ASSERT(other != NULL);
+
+  m_cache.release(other);
+}
@@ -0,0 +1,37 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "data/block_cache.h"
+#include "data/chunk.h"
+
+class BlockCacheTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(BlockCacheTest);
+  CPPUNIT_TEST(test_disabled);
+  CPPUNIT_TEST(test_find);
+  CPPUNIT_TEST(test_segmented_lru);
+  CPPUNIT_TEST(test_pinned);
+  CPPUNIT_TEST(test_erase);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const uint32_t chunk_size = 16384;
+  static const uint32_t block_size = 1024;
+
+  void setUp();
+  void tearDown();
+
+  void test_disabled();
+  void test_find();
+  void test_segmented_lru();
+  void test_pinned();
+  void test_erase();
+
+private:
+  torrent::BlockCacheEntry* insert_block(uint32_t index, uint32_t offset);
+  bool                      has_block(uint32_t index, uint32_t offset);
+
+  torrent::Chunk*     m_chunk;
+  torrent::BlockCache m_cache;
+
+  // Only used as keys, never dereferenced by the cache.
+  int                 m_chunkLists[2];
+};
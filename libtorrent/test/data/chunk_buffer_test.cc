@@ -0,0 +1,162 @@
+#include "config.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "chunk_buffer_test.h"
+
+#include "data/chunk_iterator.h"
+#include "data/memory_chunk.h"
+#include "data/socket_file.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ChunkBufferTest);
+
+static inline char
+pattern_at(uint32_t pos) {
+  return (char)(pos * 7 + 1);
+}
+
+// Build a chunk of two buffered parts over one file, the second part
+// starting 8 KiB into the file.
+void
+ChunkBufferTest::setUp() {
+  static const int prot = torrent::MemoryChunk::prot_read | torrent::MemoryChunk::prot_write;
+
+  std::strcpy(m_path, "/tmp/libtorrent_chunk_buffer_XXXXXX");
+  m_fd = mkstemp(m_path);
+
+  CPPUNIT_ASSERT(m_fd != -1);
+  CPPUNIT_ASSERT(ftruncate(m_fd, file_size) == 0);
+
+  m_file = new torrent::File();
+  m_file->set_file_descriptor(m_fd);
+  m_file->set_protection(prot);
+
+  torrent::SocketFile socketFile(m_fd);
+
+  m_chunk = new torrent::Chunk();
+  m_chunk->push_back(torrent::ChunkPart::MAPPED_BUFFER, socketFile.create_buffer(0, 8192, prot), m_file, 0);
+  m_chunk->push_back(torrent::ChunkPart::MAPPED_BUFFER, socketFile.create_buffer(8192, 4096, prot), m_file, 8192);
+
+  CPPUNIT_ASSERT(m_chunk->is_all_valid() && m_chunk->is_buffered() && m_chunk->is_writable());
+}
+
+void
+ChunkBufferTest::tearDown() {
+  delete m_chunk;
+
+  m_file->set_file_descriptor(-1);
+  delete m_file;
+
+  close(m_fd);
+  unlink(m_path);
+}
+
+// Check that the file holds the pattern in [first, last) and zeroes
+// elsewhere.
+bool
+ChunkBufferTest::verify_file(uint32_t first, uint32_t last) {
+  char buffer[file_size];
+
+  if (pread(m_fd, buffer, file_size, 0) != (ssize_t)file_size)
+    return false;
+
+  for (uint32_t pos = 0; pos < file_size; pos++)
+    if (buffer[pos] != (pos >= first && pos < last ? pattern_at(pos) : 0))
+      return false;
+
+  return true;
+}
+
+// Mimics PeerConnectionBase::down_chunk, reading from a pipe straight
+// into the chunk's memory with readv.
+void
+ChunkBufferTest::test_download_sync() {
+  uint32_t first = 1000;
+  uint32_t last = 11000;
+
+  char source[file_size];
+  int pipeFd[2];
+
+  for (uint32_t pos = first; pos < last; pos++)
+    source[pos - first] = pattern_at(pos);
+
+  CPPUNIT_ASSERT(pipe(pipeFd) == 0);
+  CPPUNIT_ASSERT(write(pipeFd[1], source, last - first) == (ssize_t)(last - first));
+
+  iovec vec[4];
+  iovec* vecLast = vec;
+  torrent::ChunkIterator itr(m_chunk, first, last);
+
+  do {
+    torrent::Chunk::data_type data = itr.data();
+
+    vecLast->iov_base = data.first;
+    vecLast->iov_len = data.second;
+    vecLast++;
+  } while (itr.next());
+
+  CPPUNIT_ASSERT(std::distance(vec, vecLast) == 2);
+  CPPUNIT_ASSERT(readv(pipeFd[0], vec, std::distance(vec, vecLast)) == (ssize_t)(last - first));
+
+  close(pipeFd[0]);
+  close(pipeFd[1]);
+
+  m_chunk->mark_dirty(first, last - first);
+
+  CPPUNIT_ASSERT(m_chunk->begin()->is_dirty() && (m_chunk->begin() + 1)->is_dirty());
+  CPPUNIT_ASSERT(m_chunk->sync(torrent::MemoryChunk::sync_sync));
+  CPPUNIT_ASSERT(!m_chunk->begin()->is_dirty() && !(m_chunk->begin() + 1)->is_dirty());
+
+  CPPUNIT_ASSERT(verify_file(first, last));
+}
+
+void
+ChunkBufferTest::test_from_buffer_sync() {
+  char source[256];
+
+  for (uint32_t pos = 8100; pos < 8100 + 256; pos++)
+    source[pos - 8100] = pattern_at(pos);
+
+  // A write straddling both parts must mark both dirty.
+  CPPUNIT_ASSERT(m_chunk->from_buffer(source, 8100, 256));
+  CPPUNIT_ASSERT(m_chunk->sync(torrent::MemoryChunk::sync_async));
+
+  CPPUNIT_ASSERT(verify_file(8100, 8100 + 256));
+}
+
+// Only the modified ranges may be written back, else a sync would
+// overwrite data written to the file since the buffer was read.
+void
+ChunkBufferTest::test_dirty_ranges() {
+  char source[file_size];
+
+  for (uint32_t pos = 0; pos < file_size; pos++)
+    source[pos] = pattern_at(pos);
+
+  CPPUNIT_ASSERT(pwrite(m_fd, source, 512, 0) == 512);
+  CPPUNIT_ASSERT(pwrite(m_fd, source + 8192, 512, 8192) == 512);
+
+  CPPUNIT_ASSERT(m_chunk->from_buffer(source + 1000, 1000, 100));
+  CPPUNIT_ASSERT(m_chunk->from_buffer(source + 9000, 9000, 100));
+  CPPUNIT_ASSERT(m_chunk->from_buffer(source + 9100, 9100, 100));
+
+  typedef torrent::ChunkPart::dirty_ranges::value_type range_type;
+
+  CPPUNIT_ASSERT(m_chunk->begin()->dirty().size() == 1);
+  CPPUNIT_ASSERT((m_chunk->begin() + 1)->dirty().size() == 1);
+  CPPUNIT_ASSERT((m_chunk->begin() + 1)->dirty().front() == range_type(9000 - 8192, 9200 - 8192));
+
+  CPPUNIT_ASSERT(m_chunk->sync(torrent::MemoryChunk::sync_async));
+
+  char buffer[file_size];
+  CPPUNIT_ASSERT(pread(m_fd, buffer, file_size, 0) == (ssize_t)file_size);
+
+  for (uint32_t pos = 0; pos < file_size; pos++) {
+    bool written = pos < 512 || (pos >= 8192 && pos < 8192 + 512) || (pos >= 1000 && pos < 1100) || (pos >= 9000 && pos < 9200);
+
+    CPPUNIT_ASSERT(buffer[pos] == (written ? pattern_at(pos) : 0));
+  }
+}
@@ -0,0 +1,31 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "data/chunk.h"
+#include "torrent/data/file.h"
+
+class ChunkBufferTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(ChunkBufferTest);
+  CPPUNIT_TEST(test_download_sync);
+  CPPUNIT_TEST(test_from_buffer_sync);
+  CPPUNIT_TEST(test_dirty_ranges);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const uint32_t file_size = 16384;
+
+  void setUp();
+  void tearDown();
+
+  void test_download_sync();
+  void test_from_buffer_sync();
+  void test_dirty_ranges();
+
+private:
+  bool verify_file(uint32_t first, uint32_t last);
+
+  char               m_path[64];
+  int                m_fd;
+
+  torrent::File*     m_file;
+  torrent::Chunk*    m_chunk;
+};
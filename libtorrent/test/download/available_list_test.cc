@@ -0,0 +1,149 @@
+#include "config.h"
+
+#include <cstdlib>
+#include <set>
+
+#include "available_list_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AvailableListTest);
+
+static rak::socket_address
+make_address(uint32_t address, uint16_t port) {
+  rak::socket_address sa;
+  sa.sa_inet()->clear();
+  sa.sa_inet()->set_address_h(address);
+  sa.sa_inet()->set_port(port);
+
+  return sa;
+}
+
+static uint64_t
+address_key(const rak::socket_address& sa) {
+  return ((uint64_t)sa.sa_inet()->address_h() << 16) | sa.port();
+}
+
+// Both the list and the index must agree with the reference set.
+static bool
+verify_list(const torrent::AvailableList& list, const std::set<uint64_t>& reference) {
+  if (list.size() != reference.size())
+    return false;
+
+  std::set<uint64_t> found;
+
+  for (torrent::AvailableList::const_iterator itr = list.begin(), last = list.end(); itr != last; ++itr)
+    if (!list.has(*itr) || !found.insert(address_key(*itr)).second)
+      return false;
+
+  return found == reference;
+}
+
+void
+AvailableListTest::test_basic() {
+  torrent::AvailableList list;
+
+  rak::socket_address sa1 = make_address(0x0a000001, 6881);
+  rak::socket_address sa2 = make_address(0x0a000001, 6882);
+  rak::socket_address sa3 = make_address(0x0a000002, 6881);
+
+  CPPUNIT_ASSERT(!list.has(sa1));
+
+  list.push_back(&sa1);
+  list.push_back(&sa2);
+  list.push_back(&sa1);
+
+  CPPUNIT_ASSERT(list.size() == 2);
+  CPPUNIT_ASSERT(list.has(sa1) && list.has(sa2) && !list.has(sa3));
+
+  list.erase(sa1);
+  list.erase(sa3);
+
+  CPPUNIT_ASSERT(list.size() == 1);
+  CPPUNIT_ASSERT(!list.has(sa1) && list.has(sa2));
+
+  list.pop_back();
+
+  CPPUNIT_ASSERT(list.empty() && !list.has(sa2));
+
+  list.push_back(&sa3);
+  list.clear();
+
+  CPPUNIT_ASSERT(list.empty() && !list.has(sa3));
+
+  list.push_back(&sa3);
+  CPPUNIT_ASSERT(list.size() == 1 && list.has(sa3));
+}
+
+void
+AvailableListTest::test_insert() {
+  torrent::AvailableList list;
+  torrent::AddressList addresses;
+
+  for (uint32_t i = 0; i < 300; i++)
+    addresses.push_back(make_address(0x0a000000 + i % 200, 6881));
+
+  list.set_max_size(1000);
+  list.insert(&addresses);
+
+  CPPUNIT_ASSERT(list.size() == 200);
+
+  for (uint32_t i = 0; i < 200; i++)
+    CPPUNIT_ASSERT(list.has(make_address(0x0a000000 + i, 6881)));
+
+  // Inserting is skipped once the fuzzy limit is exceeded.
+  list.set_max_size(100);
+  addresses.clear();
+  addresses.push_back(make_address(0x0b000000, 6881));
+  list.insert(&addresses);
+
+  CPPUNIT_ASSERT(list.size() == 200);
+}
+
+void
+AvailableListTest::test_random() {
+  torrent::AvailableList list;
+  std::set<uint64_t> reference;
+
+  std::srand(0);
+
+  // Few distinct addresses and ports so that duplicates, probing
+  // collisions and the shifting on erase are all exercised while the
+  // table grows.
+  for (unsigned int i = 0; i < 50000; i++) {
+    rak::socket_address sa = make_address(0x0a000000 + std::rand() % 512, 6881 + std::rand() % 8);
+
+    switch (std::rand() % 5) {
+    case 0:
+    case 1:
+      list.push_back(&sa);
+      reference.insert(address_key(sa));
+      break;
+
+    case 2:
+      list.erase(sa);
+      reference.erase(address_key(sa));
+      break;
+
+    case 3:
+      if (list.empty())
+        break;
+
+      reference.erase(address_key(list.pop_random()));
+      break;
+
+    case 4:
+      if (list.empty())
+        break;
+
+      reference.erase(address_key(list.back()));
+      list.pop_back();
+      break;
+    }
+
+    CPPUNIT_ASSERT(list.has(sa) == (reference.find(address_key(sa)) != reference.end()));
+
+    if (i % 1000 == 0)
+      CPPUNIT_ASSERT(verify_list(list, reference));
+  }
+
+  CPPUNIT_ASSERT(verify_list(list, reference));
+}
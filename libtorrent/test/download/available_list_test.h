@@ -0,0 +1,19 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "download/available_list.h"
+
+class AvailableListTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(AvailableListTest);
+  CPPUNIT_TEST(test_basic);
+  CPPUNIT_TEST(test_insert);
+  CPPUNIT_TEST(test_random);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+  void test_basic();
+  void test_insert();
+  void test_random();
+};
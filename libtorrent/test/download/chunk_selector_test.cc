@@ -0,0 +1,126 @@
+#include "config.h"
+
+#include "globals.h"
+#include "torrent/bitfield.h"
+
+#include "chunk_selector_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ChunkSelectorTest);
+
+void
+ChunkSelectorTest::setUp() {
+  m_savedTime = torrent::cachedTime;
+  torrent::cachedTime = rak::timer::from_seconds(1000);
+  m_now = torrent::cachedTime.usec();
+
+  torrent::Bitfield completed;
+  completed.set_size_bits(chunk_count);
+  completed.allocate();
+  completed.unset_all();
+
+  m_statistics = new torrent::ChunkStatistics;
+  m_statistics->initialize(chunk_count);
+
+  m_selector = new torrent::ChunkSelector;
+  m_selector->initialize(&completed, m_statistics);
+  m_selector->normal_priority()->insert(0, chunk_count);
+  m_selector->update_priorities();
+
+  // Playback is at the start of chunk 2 and consumes a chunk each
+  // second.
+  m_selector->set_stream(2 * chunk_size, chunk_size, chunk_size);
+}
+
+void
+ChunkSelectorTest::tearDown() {
+  for (std::vector<torrent::PeerChunks*>::iterator itr = m_peers.begin(); itr != m_peers.end(); ++itr)
+    delete *itr;
+
+  m_peers.clear();
+
+  delete m_selector;
+  delete m_statistics;
+
+  torrent::cachedTime = m_savedTime;
+}
+
+// The peer has every chunk and downloads at 'rate' bytes per second.
+torrent::PeerChunks*
+ChunkSelectorTest::connect_peer(uint32_t rate) {
+  torrent::PeerChunks* pc = new torrent::PeerChunks;
+
+  pc->bitfield()->set_size_bits(chunk_count);
+  pc->bitfield()->allocate();
+  pc->bitfield()->set_all();
+
+  pc->download_throttle()->rate()->insert((uint64_t)rate * pc->download_throttle()->rate()->span());
+
+  m_peers.push_back(pc);
+  return pc;
+}
+
+void
+ChunkSelectorTest::test_chunk_deadline() {
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(1) == torrent::ChunkSelector::no_deadline);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(2) == m_now);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(3) == m_now + 1000000);
+
+  // Only chunks due within the horizon are time-critical.
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(12) == m_now + torrent::ChunkSelector::stream_horizon);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(13) == torrent::ChunkSelector::no_deadline);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(chunk_count) == torrent::ChunkSelector::no_deadline);
+
+  // Once playback has moved past a chunk it has no deadline.
+  torrent::cachedTime += rak::timer::from_seconds(1);
+
+  CPPUNIT_ASSERT(m_selector->stream_position() == 3 * chunk_size);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(2) == torrent::ChunkSelector::no_deadline);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(3) == m_now + 1000000);
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(13) == m_now + 11 * 1000000);
+
+  m_selector->set_stream(0, 0, 0);
+
+  CPPUNIT_ASSERT(!m_selector->is_streaming());
+  CPPUNIT_ASSERT(m_selector->chunk_deadline(3) == torrent::ChunkSelector::no_deadline);
+}
+
+// The earliest chunk that is wanted, prioritized and that the peer
+// has is picked.
+void
+ChunkSelectorTest::test_find_deadline() {
+  torrent::PeerChunks* pc = connect_peer(0);
+
+  CPPUNIT_ASSERT(m_selector->find_deadline(pc) == 2);
+
+  m_selector->using_index(2);
+  pc->bitfield()->unset(3);
+
+  CPPUNIT_ASSERT(m_selector->find_deadline(pc) == 4);
+
+  m_selector->normal_priority()->clear();
+  m_selector->normal_priority()->insert(5, chunk_count);
+  m_selector->update_priorities();
+
+  CPPUNIT_ASSERT(m_selector->find_deadline(pc) == 5);
+
+  // Nothing beyond the horizon is returned.
+  pc->bitfield()->unset_all();
+  pc->bitfield()->set(13);
+
+  CPPUNIT_ASSERT(m_selector->find_deadline(pc) == torrent::ChunkSelector::invalid_chunk);
+
+  m_selector->set_stream(0, 0, 0);
+  pc->bitfield()->set_all();
+
+  CPPUNIT_ASSERT(m_selector->find_deadline(pc) == torrent::ChunkSelector::invalid_chunk);
+}
+
+// Peers that can't download a chunk before its deadline, or within
+// 'stream_slack' for the most urgent ones, skip to later chunks.
+void
+ChunkSelectorTest::test_find_deadline_slow_peer() {
+  CPPUNIT_ASSERT(m_selector->find_deadline(connect_peer(chunk_size)) == 2);
+  CPPUNIT_ASSERT(m_selector->find_deadline(connect_peer(chunk_size / 2)) == 2);
+  CPPUNIT_ASSERT(m_selector->find_deadline(connect_peer(chunk_size / 4)) == 6);
+  CPPUNIT_ASSERT(m_selector->find_deadline(connect_peer(chunk_size / 16)) == torrent::ChunkSelector::invalid_chunk);
+}
@@ -0,0 +1,38 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+#include <rak/timer.h>
+
+#include "download/chunk_selector.h"
+#include "download/chunk_statistics.h"
+#include "protocol/peer_chunks.h"
+
+class ChunkSelectorTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(ChunkSelectorTest);
+  CPPUNIT_TEST(test_chunk_deadline);
+  CPPUNIT_TEST(test_find_deadline);
+  CPPUNIT_TEST(test_find_deadline_slow_peer);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const uint32_t chunk_count = 16;
+  static const uint32_t chunk_size  = 1 << 20;
+
+  void setUp();
+  void tearDown();
+
+  void test_chunk_deadline();
+  void test_find_deadline();
+  void test_find_deadline_slow_peer();
+
+private:
+  torrent::PeerChunks* connect_peer(uint32_t rate);
+
+  rak::timer                         m_savedTime;
+  int64_t                            m_now;
+
+  torrent::ChunkStatistics*          m_statistics;
+  torrent::ChunkSelector*            m_selector;
+
+  std::vector<torrent::PeerChunks*>  m_peers;
+};
@@ -0,0 +1,264 @@
+#include "config.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "torrent/bitfield.h"
+
+#include "chunk_statistics_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ChunkStatisticsTest);
+
+void
+ChunkStatisticsTest::setUp() {
+  std::srand(0);
+
+  m_statistics.initialize(chunk_count);
+  m_active.assign(chunk_count, true);
+}
+
+void
+ChunkStatisticsTest::tearDown() {
+  while (!m_peers.empty())
+    disconnect_peer(m_peers.back());
+
+  m_statistics.clear();
+}
+
+// The pattern has an 'x' for each chunk the peer has, and is
+// repeated to fill the bitfield.
+torrent::PeerChunks*
+ChunkStatisticsTest::connect_peer(const char* pattern) {
+  torrent::PeerChunks* pc = new torrent::PeerChunks;
+  size_t length = std::strlen(pattern);
+
+  pc->bitfield()->set_size_bits(chunk_count);
+  pc->bitfield()->allocate();
+  pc->bitfield()->unset_all();
+
+  for (uint32_t i = 0; i < chunk_count; i++)
+    if (pattern[i % length] == 'x')
+      pc->bitfield()->set(i);
+
+  m_statistics.received_connect(pc);
+  m_peers.push_back(pc);
+
+  return pc;
+}
+
+torrent::PeerChunks*
+ChunkStatisticsTest::connect_random_peer() {
+  char pattern[chunk_count + 1];
+
+  for (uint32_t i = 0; i < chunk_count; i++)
+    pattern[i] = std::rand() % 3 == 0 ? 'x' : '.';
+
+  pattern[chunk_count] = '\0';
+  return connect_peer(pattern);
+}
+
+void
+ChunkStatisticsTest::disconnect_peer(torrent::PeerChunks* pc) {
+  m_statistics.received_disconnect(pc);
+
+  m_peers.erase(std::find(m_peers.begin(), m_peers.end(), pc));
+  delete pc;
+}
+
+// Every active chunk must be in exactly one bucket, the one matching
+// its rarity, and inactive chunks in none.
+bool
+ChunkStatisticsTest::verify_buckets() {
+  std::vector<int> seen(chunk_count, 0);
+
+  for (uint32_t r = 0; r <= torrent::ChunkStatistics::max_accounted; r++) {
+    if (m_statistics.rarity_first(r) > m_statistics.rarity_last(r))
+      return false;
+
+    for (uint32_t pos = m_statistics.rarity_first(r); pos != m_statistics.rarity_last(r); pos++) {
+      uint32_t index = m_statistics.rarity_order(pos);
+
+      if (m_statistics.rarity(index) != r || !m_active[index])
+        return false;
+
+      seen[index]++;
+    }
+  }
+
+  for (uint32_t i = 0; i < chunk_count; i++)
+    if (seen[i] != (int)m_active[i] || m_statistics.is_active(i) != m_active[i])
+      return false;
+
+  return true;
+}
+
+void
+ChunkStatisticsTest::test_rarity_order() {
+  CPPUNIT_ASSERT(verify_buckets());
+  CPPUNIT_ASSERT(m_statistics.rarity_last(0) - m_statistics.rarity_first(0) == chunk_count);
+
+  connect_peer("xx..");
+  connect_peer("x...");
+  torrent::PeerChunks* pc = connect_peer("xxx.");
+
+  CPPUNIT_ASSERT(verify_buckets());
+  CPPUNIT_ASSERT(m_statistics.accounted() == 3);
+
+  // Walking the order from the start gives the rarest chunks first.
+  for (uint32_t r = 0; r < 4; r++)
+    CPPUNIT_ASSERT(m_statistics.rarity_last(r) - m_statistics.rarity_first(r) == chunk_count / 4);
+
+  CPPUNIT_ASSERT(m_statistics.rarity(m_statistics.rarity_order(0)) == 0);
+  CPPUNIT_ASSERT(m_statistics.rarity(m_statistics.rarity_order(chunk_count - 1)) == 3);
+
+  m_statistics.received_have_chunk(pc, 3, 1);
+  CPPUNIT_ASSERT(m_statistics.rarity(3) == 1);
+  CPPUNIT_ASSERT(verify_buckets());
+
+  disconnect_peer(pc);
+  CPPUNIT_ASSERT(m_statistics.rarity(2) == 0 && m_statistics.rarity(3) == 0);
+  CPPUNIT_ASSERT(verify_buckets());
+
+  // Seeders are only counted as complete.
+  connect_peer("x");
+  CPPUNIT_ASSERT(m_statistics.complete() == 1);
+  CPPUNIT_ASSERT(m_statistics.rarity(0) == 2);
+  CPPUNIT_ASSERT(verify_buckets());
+}
+
+void
+ChunkStatisticsTest::test_active() {
+  connect_peer("xx..");
+  torrent::PeerChunks* pc = connect_peer("x...");
+
+  // Inactive chunks keep their counts but are skipped by the order.
+  for (uint32_t i = 0; i < chunk_count; i += 2) {
+    m_statistics.deactivate(i);
+    m_active[i] = false;
+  }
+
+  CPPUNIT_ASSERT(verify_buckets());
+  CPPUNIT_ASSERT(m_statistics.rarity_last(torrent::ChunkStatistics::max_accounted) == chunk_count / 2);
+
+  m_statistics.deactivate(0);
+  CPPUNIT_ASSERT(verify_buckets());
+
+  m_statistics.received_have_chunk(pc, 2, 1);
+  CPPUNIT_ASSERT(m_statistics.rarity(2) == 1);
+  CPPUNIT_ASSERT(verify_buckets());
+
+  disconnect_peer(pc);
+  CPPUNIT_ASSERT(m_statistics.rarity(0) == 1 && m_statistics.rarity(2) == 0);
+  CPPUNIT_ASSERT(verify_buckets());
+
+  for (uint32_t i = 0; i < chunk_count; i += 4) {
+    m_statistics.activate(i);
+    m_active[i] = true;
+  }
+
+  m_statistics.activate(4);
+  CPPUNIT_ASSERT(verify_buckets());
+}
+
+void
+ChunkStatisticsTest::test_set_active() {
+  for (uint32_t i = 0; i < 20; i++)
+    connect_random_peer();
+
+  torrent::Bitfield bitfield;
+  bitfield.set_size_bits(chunk_count);
+  bitfield.allocate();
+  bitfield.unset_all();
+
+  m_statistics.set_active(&bitfield);
+  m_active.assign(chunk_count, false);
+
+  CPPUNIT_ASSERT(verify_buckets());
+  CPPUNIT_ASSERT(m_statistics.rarity_last(torrent::ChunkStatistics::max_accounted) == 0);
+
+  for (uint32_t i = 0; i < chunk_count; i += 3) {
+    bitfield.set(i);
+    m_active[i] = true;
+  }
+
+  m_statistics.set_active(&bitfield);
+  CPPUNIT_ASSERT(verify_buckets());
+
+  bitfield.set_all();
+  m_active.assign(chunk_count, true);
+
+  m_statistics.set_active(&bitfield);
+  CPPUNIT_ASSERT(verify_buckets());
+}
+
+void
+ChunkStatisticsTest::test_random() {
+  for (unsigned int i = 0; i < 20000; i++) {
+    switch (std::rand() % 6) {
+    case 0:
+      if (m_peers.size() < 50)
+        connect_random_peer();
+      break;
+
+    case 1:
+      if (!m_peers.empty())
+        disconnect_peer(m_peers[std::rand() % m_peers.size()]);
+      break;
+
+    case 2:
+    {
+      if (m_peers.empty())
+        break;
+
+      torrent::PeerChunks* pc = m_peers[std::rand() % m_peers.size()];
+      uint32_t index = std::rand() % chunk_count;
+
+      if (pc->using_counter() && !pc->bitfield()->get(index))
+        m_statistics.received_have_chunk(pc, index, 1);
+      break;
+    }
+
+    case 3:
+    {
+      uint32_t index = std::rand() % chunk_count;
+
+      m_statistics.deactivate(index);
+      m_active[index] = false;
+      break;
+    }
+
+    case 4:
+    {
+      uint32_t index = std::rand() % chunk_count;
+
+      m_statistics.activate(index);
+      m_active[index] = true;
+      break;
+    }
+
+    case 5:
+    {
+      if (std::rand() % 50 != 0)
+        break;
+
+      torrent::Bitfield bitfield;
+      bitfield.set_size_bits(chunk_count);
+      bitfield.allocate();
+      bitfield.unset_all();
+
+      for (uint32_t j = 0; j < chunk_count; j++)
+        if ((m_active[j] = std::rand() % 2))
+          bitfield.set(j);
+
+      m_statistics.set_active(&bitfield);
+      break;
+    }
+    }
+
+    if (i % 100 == 0)
+      CPPUNIT_ASSERT(verify_buckets());
+  }
+
+  CPPUNIT_ASSERT(verify_buckets());
+}
@@ -0,0 +1,37 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include "download/chunk_statistics.h"
+#include "protocol/peer_chunks.h"
+
+class ChunkStatisticsTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(ChunkStatisticsTest);
+  CPPUNIT_TEST(test_rarity_order);
+  CPPUNIT_TEST(test_active);
+  CPPUNIT_TEST(test_set_active);
+  CPPUNIT_TEST(test_random);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const uint32_t chunk_count = 64;
+
+  void setUp();
+  void tearDown();
+
+  void test_rarity_order();
+  void test_active();
+  void test_set_active();
+  void test_random();
+
+private:
+  torrent::PeerChunks* connect_peer(const char* pattern);
+  torrent::PeerChunks* connect_random_peer();
+  void                 disconnect_peer(torrent::PeerChunks* pc);
+
+  bool                 verify_buckets();
+
+  torrent::ChunkStatistics           m_statistics;
+  std::vector<bool>                  m_active;
+  std::vector<torrent::PeerChunks*>  m_peers;
+};
@@ -0,0 +1,218 @@
+#include "config.h"
+
+#include <cstring>
+#include <netinet/in.h>
+
+#include "globals.h"
+#include "torrent/data/block.h"
+#include "torrent/data/block_list.h"
+#include "torrent/data/block_transfer.h"
+#include "torrent/peer/peer_info.h"
+
+#include "delegator_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DelegatorTest);
+
+void
+DelegatorTest::setUp() {
+  m_savedTime = torrent::cachedTime;
+  torrent::cachedTime = rak::timer::from_seconds(1000);
+  m_now = torrent::cachedTime.usec();
+
+  torrent::Bitfield completed;
+  completed.set_size_bits(chunk_count);
+  completed.allocate();
+  completed.unset_all();
+
+  // Nothing is prioritized, so peers are never given new chunks and
+  // fall through to the endgame.
+  m_statistics = new torrent::ChunkStatistics;
+  m_statistics->initialize(chunk_count);
+
+  m_selector = new torrent::ChunkSelector;
+  m_selector->initialize(&completed, m_statistics);
+
+  m_delegator = new torrent::Delegator;
+  m_delegator->set_aggressive(true);
+  m_delegator->slot_chunk_find(rak::make_mem_fun(m_selector, &torrent::ChunkSelector::find));
+
+  m_delegator->transfer_list()->slot_queued(std::bind1st(std::mem_fun(&torrent::ChunkSelector::using_index), m_selector));
+  m_delegator->transfer_list()->slot_canceled(std::bind1st(std::mem_fun(&torrent::ChunkSelector::not_using_index), m_selector));
+}
+
+void
+DelegatorTest::tearDown() {
+  for (std::vector<torrent::BlockTransfer*>::iterator itr = m_transfers.begin(); itr != m_transfers.end(); ++itr)
+    torrent::Block::release(*itr);
+
+  m_transfers.clear();
+  m_delegator->transfer_list()->clear();
+
+  for (std::vector<torrent::PeerChunks*>::iterator itr = m_peers.begin(); itr != m_peers.end(); ++itr) {
+    delete (*itr)->peer_info();
+    delete *itr;
+  }
+
+  m_peers.clear();
+
+  delete m_delegator;
+  delete m_selector;
+  delete m_statistics;
+
+  torrent::cachedTime = m_savedTime;
+}
+
+// The peer has every chunk but the last and downloads at 'rate'
+// bytes per second.
+torrent::PeerChunks*
+DelegatorTest::connect_peer(uint32_t rate) {
+  sockaddr_in sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(6881 + m_peers.size());
+
+  torrent::PeerChunks* pc = new torrent::PeerChunks;
+  pc->set_peer_info(new torrent::PeerInfo(reinterpret_cast<sockaddr*>(&sa)));
+
+  pc->bitfield()->set_size_bits(chunk_count);
+  pc->bitfield()->allocate();
+  pc->bitfield()->set_all();
+  pc->bitfield()->unset(chunk_count - 1);
+
+  pc->download_throttle()->rate()->insert((uint64_t)rate * pc->download_throttle()->rate()->span());
+
+  m_peers.push_back(pc);
+  return pc;
+}
+
+// Chunks are a single block.
+torrent::Block*
+DelegatorTest::insert_chunk(uint32_t index) {
+  torrent::TransferList::iterator itr =
+    m_delegator->transfer_list()->insert(torrent::Piece(index, 0, torrent::Delegator::block_size), torrent::Delegator::block_size);
+
+  (*itr)->set_priority(torrent::PRIORITY_NORMAL);
+  return &*(*itr)->begin();
+}
+
+torrent::BlockTransfer*
+DelegatorTest::queue_transfer(torrent::Block* block, torrent::PeerChunks* pc, int64_t requested, int64_t expected) {
+  torrent::BlockTransfer* transfer = block->insert(pc->peer_info());
+
+  transfer->set_request_time(requested);
+  transfer->set_expected_time(expected);
+
+  m_transfers.push_back(transfer);
+  return transfer;
+}
+
+torrent::BlockTransfer*
+DelegatorTest::delegate(torrent::PeerChunks* pc) {
+  torrent::BlockTransfer* transfer = m_delegator->delegate(pc, -1);
+
+  if (transfer != NULL)
+    m_transfers.push_back(transfer);
+
+  return transfer;
+}
+
+// Only blocks predicted to be late get duplicated, on peers predicted
+// to finish in less than half the time left. Peers without a rate
+// only get blocks that are already late.
+void
+DelegatorTest::test_endgame_late() {
+  torrent::Block* block = insert_chunk(0);
+
+  queue_transfer(block, connect_peer(0), m_now, m_now + 4 * 1000000);
+
+  CPPUNIT_ASSERT(delegate(connect_peer(0)) == NULL);
+
+  torrent::PeerChunks* fast = connect_peer(1 << 20);
+  torrent::BlockTransfer* duplicate = delegate(fast);
+
+  CPPUNIT_ASSERT(duplicate != NULL && duplicate->block() == block);
+  CPPUNIT_ASSERT(m_delegator->transfer_list()->duplicated_count() == 1);
+
+  // The duplicate is expected within 16 ms, which another peer at
+  // the same rate can't beat by half.
+  duplicate->set_request_time(m_now);
+  duplicate->set_expected_time(m_now + 16 * 1000);
+
+  CPPUNIT_ASSERT(delegate(connect_peer(1 << 20)) == NULL);
+
+  // A transfer overdue by more than its own expected duration is
+  // late, and may go to any peer.
+  torrent::Block* lateBlock = insert_chunk(1);
+  queue_transfer(lateBlock, connect_peer(0), m_now - 10 * 1000000, m_now - 8 * 1000000);
+
+  torrent::BlockTransfer* late = delegate(connect_peer(0));
+
+  CPPUNIT_ASSERT(late != NULL && late->block() == lateBlock);
+  CPPUNIT_ASSERT(m_delegator->transfer_list()->duplicated_count() == 2);
+
+  // Chunks the peer doesn't have are skipped.
+  torrent::Block* missing = insert_chunk(chunk_count - 1);
+  queue_transfer(missing, connect_peer(0), m_now - 10 * 1000000, m_now - 8 * 1000000);
+
+  CPPUNIT_ASSERT(delegate(connect_peer(0)) == NULL);
+}
+
+// Stalled transfers don't count towards the peers on a block.
+void
+DelegatorTest::test_endgame_max_peers() {
+  torrent::Block* block = insert_chunk(0);
+  torrent::BlockTransfer* first = NULL;
+
+  for (unsigned int i = 0; i < torrent::Delegator::endgame_max_peers; i++) {
+    torrent::BlockTransfer* transfer = queue_transfer(block, connect_peer(0), m_now - 10 * 1000000, m_now - 8 * 1000000);
+
+    if (first == NULL)
+      first = transfer;
+  }
+
+  torrent::PeerChunks* fast = connect_peer(1 << 20);
+
+  CPPUNIT_ASSERT(delegate(fast) == NULL);
+
+  torrent::Block::stalled(first);
+
+  torrent::BlockTransfer* duplicate = delegate(fast);
+
+  CPPUNIT_ASSERT(duplicate != NULL && duplicate->block() == block);
+  CPPUNIT_ASSERT(block->size_not_stalled() == torrent::Delegator::endgame_max_peers);
+
+  // Never twice on the same peer.
+  torrent::Block::stalled(duplicate);
+
+  CPPUNIT_ASSERT(delegate(fast) == NULL);
+  CPPUNIT_ASSERT(m_delegator->transfer_list()->duplicated_count() == 1);
+}
+
+// Once a transfer leads, queued duplicates not predicted to finish
+// before it are cancelled.
+void
+DelegatorTest::test_cancel_duplicates() {
+  torrent::Block* block = insert_chunk(0);
+
+  torrent::BlockTransfer* slow = queue_transfer(block, connect_peer(0), m_now, m_now + 4 * 1000000);
+  torrent::BlockTransfer* quick = queue_transfer(block, connect_peer(0), m_now, m_now + 10 * 1000);
+
+  torrent::PeerChunks* unknown = connect_peer(0);
+  torrent::BlockTransfer* leader = queue_transfer(block, unknown, m_now, 0);
+
+  // Nothing is cancelled for a leader without a rate.
+  CPPUNIT_ASSERT(block->transfering(leader));
+  m_delegator->cancel_duplicates(unknown, leader);
+
+  CPPUNIT_ASSERT(block->queued()->size() == 2);
+  CPPUNIT_ASSERT(m_delegator->transfer_list()->cancelled_count() == 0);
+
+  unknown->download_throttle()->rate()->insert((uint64_t)(1 << 20) * unknown->download_throttle()->rate()->span());
+  m_delegator->cancel_duplicates(unknown, leader);
+
+  CPPUNIT_ASSERT(!slow->is_valid());
+  CPPUNIT_ASSERT(quick->is_valid() && quick->is_queued());
+  CPPUNIT_ASSERT(block->queued()->size() == 1);
+  CPPUNIT_ASSERT(block->size_not_stalled() == 2);
+  CPPUNIT_ASSERT(m_delegator->transfer_list()->cancelled_count() == 1);
+}
@@ -0,0 +1,44 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+#include <rak/timer.h>
+
+#include "download/chunk_selector.h"
+#include "download/chunk_statistics.h"
+#include "download/delegator.h"
+#include "protocol/peer_chunks.h"
+
+class DelegatorTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(DelegatorTest);
+  CPPUNIT_TEST(test_endgame_late);
+  CPPUNIT_TEST(test_endgame_max_peers);
+  CPPUNIT_TEST(test_cancel_duplicates);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const uint32_t chunk_count = 4;
+
+  void setUp();
+  void tearDown();
+
+  void test_endgame_late();
+  void test_endgame_max_peers();
+  void test_cancel_duplicates();
+
+private:
+  torrent::PeerChunks*    connect_peer(uint32_t rate);
+  torrent::Block*         insert_chunk(uint32_t index);
+
+  torrent::BlockTransfer* queue_transfer(torrent::Block* block, torrent::PeerChunks* pc, int64_t requested, int64_t expected);
+  torrent::BlockTransfer* delegate(torrent::PeerChunks* pc);
+
+  rak::timer                            m_savedTime;
+  int64_t                               m_now;
+
+  torrent::ChunkStatistics*             m_statistics;
+  torrent::ChunkSelector*               m_selector;
+  torrent::Delegator*                   m_delegator;
+
+  std::vector<torrent::PeerChunks*>     m_peers;
+  std::vector<torrent::BlockTransfer*>  m_transfers;
+};
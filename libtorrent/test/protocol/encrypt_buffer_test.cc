@@ -0,0 +1,119 @@
+#include "config.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "encrypt_buffer_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(EncryptBufferTest);
+
+// Stream cipher stand-in, the key stream advances with every byte
+// like RC4 so bytes encrypted twice or skipped garble the output.
+struct test_cipher {
+  test_cipher() : m_position(0) {}
+
+  uint8_t next() { uint32_t p = m_position++; return (p * 31 + (p >> 8)) & 0xff; }
+
+  uint32_t m_position;
+};
+
+struct test_encrypt {
+  test_encrypt(test_cipher* c, const uint8_t* s) : m_cipher(c), m_source(s) {}
+
+  void operator () (uint32_t offset, uint8_t* dest, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++)
+      dest[i] = m_source[offset + i] ^ m_cipher->next();
+  }
+
+  test_cipher*   m_cipher;
+  const uint8_t* m_source;
+};
+
+void
+EncryptBufferTest::setUp() {
+  std::srand(0);
+
+  m_buffer = new buffer_type;
+  m_buffer->reset();
+}
+
+void
+EncryptBufferTest::tearDown() {
+  delete m_buffer;
+}
+
+// Sends 'pieces' consecutive pieces the way PeerConnectionBase does,
+// staging before each write and consuming what the socket took, then
+// checks that the decrypted stream matches the pieces.
+bool
+EncryptBufferTest::upload_pieces(uint32_t pieces, uint32_t maxWrite) {
+  std::vector<uint8_t> plain(pieces * piece_size);
+  std::vector<uint8_t> sent;
+
+  for (uint32_t i = 0; i < plain.size(); i++)
+    plain[i] = std::rand();
+
+  test_cipher cipher;
+
+  for (uint32_t piece = 0; piece < pieces; piece++) {
+    uint32_t position = piece * piece_size;
+    uint32_t last = position + piece_size;
+
+    while (position != last) {
+      uint32_t quota = std::min<uint32_t>(1 + std::rand() % (2 * buffer_size), last - position);
+
+      iovec vec;
+      torrent::encrypt_buffer_stage(m_buffer, quota, test_encrypt(&cipher, &plain[position]), &vec);
+
+      uint8_t* first = static_cast<uint8_t*>(vec.iov_base);
+
+      if (vec.iov_len == 0 || vec.iov_len > quota ||
+          first < m_buffer->begin() || first + vec.iov_len > m_buffer->begin() + buffer_size)
+        return false;
+
+      uint32_t written = std::min<uint32_t>(vec.iov_len, maxWrite == 0 ? vec.iov_len : 1 + std::rand() % maxWrite);
+
+      sent.insert(sent.end(), first, first + written);
+      m_buffer->consume(written);
+
+      position += written;
+    }
+  }
+
+  if (sent.size() != plain.size())
+    return false;
+
+  test_cipher decrypt;
+
+  for (uint32_t i = 0; i < sent.size(); i++)
+    if ((sent[i] ^ decrypt.next()) != plain[i])
+      return false;
+
+  return true;
+}
+
+void
+EncryptBufferTest::test_back_to_back_pieces() {
+  CPPUNIT_ASSERT(upload_pieces(2, 0));
+
+  // A whole piece fits the buffer exactly, so the second piece must
+  // be staged from the rewound buffer.
+  iovec vec;
+  std::vector<uint8_t> plain(2 * piece_size);
+  test_cipher cipher;
+
+  m_buffer->reset();
+
+  torrent::encrypt_buffer_stage(m_buffer, piece_size, test_encrypt(&cipher, &plain[0]), &vec);
+  CPPUNIT_ASSERT(vec.iov_base == m_buffer->begin() && vec.iov_len == piece_size);
+  m_buffer->consume(piece_size);
+
+  torrent::encrypt_buffer_stage(m_buffer, piece_size, test_encrypt(&cipher, &plain[piece_size]), &vec);
+  CPPUNIT_ASSERT(vec.iov_base == m_buffer->begin() && vec.iov_len == piece_size);
+}
+
+void
+EncryptBufferTest::test_partial_writes() {
+  CPPUNIT_ASSERT(upload_pieces(8, 1000));
+  CPPUNIT_ASSERT(upload_pieces(8, 20000));
+}
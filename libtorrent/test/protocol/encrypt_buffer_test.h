@@ -0,0 +1,27 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "protocol/encrypt_buffer.h"
+
+class EncryptBufferTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(EncryptBufferTest);
+  CPPUNIT_TEST(test_back_to_back_pieces);
+  CPPUNIT_TEST(test_partial_writes);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const uint32_t buffer_size = 16384;
+  static const uint32_t piece_size  = 16384;
+
+  typedef torrent::ProtocolBuffer<buffer_size> buffer_type;
+
+  void setUp();
+  void tearDown();
+
+  void test_back_to_back_pieces();
+  void test_partial_writes();
+
+private:
+  bool upload_pieces(uint32_t pieces, uint32_t maxWrite);
+
+  buffer_type*        m_buffer;
+};
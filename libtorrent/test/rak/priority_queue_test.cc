@@ -0,0 +1,133 @@
+#include "config.h"
+
+#include <cstdlib>
+
+#include "priority_queue_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PriorityQueueTest);
+
+void
+PriorityQueueTest::setUp() {
+  m_called = 0;
+  std::srand(0);
+
+  for (unsigned int i = 0; i < item_count; i++)
+    m_items[i].set_slot(rak::mem_fn(this, &PriorityQueueTest::receive_call));
+}
+
+void
+PriorityQueueTest::tearDown() {
+  for (unsigned int i = 0; i < item_count; i++)
+    rak::priority_queue_erase(&m_queue, m_items + i);
+}
+
+// Checks the heap ordering and that every item knows its position.
+bool
+PriorityQueueTest::verify_heap() {
+  for (rak::priority_queue_default::iterator itr = m_queue.begin(), last = m_queue.end(); itr != last; ++itr) {
+    size_t index = itr - m_queue.begin();
+
+    if ((*itr)->queue_index() != index)
+      return false;
+
+    if (index != 0 && (*itr)->time() < m_queue.begin()[(index - 1) / 2]->time())
+      return false;
+  }
+
+  return true;
+}
+
+void
+PriorityQueueTest::test_order() {
+  for (unsigned int i = 0; i < item_count; i++)
+    rak::priority_queue_insert(&m_queue, m_items + i, rak::timer(1 + std::rand() % 500));
+
+  CPPUNIT_ASSERT(m_queue.size() == item_count);
+  CPPUNIT_ASSERT(verify_heap());
+
+  rak::timer previous;
+
+  while (!m_queue.empty()) {
+    rak::priority_item* item = m_queue.top();
+
+    CPPUNIT_ASSERT(previous <= item->time());
+    previous = item->time();
+
+    m_queue.pop();
+    item->clear_time();
+
+    CPPUNIT_ASSERT(item->queue_index() == rak::priority_item::npos);
+    CPPUNIT_ASSERT(verify_heap());
+  }
+}
+
+void
+PriorityQueueTest::test_find() {
+  CPPUNIT_ASSERT(m_queue.find(m_items) == m_queue.end());
+
+  rak::priority_queue_insert(&m_queue, m_items + 0, rak::timer(10));
+  rak::priority_queue_insert(&m_queue, m_items + 1, rak::timer(5));
+
+  CPPUNIT_ASSERT(m_queue.find(m_items + 0) != m_queue.end() && *m_queue.find(m_items + 0) == m_items + 0);
+  CPPUNIT_ASSERT(m_queue.find(m_items + 1) != m_queue.end() && *m_queue.find(m_items + 1) == m_items + 1);
+  CPPUNIT_ASSERT(m_queue.find(m_items + 2) == m_queue.end());
+
+  // A stale index pointing at another item must not match.
+  m_items[2].set_queue_index(m_items[0].queue_index());
+  CPPUNIT_ASSERT(m_queue.find(m_items + 2) == m_queue.end());
+  m_items[2].set_queue_index(rak::priority_item::npos);
+
+  rak::priority_queue_erase(&m_queue, m_items + 1);
+
+  CPPUNIT_ASSERT(m_queue.find(m_items + 1) == m_queue.end());
+  CPPUNIT_ASSERT(m_queue.top() == m_items + 0);
+}
+
+void
+PriorityQueueTest::test_erase() {
+  for (unsigned int i = 0; i < item_count; i++)
+    rak::priority_queue_insert(&m_queue, m_items + i, rak::timer(1 + std::rand() % 500));
+
+  // Erase in random order, re-arming some of the items, as the
+  // scheduler does with timeouts.
+  for (unsigned int i = 0; i < 4 * item_count; i++) {
+    rak::priority_item* item = m_items + std::rand() % item_count;
+
+    if (item->is_queued()) {
+      rak::priority_queue_erase(&m_queue, item);
+
+      CPPUNIT_ASSERT(!item->is_queued());
+      CPPUNIT_ASSERT(m_queue.find(item) == m_queue.end());
+
+    } else {
+      rak::priority_queue_insert(&m_queue, item, rak::timer(1 + std::rand() % 500));
+    }
+
+    CPPUNIT_ASSERT(verify_heap());
+  }
+
+  unsigned int queued = 0;
+
+  for (unsigned int i = 0; i < item_count; i++)
+    queued += m_items[i].is_queued();
+
+  CPPUNIT_ASSERT(m_queue.size() == queued);
+}
+
+void
+PriorityQueueTest::test_perform() {
+  for (unsigned int i = 0; i < item_count; i++)
+    rak::priority_queue_insert(&m_queue, m_items + i, rak::timer(1 + i % 100));
+
+  rak::priority_queue_perform(&m_queue, rak::timer(50));
+
+  CPPUNIT_ASSERT(m_called == item_count / 2);
+  CPPUNIT_ASSERT(m_queue.size() == item_count / 2);
+  CPPUNIT_ASSERT(m_queue.top()->time() == rak::timer(51));
+  CPPUNIT_ASSERT(verify_heap());
+
+  rak::priority_queue_perform(&m_queue, rak::timer(100));
+
+  CPPUNIT_ASSERT(m_called == item_count);
+  CPPUNIT_ASSERT(m_queue.empty());
+}
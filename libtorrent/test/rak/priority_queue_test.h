@@ -0,0 +1,33 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "rak/priority_queue_default.h"
+
+class PriorityQueueTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(PriorityQueueTest);
+  CPPUNIT_TEST(test_order);
+  CPPUNIT_TEST(test_find);
+  CPPUNIT_TEST(test_erase);
+  CPPUNIT_TEST(test_perform);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  static const unsigned int item_count = 1000;
+
+  void setUp();
+  void tearDown();
+
+  void test_order();
+  void test_find();
+  void test_erase();
+  void test_perform();
+
+  void receive_call()  { m_called++; }
+
+private:
+  bool verify_heap();
+
+  rak::priority_queue_default m_queue;
+  rak::priority_item          m_items[item_count];
+
+  unsigned int                m_called;
+};
@@ -0,0 +1,155 @@
+#include "config.h"
+
+#include <cstdlib>
+
+#include "bitfield_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BitfieldTest);
+
+// Sizes and range ends around the byte and 64 bit word boundaries
+// used by the word-at-a-time code paths.
+static const torrent::Bitfield::size_type test_sizes[] = { 1, 7, 8, 9, 63, 64, 65, 127, 128, 129, 200, 515, 0 };
+
+static const torrent::Bitfield::size_type test_offsets[] = { 0, 1, 7, 8, 9, 63, 64, 65, 71, 72, 127, 128, 129, 191, 192, 193, 256, 300, 511, 512, 515, ~0u };
+
+static void
+bitfield_init(torrent::Bitfield* bitfield, torrent::Bitfield::size_type size, unsigned int seed) {
+  bitfield->set_size_bits(size);
+  bitfield->allocate();
+  bitfield->unset_all();
+
+  std::srand(seed);
+
+  for (torrent::Bitfield::size_type i = 0; i < size; i++)
+    if (std::rand() % 3 == 0)
+      bitfield->set(i);
+}
+
+static torrent::Bitfield::size_type
+bitfield_count_naive(const torrent::Bitfield& bitfield) {
+  torrent::Bitfield::size_type count = 0;
+
+  for (torrent::Bitfield::size_type i = 0; i < bitfield.size_bits(); i++)
+    count += bitfield.get(i);
+
+  return count;
+}
+
+void
+BitfieldTest::test_set_range() {
+  for (const torrent::Bitfield::size_type* size = test_sizes; *size != 0; size++)
+    for (const torrent::Bitfield::size_type* first = test_offsets; *first <= *size; first++)
+      for (const torrent::Bitfield::size_type* last = first; *last <= *size; last++) {
+        torrent::Bitfield bitfield;
+        torrent::Bitfield reference;
+
+        bitfield_init(&bitfield, *size, *first * 1000 + *last);
+        bitfield_init(&reference, *size, *first * 1000 + *last);
+
+        bitfield.set_range(*first, *last);
+
+        for (torrent::Bitfield::size_type i = 0; i < *size; i++)
+          CPPUNIT_ASSERT(bitfield.get(i) == (reference.get(i) || (i >= *first && i < *last)));
+
+        CPPUNIT_ASSERT(bitfield.size_set() == bitfield_count_naive(bitfield));
+        CPPUNIT_ASSERT(bitfield.is_tail_cleared());
+      }
+}
+
+void
+BitfieldTest::test_unset_range() {
+  for (const torrent::Bitfield::size_type* size = test_sizes; *size != 0; size++)
+    for (const torrent::Bitfield::size_type* first = test_offsets; *first <= *size; first++)
+      for (const torrent::Bitfield::size_type* last = first; *last <= *size; last++) {
+        torrent::Bitfield bitfield;
+        torrent::Bitfield reference;
+
+        bitfield_init(&bitfield, *size, *first * 1000 + *last);
+        bitfield_init(&reference, *size, *first * 1000 + *last);
+
+        bitfield.unset_range(*first, *last);
+
+        for (torrent::Bitfield::size_type i = 0; i < *size; i++)
+          CPPUNIT_ASSERT(bitfield.get(i) == (reference.get(i) && (i < *first || i >= *last)));
+
+        CPPUNIT_ASSERT(bitfield.size_set() == bitfield_count_naive(bitfield));
+      }
+}
+
+void
+BitfieldTest::test_count_range() {
+  for (const torrent::Bitfield::size_type* size = test_sizes; *size != 0; size++) {
+    torrent::Bitfield bitfield;
+    bitfield_init(&bitfield, *size, *size);
+
+    for (const torrent::Bitfield::size_type* first = test_offsets; *first <= *size; first++)
+      for (const torrent::Bitfield::size_type* last = first; *last <= *size; last++) {
+        torrent::Bitfield::size_type count = 0;
+
+        for (torrent::Bitfield::size_type i = *first; i < *last; i++)
+          count += bitfield.get(i);
+
+        CPPUNIT_ASSERT(bitfield.count_range(*first, *last) == count);
+      }
+
+    bitfield.set_all();
+    CPPUNIT_ASSERT(bitfield.count_range(0, *size) == *size);
+
+    bitfield.unset_all();
+    CPPUNIT_ASSERT(bitfield.count_range(0, *size) == 0);
+  }
+}
+
+void
+BitfieldTest::test_find_first_set() {
+  for (const torrent::Bitfield::size_type* size = test_sizes; *size != 0; size++) {
+    torrent::Bitfield bitfield;
+    bitfield.set_size_bits(*size);
+    bitfield.allocate();
+
+    // A single set bit at each boundary, searched for from every
+    // offset.
+    for (const torrent::Bitfield::size_type* bit = test_offsets; *bit < *size; bit++) {
+      bitfield.unset_all();
+      bitfield.set(*bit);
+
+      for (const torrent::Bitfield::size_type* first = test_offsets; *first <= *size; first++)
+        for (const torrent::Bitfield::size_type* last = first; *last <= *size; last++) {
+          torrent::Bitfield::size_type expected = *bit >= *first && *bit < *last ? *bit : *last;
+
+          CPPUNIT_ASSERT(bitfield.find_first_set(*first, *last) == expected);
+        }
+    }
+
+    bitfield.unset_all();
+    CPPUNIT_ASSERT(bitfield.find_first_set(0, *size) == *size);
+  }
+}
+
+void
+BitfieldTest::test_find_first_and_not() {
+  for (const torrent::Bitfield::size_type* size = test_sizes; *size != 0; size++) {
+    torrent::Bitfield bitfield;
+    torrent::Bitfield other;
+
+    bitfield_init(&bitfield, *size, *size);
+    bitfield_init(&other, *size, *size + 1);
+
+    for (const torrent::Bitfield::size_type* first = test_offsets; *first <= *size; first++)
+      for (const torrent::Bitfield::size_type* last = first; *last <= *size; last++) {
+        torrent::Bitfield::size_type expected = *first;
+
+        while (expected < *last && !(bitfield.get(expected) && !other.get(expected)))
+          expected++;
+
+        CPPUNIT_ASSERT(bitfield.find_first_and_not(other, *first, *last) == expected);
+      }
+
+    // Everything we have is also in 'other'.
+    other.set_all();
+    CPPUNIT_ASSERT(bitfield.find_first_and_not(other, 0, *size) == *size);
+
+    other.unset_all();
+    CPPUNIT_ASSERT(bitfield.find_first_and_not(other, 0, *size) == bitfield.find_first_set(0, *size));
+  }
+}
@@ -0,0 +1,23 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "torrent/bitfield.h"
+
+class BitfieldTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(BitfieldTest);
+  CPPUNIT_TEST(test_set_range);
+  CPPUNIT_TEST(test_unset_range);
+  CPPUNIT_TEST(test_count_range);
+  CPPUNIT_TEST(test_find_first_set);
+  CPPUNIT_TEST(test_find_first_and_not);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+  void test_set_range();
+  void test_unset_range();
+  void test_count_range();
+  void test_find_first_set();
+  void test_find_first_and_not();
+};
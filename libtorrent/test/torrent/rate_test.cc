@@ -0,0 +1,175 @@
+#include "config.h"
+
+#include "globals.h"
+#include "torrent/exceptions.h"
+
+#include "rate_test.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RateTest);
+
+static void
+set_time(uint32_t seconds) {
+  torrent::cachedTime = rak::timer::from_seconds(seconds);
+}
+
+void
+RateTest::setUp() {
+  m_savedTime = torrent::cachedTime;
+  set_time(1000);
+}
+
+void
+RateTest::tearDown() {
+  torrent::cachedTime = m_savedTime;
+}
+
+void
+RateTest::test_basic() {
+  torrent::Rate rate(10);
+
+  CPPUNIT_ASSERT(rate.span() == 10);
+  CPPUNIT_ASSERT(rate.rate() == 0);
+  CPPUNIT_ASSERT(rate.total() == 0);
+
+  rate.insert(1000);
+  rate.insert(500);
+
+  CPPUNIT_ASSERT(rate.rate() == 150);
+  CPPUNIT_ASSERT(rate.total() == 1500);
+
+  rate.set_total(100);
+  CPPUNIT_ASSERT(rate.total() == 100);
+
+  rate.reset_rate();
+  CPPUNIT_ASSERT(rate.rate() == 0);
+  CPPUNIT_ASSERT(rate.total() == 100);
+
+  bool caught = false;
+
+  try {
+    torrent::Rate invalid(0);
+  } catch (torrent::internal_error&) {
+    caught = true;
+  }
+
+  CPPUNIT_ASSERT(caught);
+}
+
+// With a span of 16 every bucket covers one second, so the rate
+// follows a sliding window exactly.
+void
+RateTest::test_window() {
+  torrent::Rate rate(16);
+
+  for (uint32_t i = 0; i < 16; i++) {
+    set_time(1000 + i);
+    rate.insert(160);
+  }
+
+  CPPUNIT_ASSERT(rate.rate() == 160);
+
+  for (uint32_t i = 1; i <= 16; i++) {
+    set_time(1015 + i);
+    CPPUNIT_ASSERT(rate.rate() == (16 - i) * 10);
+  }
+
+  // Wrapping around the ring many times keeps the sum consistent.
+  for (uint32_t i = 0; i < 100; i++) {
+    set_time(2000 + i);
+    rate.insert(32);
+  }
+
+  CPPUNIT_ASSERT(rate.rate() == 32);
+  CPPUNIT_ASSERT(rate.total() == 16 * 160 + 100 * 32);
+}
+
+void
+RateTest::test_idle() {
+  torrent::Rate rate(60);
+
+  rate.insert(6000);
+  CPPUNIT_ASSERT(rate.rate() == 100);
+
+  // Buckets are 4 seconds wide, so the data expires between one
+  // span and one span plus a bucket later.
+  set_time(1000 + 55);
+  CPPUNIT_ASSERT(rate.rate() == 100);
+
+  set_time(1000 + 64);
+  CPPUNIT_ASSERT(rate.rate() == 0);
+
+  // A long idle period only clears the buckets once.
+  rate.insert(600);
+  set_time(1000 + 1000000);
+
+  CPPUNIT_ASSERT(rate.rate() == 0);
+  CPPUNIT_ASSERT(rate.total() == 6600);
+}
+
+void
+RateTest::test_set_span() {
+  torrent::Rate rate(60);
+
+  rate.insert(6000);
+  CPPUNIT_ASSERT(rate.rate() == 100);
+
+  // The bytes in the window are kept when the span changes.
+  rate.set_span(30);
+
+  CPPUNIT_ASSERT(rate.span() == 30);
+  CPPUNIT_ASSERT(rate.rate() == 200);
+
+  set_time(1000 + 20);
+  rate.insert(3000);
+
+  CPPUNIT_ASSERT(rate.rate() == 300);
+
+  set_time(1000 + 32);
+  CPPUNIT_ASSERT(rate.rate() == 100);
+
+  set_time(1000 + 60);
+  CPPUNIT_ASSERT(rate.rate() == 0);
+
+  bool caught = false;
+
+  try {
+    rate.set_span(-1);
+  } catch (torrent::internal_error&) {
+    caught = true;
+  }
+
+  CPPUNIT_ASSERT(caught);
+}
+
+// The snapshots follow the last rate() or insert(...), and are not
+// decayed by time passing alone.
+void
+RateTest::test_snapshot() {
+  torrent::Rate rate(10);
+
+  CPPUNIT_ASSERT(rate.rate_snapshot() == 0);
+  CPPUNIT_ASSERT(rate.total_snapshot() == 0);
+
+  rate.insert(1000);
+
+  CPPUNIT_ASSERT(rate.rate_snapshot() == 100);
+  CPPUNIT_ASSERT(rate.total_snapshot() == 1000);
+
+  set_time(1000 + 20);
+  CPPUNIT_ASSERT(rate.rate_snapshot() == 100);
+
+  CPPUNIT_ASSERT(rate.rate() == 0);
+  CPPUNIT_ASSERT(rate.rate_snapshot() == 0);
+
+  rate.insert(500);
+  rate.set_span(5);
+
+  CPPUNIT_ASSERT(rate.rate_snapshot() == 100);
+
+  rate.set_total(42);
+  CPPUNIT_ASSERT(rate.total_snapshot() == 42);
+
+  rate.reset_rate();
+  CPPUNIT_ASSERT(rate.rate_snapshot() == 0);
+  CPPUNIT_ASSERT(rate.total_snapshot() == 42);
+}
@@ -0,0 +1,26 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "torrent/rate.h"
+
+class RateTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(RateTest);
+  CPPUNIT_TEST(test_basic);
+  CPPUNIT_TEST(test_window);
+  CPPUNIT_TEST(test_idle);
+  CPPUNIT_TEST(test_set_span);
+  CPPUNIT_TEST(test_snapshot);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+
+  void test_basic();
+  void test_window();
+  void test_idle();
+  void test_set_span();
+  void test_snapshot();
+
+private:
+  rak::timer          m_savedTime;
+};
@@ -37,6 +37,7 @@
 #include "config.h"
 
 #include <functional>
+#include <limits>
 #include <unistd.h>
 #include <cstdio>
 #include <rak/file_stat.h>
@@ -51,6 +52,7 @@
 #include <torrent/connection_manager.h>
 #include <torrent/data/file.h>
 #include <torrent/data/file_list.h>
+#include <torrent/data/transfer_list.h>
 #include <torrent/download/resource_manager.h>
 #include <torrent/peer/connection_list.h>
 #include <torrent/peer/peer_list.h>
@@ -248,6 +250,21 @@ apply_d_custom(core::Download* download, const torrent::Object::list_type& args)
   return torrent::Object();
 }
 
+torrent::Object
+apply_d_stream(core::Download* download, const torrent::Object::list_type& args) {
+  if (args.size() != 2)
+    throw torrent::input_error("Wrong argument count.");
+
+  int64_t position = args.front().as_value();
+  int64_t rate     = args.back().as_value();
+
+  if (position < 0 || rate < 0 || rate > std::numeric_limits<uint32_t>::max())
+    throw torrent::input_error("Invalid stream position or rate.");
+
+  download->download()->set_stream(position, rate);
+  return torrent::Object();
+}
+
 torrent::Object
 retrieve_d_custom(core::Download* download, const std::string& key) {
   try {
@@ -733,6 +750,15 @@ initialize_command_download() {
   CMD2_DL         ("d.peers_complete",      CMD2_ON_DL(peers_complete));
   CMD2_DL         ("d.peers_accounted",     CMD2_ON_DL(peers_accounted));
 
+  CMD2_DL         ("d.transfers.duplicated", std::bind(&torrent::TransferList::duplicated_count, std::bind(&torrent::Download::transfer_list, CMD2_BIND_DL)));
+  CMD2_DL         ("d.transfers.wasted",     std::bind(&torrent::TransferList::wasted_bytes, std::bind(&torrent::Download::transfer_list, CMD2_BIND_DL)));
+  CMD2_DL         ("d.transfers.dissimilar", std::bind(&torrent::TransferList::dissimilar_bytes, std::bind(&torrent::Download::transfer_list, CMD2_BIND_DL)));
+  CMD2_DL         ("d.transfers.cancelled",  std::bind(&torrent::TransferList::cancelled_count, std::bind(&torrent::Download::transfer_list, CMD2_BIND_DL)));
+
+  CMD2_DL         ("d.stream.position",     std::bind(&torrent::Download::stream_position, CMD2_BIND_DL));
+  CMD2_DL         ("d.stream.rate",         std::bind(&torrent::Download::stream_rate, CMD2_BIND_DL));
+  CMD2_DL_LIST    ("d.stream.set",          std::bind(&apply_d_stream, std::placeholders::_1, std::placeholders::_2));
+
   CMD2_DL         ("d.throttle_name",     std::bind(&download_get_variable, std::placeholders::_1, "rtorrent", "throttle_name"));
   CMD2_DL_STRING_V("d.throttle_name.set", std::bind(&core::Download::set_throttle_name, std::placeholders::_1, std::placeholders::_2));
 
@@ -48,6 +48,7 @@
 #include <torrent/chunk_manager.h>
 #include <torrent/data/file_manager.h>
 #include <torrent/data/chunk_utils.h>
+#include <torrent/object_pool.h>
 #include <torrent/utils/log_files.h>
 
 #include "core/download.h"
@@ -148,6 +149,28 @@ system_hostname() {
   return std::string(buffer);
 }
 
+torrent::Object
+system_object_pools() {
+  torrent::Object             resultRaw = torrent::Object::create_list();
+  torrent::Object::list_type& result = resultRaw.as_list();
+
+  const torrent::ObjectPool::list_type& pools = torrent::ObjectPool::pool_list();
+
+  for (torrent::ObjectPool::list_type::const_iterator itr = pools.begin(), last = pools.end(); itr != last; itr++) {
+    torrent::Object& pool = *result.insert(result.end(), torrent::Object::create_map());
+
+    pool.insert_key("name",        std::string((*itr)->name()));
+    pool.insert_key("object_size", (int64_t)(*itr)->object_size());
+    pool.insert_key("in_use",      (int64_t)(*itr)->in_use());
+    pool.insert_key("cached",      (int64_t)(*itr)->cached());
+    pool.insert_key("max_cached",  (int64_t)(*itr)->max_cached());
+    pool.insert_key("allocations", (int64_t)(*itr)->allocations());
+    pool.insert_key("reused",      (int64_t)(*itr)->reused());
+  }
+
+  return resultRaw;
+}
+
 torrent::Object
 system_get_cwd() {
   char* buffer = getcwd(NULL, 0);
@@ -307,6 +330,8 @@ initialize_command_local() {
   CMD2_ANY         ("system.hostname", std::bind(&system_hostname));
   CMD2_ANY         ("system.pid",      std::bind(&getpid));
 
+  CMD2_ANY         ("system.object_pools", std::bind(&system_object_pools));
+
   CMD2_VAR_C_STRING("system.client_version",        PACKAGE_VERSION);
   CMD2_VAR_C_STRING("system.library_version",       torrent::version());
   CMD2_VAR_VALUE   ("system.file.allocate",         0);
@@ -344,6 +369,15 @@ initialize_command_local() {
   CMD2_ANY_VALUE_V ("pieces.sync.timeout_safe.set",    std::bind(&CM_t::set_timeout_safe_sync, chunkManager, std::placeholders::_2));
   CMD2_ANY         ("pieces.sync.queue_size",          std::bind(&CM_t::sync_queue_size, chunkManager));
 
+  CMD2_ANY         ("pieces.storage.type",             std::bind(&CM_t::storage_type, chunkManager));
+  CMD2_ANY_VALUE_V ("pieces.storage.type.set",         std::bind(&CM_t::set_storage_type, chunkManager, std::placeholders::_2));
+  CMD2_ANY         ("pieces.storage.pool.current",     std::bind(&CM_t::buffer_pool_size, chunkManager));
+  CMD2_ANY         ("pieces.storage.pool.max",         std::bind(&CM_t::buffer_pool_max_size, chunkManager));
+  CMD2_ANY_VALUE_V ("pieces.storage.pool.max.set",     std::bind(&CM_t::set_buffer_pool_max_size, chunkManager, std::placeholders::_2));
+
+  CMD2_ANY         ("pieces.write_back",               std::bind(&CM_t::use_write_back, chunkManager));
+  CMD2_ANY_VALUE_V ("pieces.write_back.set",           std::bind(&CM_t::set_use_write_back, chunkManager, std::placeholders::_2));
+
   CMD2_ANY         ("pieces.preload.type",             std::bind(&CM_t::preload_type, chunkManager));
   CMD2_ANY_VALUE_V ("pieces.preload.type.set",         std::bind(&CM_t::set_preload_type, chunkManager, std::placeholders::_2));
   CMD2_ANY         ("pieces.preload.min_size",         std::bind(&CM_t::preload_min_size, chunkManager));
@@ -356,6 +390,11 @@ initialize_command_local() {
   CMD2_ANY         ("pieces.memory.block_count",       std::bind(&CM_t::memory_block_count, chunkManager));
   CMD2_ANY         ("pieces.memory.max",               std::bind(&CM_t::max_memory_usage, chunkManager));
   CMD2_ANY_VALUE_V ("pieces.memory.max.set",           std::bind(&CM_t::set_max_memory_usage, chunkManager, std::placeholders::_2));
+  CMD2_ANY         ("pieces.cache.current",            std::bind(&CM_t::block_cache_memory_usage, chunkManager));
+  CMD2_ANY         ("pieces.cache.max",                std::bind(&CM_t::block_cache_max_memory_usage, chunkManager));
+  CMD2_ANY_VALUE_V ("pieces.cache.max.set",            std::bind(&CM_t::set_block_cache_max_memory_usage, chunkManager, std::placeholders::_2));
+  CMD2_ANY         ("pieces.cache.hits",               std::bind(&CM_t::block_cache_hits, chunkManager));
+  CMD2_ANY         ("pieces.cache.misses",             std::bind(&CM_t::block_cache_misses, chunkManager));
   CMD2_ANY         ("pieces.stats_preloaded",          std::bind(&CM_t::stats_preloaded, chunkManager));
   CMD2_ANY         ("pieces.stats_not_preloaded",      std::bind(&CM_t::stats_not_preloaded, chunkManager));
 
@@ -369,6 +408,8 @@ initialize_command_local() {
   CMD2_VAR_STRING  ("session.name",            "");
   CMD2_VAR_BOOL    ("session.use_lock",        true);
   CMD2_VAR_BOOL    ("session.on_completion",   true);
+  CMD2_VAR_BOOL    ("session.fingerprint",     false);
+  CMD2_VAR_VALUE   ("session.load_threads",    4);
 
   CMD2_ANY         ("session.path",            std::bind(&core::DownloadStore::path, dStore));
   CMD2_ANY_STRING_V("session.path.set",        std::bind(&core::DownloadStore::set_path, dStore, std::placeholders::_2));
@@ -43,6 +43,7 @@
 #include <rak/path.h>
 #include <torrent/connection_manager.h>
 #include <torrent/dht_manager.h>
+#include <torrent/poll_epoll.h>
 #include <torrent/throttle.h>
 #include <torrent/tracker.h>
 #include <torrent/tracker_list.h>
@@ -64,6 +65,7 @@
 #include "globals.h"
 #include "control.h"
 #include "command_helpers.h"
+#include "thread_main.h"
 
 torrent::Object
 apply_throttle(const torrent::Object::list_type& args, bool up) {
@@ -609,6 +611,33 @@ apply_ipv4_filter_load(const torrent::Object::list_type& args) {
   return torrent::Object();
 }
 
+torrent::Object
+apply_poll_batch() {
+  return (int64_t)((main_thread->poll()->flags() & torrent::Poll::flag_batch_changes) != 0);
+}
+
+torrent::Object
+apply_poll_batch_set(int64_t state) {
+  torrent::Poll* poll = main_thread->poll();
+
+  if (state && dynamic_cast<torrent::PollEPoll*>(poll) == NULL)
+    throw torrent::input_error("Batching poll changes requires epoll.");
+
+  if (state)
+    poll->set_flags(poll->flags() | torrent::Poll::flag_batch_changes);
+  else
+    poll->set_flags(poll->flags() & ~torrent::Poll::flag_batch_changes);
+
+  return torrent::Object();
+}
+
+torrent::Object
+apply_poll_stats(uint64_t (torrent::PollEPoll::*stat)() const) {
+  torrent::PollEPoll* poll = dynamic_cast<torrent::PollEPoll*>(main_thread->poll());
+
+  return poll != NULL ? (int64_t)(poll->*stat)() : (int64_t)0;
+}
+
 void
 initialize_command_network() {
   torrent::ConnectionManager* cm = torrent::connection_manager();
@@ -626,6 +655,20 @@ initialize_command_network() {
   CMD2_VAR_BOOL    ("network.port_random", true);
   CMD2_VAR_STRING  ("network.port_range",  "6881-6999");
 
+  CMD2_ANY         ("network.poll.batch",            std::bind(&apply_poll_batch));
+  CMD2_ANY_VALUE   ("network.poll.batch.set",        std::bind(&apply_poll_batch_set, std::placeholders::_2));
+  CMD2_ANY         ("network.poll.stats.changes",    std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_changes));
+  CMD2_ANY         ("network.poll.stats.ctl_calls",  std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_ctl_calls));
+  CMD2_ANY         ("network.poll.stats.wait_calls", std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_wait_calls));
+  CMD2_ANY         ("network.poll.stats.events",     std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_events));
+
+  CMD2_ANY         ("network.poll.stats.last.changes",   std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_last_changes));
+  CMD2_ANY         ("network.poll.stats.last.ctl_calls", std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_last_ctl_calls));
+  CMD2_ANY         ("network.poll.stats.last.events",    std::bind(&apply_poll_stats, &torrent::PollEPoll::stats_last_events));
+
+  CMD2_ANY         ("network.threads",               std::bind(&torrent::network_thread_count));
+  CMD2_ANY_VALUE_V ("network.threads.set",           std::bind(&torrent::set_network_thread_count, std::placeholders::_2));
+
   CMD2_VAR_BOOL    ("protocol.pex",            true);
   CMD2_ANY_LIST    ("protocol.encryption.set", std::bind(&apply_encryption, std::placeholders::_2));
 
@@ -690,6 +733,12 @@ initialize_command_network() {
   CMD2_ANY_VALUE_V ("network.send_buffer.size.set",    std::bind(&torrent::ConnectionManager::set_send_buffer_size, cm, std::placeholders::_2));
   CMD2_ANY         ("network.receive_buffer.size",     std::bind(&torrent::ConnectionManager::receive_buffer_size, cm));
   CMD2_ANY_VALUE_V ("network.receive_buffer.size.set", std::bind(&torrent::ConnectionManager::set_receive_buffer_size, cm, std::placeholders::_2));
+  CMD2_ANY         ("network.send_file",               std::bind(&torrent::ConnectionManager::use_sendfile, cm));
+  CMD2_ANY_VALUE_V ("network.send_file.set",           std::bind(&torrent::ConnectionManager::set_use_sendfile, cm, std::placeholders::_2));
+  CMD2_ANY         ("network.pipe_size.min",           std::bind(&torrent::ConnectionManager::pipe_size_min, cm));
+  CMD2_ANY_VALUE_V ("network.pipe_size.min.set",       std::bind(&torrent::ConnectionManager::set_pipe_size_min, cm, std::placeholders::_2));
+  CMD2_ANY         ("network.pipe_size.max",           std::bind(&torrent::ConnectionManager::pipe_size_max, cm));
+  CMD2_ANY_VALUE_V ("network.pipe_size.max.set",       std::bind(&torrent::ConnectionManager::set_pipe_size_max, cm, std::placeholders::_2));
   CMD2_ANY_STRING  ("network.tos.set",                 std::bind(&apply_tos, std::placeholders::_2));
 
   CMD2_ANY         ("network.bind_address",        std::bind(&core::Manager::bind_address, control->core()));
@@ -719,6 +768,10 @@ initialize_command_network() {
   CMD2_ANY_VALUE_V ("system.hash.interval.set",      std::bind(&apply_hash_interval, std::placeholders::_2));
   CMD2_ANY         ("system.hash.max_tries",         std::bind(&torrent::hash_max_tries));
   CMD2_ANY_VALUE_V ("system.hash.max_tries.set",     std::bind(&torrent::set_hash_max_tries, std::placeholders::_2));
+  CMD2_ANY         ("system.hash.threads",           std::bind(&torrent::hash_thread_count));
+  CMD2_ANY_VALUE_V ("system.hash.threads.set",       std::bind(&torrent::set_hash_thread_count, std::placeholders::_2));
+  CMD2_ANY         ("system.disk.engine",            std::bind(&torrent::disk_engine_type));
+  CMD2_ANY_VALUE_V ("system.disk.engine.set",        std::bind(&torrent::set_disk_engine_type, std::placeholders::_2));
 
   CMD2_ANY_VALUE   ("trackers.enable",  std::bind(&apply_enable_trackers, int64_t(1)));
   CMD2_ANY_VALUE   ("trackers.disable", std::bind(&apply_enable_trackers, int64_t(0)));
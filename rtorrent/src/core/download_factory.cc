@@ -59,6 +59,7 @@
 #include "download.h"
 #include "download_factory.h"
 #include "download_store.h"
+#include "session_loader.h"
 
 namespace core {
 
@@ -70,23 +71,6 @@ is_network_uri(const std::string& uri) {
     std::strncmp(uri.c_str(), "ftp://", 6) == 0;
 }
 
-static bool
-download_factory_add_stream(torrent::Object* root, const char* key, const char* filename) {
-  std::fstream stream(filename, std::ios::in | std::ios::binary);
-    
-  if (!stream.is_open())
-    return false;
-
-  torrent::Object obj;
-  stream >> obj;
-
-  if (!stream.good())
-    return false;
-
-  root->insert_key_move(key, obj);
-  return true;
-}
-
 bool
 is_magnet_uri(const std::string& uri) {
   return
@@ -103,7 +87,8 @@ DownloadFactory::DownloadFactory(Manager* m) :
   m_session(false),
   m_start(false),
   m_printLog(true),
-  m_isFile(false) {
+  m_isFile(false),
+  m_preloaded(false) {
 
   m_taskLoad.set_slot(rak::mem_fn(this, &DownloadFactory::receive_load));
   m_taskCommit.set_slot(rak::mem_fn(this, &DownloadFactory::receive_commit));
@@ -141,6 +126,19 @@ DownloadFactory::load_raw_data(const std::string& input) {
   m_loaded = true;
 }
 
+// This function must be called before DownloadFactory::commit().
+void
+DownloadFactory::load_object(const std::string& uri, torrent::Object* object) {
+  if (m_stream || m_object)
+    throw torrent::internal_error("DownloadFactory::load*() called on an object with m_stream != NULL");
+
+  m_uri = uri;
+  m_object = object;
+  m_isFile = true;
+  m_loaded = true;
+  m_preloaded = true;
+}
+
 void
 DownloadFactory::commit() {
   priority_queue_insert(&taskScheduler, &m_taskCommit, cachedTime);
@@ -232,8 +230,8 @@ DownloadFactory::receive_success() {
   }
 
   if (m_session) {
-    download_factory_add_stream(root, "rtorrent", (rak::path_expand(m_uri) + ".rtorrent").c_str());
-    download_factory_add_stream(root, "libtorrent_resume", (rak::path_expand(m_uri) + ".libtorrent_resume").c_str());
+    if (!m_preloaded)
+      SessionLoader::load_sections(root, rak::path_expand(m_uri));
     
   } else {
     // We only allow session torrents to keep their
@@ -66,6 +66,10 @@ public:
   // load() or commit().
   void                load(const std::string& uri);
   void                load_raw_data(const std::string& input);
+
+  // Takes ownership of an object already parsed from 'uri', session
+  // downloads must include the session sections, see SessionLoader.
+  void                load_object(const std::string& uri, torrent::Object* object);
   void                commit();
 
   command_list_type&         commands()     { return m_commands; }
@@ -103,6 +107,7 @@ private:
   bool                m_start;
   bool                m_printLog;
   bool                m_isFile;
+  bool                m_preloaded;
 
   command_list_type         m_commands;
   torrent::Object::map_type m_variables;
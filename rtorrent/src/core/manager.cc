@@ -555,7 +555,8 @@ Manager::receive_hashing_changed() {
       // not empty then we have already loaded any existing resume
       // data.
       if ((*itr)->download()->file_list()->bitfield()->empty())
-        torrent::resume_load_progress(*(*itr)->download(), (*itr)->download()->bencode()->get_key("libtorrent_resume"));
+        torrent::resume_load_progress(*(*itr)->download(), (*itr)->download()->bencode()->get_key("libtorrent_resume"),
+                                      rpc::call_command_value("session.fingerprint") ? torrent::resume_verify_fingerprint : torrent::resume_verify_mtime);
 
       if (tryQuick) {
         if ((*itr)->download()->hash_check(true))
@@ -68,6 +68,8 @@ PollManagerEPoll::poll(rak::timer timeout) {
   torrent::perform();
   timeout = std::min(timeout, rak::timer(torrent::next_timeout())) + 1000;
 
+  static_cast<torrent::PollEPoll*>(m_poll)->flush();
+
   ThreadBase::release_global_lock();
   ThreadBase::entering_main_polling();
 
@@ -89,6 +91,8 @@ PollManagerEPoll::poll_simple(rak::timer timeout) {
   // resolution.
   timeout = timeout + 1000;
 
+  static_cast<torrent::PollEPoll*>(m_poll)->flush();
+
   if (static_cast<torrent::PollEPoll*>(m_poll)->poll((timeout.usec() + 999) / 1000) == -1)
     return check_error();
 
@@ -0,0 +1,208 @@
+// rTorrent - BitTorrent client
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+#include "config.h"
+
+#include <algorithm>
+#include <fstream>
+#include <rak/path.h>
+#include <torrent/exceptions.h>
+#include <torrent/object.h>
+#include <torrent/object_stream.h>
+
+#include "session_loader.h"
+
+namespace core {
+
+static bool
+session_loader_add_stream(torrent::Object* root, const char* key, const std::string& filename) {
+  std::fstream stream(filename.c_str(), std::ios::in | std::ios::binary);
+
+  if (!stream.is_open())
+    return false;
+
+  torrent::Object obj;
+  stream >> obj;
+
+  if (!stream.good())
+    return false;
+
+  root->insert_key_move(key, obj);
+  return true;
+}
+
+SessionLoader::SessionLoader() :
+  m_next(0),
+  m_taken(0) {
+
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_condition, NULL);
+  pthread_cond_init(&m_conditionQueue, NULL);
+}
+
+SessionLoader::~SessionLoader() {
+  pthread_mutex_lock(&m_lock);
+  m_next = m_entries.size();
+  pthread_cond_broadcast(&m_conditionQueue);
+  pthread_mutex_unlock(&m_lock);
+
+  for (std::vector<pthread_t>::iterator itr = m_threads.begin(), last = m_threads.end(); itr != last; ++itr)
+    pthread_join(*itr, NULL);
+
+  for (std::vector<entry_type>::iterator itr = m_entries.begin(), last = m_entries.end(); itr != last; ++itr)
+    delete itr->object;
+
+  pthread_cond_destroy(&m_conditionQueue);
+  pthread_cond_destroy(&m_condition);
+  pthread_mutex_destroy(&m_lock);
+}
+
+void
+SessionLoader::push_back(const std::string& path) {
+  if (!m_threads.empty())
+    throw torrent::internal_error("SessionLoader::push_back(...) called after the threads were started.");
+
+  m_entries.push_back(entry_type(path));
+}
+
+void
+SessionLoader::start(unsigned int threads) {
+  if (!m_threads.empty())
+    throw torrent::internal_error("SessionLoader::start(...) called twice.");
+
+  threads = std::min<size_t>(std::min(threads, max_threads), m_entries.size());
+
+  for (unsigned int i = 0; i < threads; i++) {
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, &SessionLoader::thread_func, this) != 0)
+      break;
+
+    m_threads.push_back(thread);
+  }
+}
+
+torrent::Object*
+SessionLoader::take(unsigned int index) {
+  entry_type* entry = &m_entries.at(index);
+
+  if (m_threads.empty()) {
+    entry->done = true;
+    return load_entry(entry->path);
+  }
+
+  pthread_mutex_lock(&m_lock);
+
+  while (!entry->done)
+    pthread_cond_wait(&m_condition, &m_lock);
+
+  torrent::Object* object = entry->object;
+  entry->object = NULL;
+
+  // Let the threads read further ahead.
+  m_taken = std::max(m_taken, index + 1);
+  pthread_cond_broadcast(&m_conditionQueue);
+
+  pthread_mutex_unlock(&m_lock);
+  return object;
+}
+
+torrent::Object*
+SessionLoader::load_entry(const std::string& path) {
+  std::string filename = rak::path_expand(path);
+  torrent::Object* object = new torrent::Object;
+
+  try {
+    std::fstream stream(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!stream.is_open())
+      throw torrent::input_error("Could not open file");
+
+    stream >> *object;
+
+    if (!stream.good())
+      throw torrent::input_error("Reading torrent file failed");
+
+    load_sections(object, filename);
+
+  } catch (torrent::base_error&) {
+    // The main thread redoes the loading of failed entries so that
+    // errors get logged the usual way.
+    delete object;
+    return NULL;
+  }
+
+  return object;
+}
+
+void
+SessionLoader::load_sections(torrent::Object* root, const std::string& filename) {
+  session_loader_add_stream(root, "rtorrent", filename + ".rtorrent");
+  session_loader_add_stream(root, "libtorrent_resume", filename + ".libtorrent_resume");
+}
+
+void*
+SessionLoader::thread_func(void* loader) {
+  static_cast<SessionLoader*>(loader)->thread_perform();
+  return NULL;
+}
+
+void
+SessionLoader::thread_perform() {
+  pthread_mutex_lock(&m_lock);
+
+  while (m_next < m_entries.size()) {
+    if (m_next >= m_taken + max_queued) {
+      pthread_cond_wait(&m_conditionQueue, &m_lock);
+      continue;
+    }
+
+    entry_type* entry = &m_entries[m_next++];
+    pthread_mutex_unlock(&m_lock);
+
+    torrent::Object* object = load_entry(entry->path);
+
+    pthread_mutex_lock(&m_lock);
+    entry->object = object;
+    entry->done = true;
+
+    pthread_cond_broadcast(&m_condition);
+  }
+
+  pthread_mutex_unlock(&m_lock);
+}
+
+}
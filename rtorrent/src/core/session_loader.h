@@ -0,0 +1,114 @@
+// rTorrent - BitTorrent client
+// Copyright (C) 2005-2007, Jari Sundell
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// In addition, as a special exception, the copyright holders give
+// permission to link the code of portions of this program with the
+// OpenSSL library under certain conditions as described in each
+// individual source file, and distribute linked combinations
+// including the two.
+//
+// You must obey the GNU General Public License in all respects for
+// all of the code used other than OpenSSL.  If you modify file(s)
+// with this exception, you may extend this exception to your version
+// of the file(s), but you are not obligated to do so.  If you do not
+// wish to do so, delete this exception statement from your version.
+// If you delete this exception statement from all source files in the
+// program, then also delete it here.
+//
+// Contact:  Jari Sundell <jaris@ifi.uio.no>
+//
+//           Skomakerveien 33
+//           3185 Skoppum, NORWAY
+
+// Reads and parses the session files of downloads using a pool of
+// threads, so that the main thread only needs to create the
+// downloads. The parsed objects are handed over in the order the
+// paths were added, and the threads stop reading ahead once
+// 'max_queued' parsed objects are waiting to be taken.
+
+#ifndef RTORRENT_CORE_SESSION_LOADER_H
+#define RTORRENT_CORE_SESSION_LOADER_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace torrent {
+  class Object;
+}
+
+namespace core {
+
+class SessionLoader {
+public:
+  static const unsigned int max_threads = 16;
+  static const unsigned int max_queued  = 64;
+
+  SessionLoader();
+  ~SessionLoader();
+
+  size_t              size() const                 { return m_entries.size(); }
+  const std::string&  path(unsigned int index) const { return m_entries[index].path; }
+
+  void                push_back(const std::string& path);
+
+  // Start parsing the entries, with no threads the entries get
+  // parsed by 'take' instead.
+  void                start(unsigned int threads);
+
+  // Blocks until the entry has been parsed. Returns NULL if the
+  // torrent file could not be read, else the caller takes ownership
+  // of the object.
+  torrent::Object*    take(unsigned int index);
+
+  // Includes the 'rtorrent' and 'libtorrent_resume' sections if the
+  // files exist.
+  static torrent::Object* load_entry(const std::string& path);
+
+  // Adds the sections stored next to the session torrent 'filename'
+  // to 'root'.
+  static void         load_sections(torrent::Object* root, const std::string& filename);
+
+private:
+  SessionLoader(const SessionLoader&);
+  void operator = (const SessionLoader&);
+
+  struct entry_type {
+    entry_type(const std::string& p) : path(p), object(NULL), done(false) {}
+
+    std::string       path;
+    torrent::Object*  object;
+    bool              done;
+  };
+
+  static void*        thread_func(void* loader);
+  void                thread_perform();
+
+  std::vector<entry_type> m_entries;
+  std::vector<pthread_t>  m_threads;
+
+  unsigned int        m_next;
+  unsigned int        m_taken;
+
+  pthread_mutex_t     m_lock;
+  pthread_cond_t      m_condition;
+  pthread_cond_t      m_conditionQueue;
+};
+
+}
+
+#endif
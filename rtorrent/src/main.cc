@@ -54,6 +54,7 @@
 #include "core/download_factory.h"
 #include "core/download_store.h"
 #include "core/manager.h"
+#include "core/session_loader.h"
 #include "display/canvas.h"
 #include "display/window.h"
 #include "display/manager.h"
@@ -110,21 +111,38 @@ parse_options(Control* c, int argc, char** argv) {
 void
 load_session_torrents(Control* c) {
   utils::Directory entries = c->core()->download_store()->get_formated_entries();
+  core::SessionLoader loader;
 
   for (utils::Directory::const_iterator first = entries.begin(), last = entries.end(); first != last; ++first) {
     // We don't really support session torrents that are links. These
     // would be overwritten anyway on exit, and thus not really be
     // useful.
-    if (!first->is_file())
-      continue;
+    if (first->is_file())
+      loader.push_back(entries.path() + first->d_name);
+  }
+
+  loader.start(rpc::call_command_value("session.load_threads"));
 
+  for (unsigned int i = 0; i < loader.size(); i++) {
     core::DownloadFactory* f = new core::DownloadFactory(c->core());
+    torrent::Object* object = loader.take(i);
 
     // Replace with session torrent flag.
     f->set_session(true);
     f->slot_finished(sigc::bind(sigc::ptr_fun(&rak::call_delete_func<core::DownloadFactory>), f));
-    f->load(entries.path() + first->d_name);
+
+    // Entries that failed to parse get loaded again the usual way so
+    // that the error is logged.
+    if (object != NULL)
+      f->load_object(loader.path(i), object);
+    else
+      f->load(loader.path(i));
+
     f->commit();
+
+    // Create the downloads as they are handed over, so that it
+    // overlaps with the parsing of the remaining files.
+    rak::priority_queue_perform(&taskScheduler, cachedTime);
   }
 }
 